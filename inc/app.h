@@ -1,6 +1,9 @@
 #include "base.h"
+#include "options.h"
 
 struct instance_;
+struct pool_;
+struct scheduler_;
 struct theme_;
 
 typedef struct app_ {
@@ -9,17 +12,34 @@ typedef struct app_ {
     unsigned instances_size;
 
     struct theme_* theme;
-    int draw_mode; // shaded or wireframe
+    int draw_mode; // shaded, wireframe, or feature edges
     int draw_proj; // orthographic or perspective
 
     unsigned deferred_count;
     char** deferred_files;
+
+    /*  Read from the environment at startup, and copied into each
+     *  instance's loader and model */
+    options_t options;
+
+    /*  Threads shared by every instance's loader */
+    struct pool_* pool;
+    unsigned open_count;
+
+    /*  Decides when to draw frames */
+    struct scheduler_* scheduler;
+    bool animating; // Whether any instance needs another frame
 } app_t;
 
 /*  Calls instance_run on every instance */
 bool app_run(app_t* app);
 
-/*  Synchronously loads a file (triggered from UI menu items) */
+/*  Handles events until the next frame is due, sleeping if nothing
+ *  is animating */
+void app_wait(app_t* app);
+
+/*  Opens a window and starts loading a file in the background
+ *  (triggered from UI menu items) */
 struct instance_* app_open(app_t* app, const char* filename);
 
 /*  Loads a file when control returns to the event loop */
@@ -28,6 +48,7 @@ void app_defer_open(app_t* app, const char* filename);
 /*  Changes the view mode for the whole application */
 void app_view_shaded(app_t* app);
 void app_view_wireframe(app_t* app);
+void app_view_edges(app_t* app);
 void app_view_orthographic(app_t* app);
 void app_view_perspective(app_t* app);
 
@@ -38,3 +59,9 @@ void app_set_front(app_t* app, struct instance_* instance);
 
 /*  Returns the instance that's currently focused */
 struct instance_* app_get_front(app_t* app);
+
+/*  Sets the thread pool priority of every running load, so that the
+ *  focused window's model loads first, followed by the most recently
+ *  opened windows.  This is called whenever a load starts or the focus
+ *  changes. */
+void app_update_priorities(app_t* app);
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "base.h"
+#include "mem.h"
+
+/*  An arena is a bump allocator for scratch memory used during a load.
+ *
+ *  Arenas are kept in a process-wide pool:  a thread acquires one at the
+ *  start of its work and releases it when done, which frees everything
+ *  allocated from it in one step.  The backing memory is retained by the
+ *  pool, so later loads can reuse it without going back to the system
+ *  allocator.  An arena must only be used by one thread at a time. */
+typedef struct arena_ arena_t;
+
+/*  Sets up the arena pool.  Must be called before any other function */
+void arena_init(void);
+
+/*  Takes an empty arena from the pool, creating one if needed */
+arena_t* arena_acquire(void);
+
+/*  Releases all allocations from the arena and returns it to the pool */
+void arena_release(arena_t* arena);
+
+/*  Allocates memory from the arena, charging it to the given subsystem.
+ *  arena_alloc returns uninitialized memory; arena_calloc zeroes it. */
+void* arena_alloc(arena_t* arena, mem_subsystem_t s, size_t bytes);
+void* arena_calloc(arena_t* arena, mem_subsystem_t s, size_t bytes);
+
+/*  Grows an allocation, preserving its contents and zeroing the new tail.
+ *  This is done in place if ptr was the most recent allocation and there
+ *  is space in its block; otherwise, the data is copied and the old space
+ *  is not reclaimed until the arena is released. */
+void* arena_grow(arena_t* arena, mem_subsystem_t s, void* ptr,
+                 size_t old_bytes, size_t new_bytes);
+
+#endif
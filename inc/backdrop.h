@@ -7,3 +7,7 @@ typedef struct backdrop_ backdrop_t;
 backdrop_t* backdrop_new(void);
 void backdrop_delete(backdrop_t* backdrop);
 void backdrop_draw(backdrop_t* backdrop, struct theme_* theme);
+
+/*  Draws the backdrop's full-screen quad (with vertex positions in
+ *  attribute 0) using whatever shader program is bound */
+void backdrop_draw_quad(backdrop_t* backdrop);
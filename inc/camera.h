@@ -3,9 +3,12 @@
 /*  Forward declaration of camera struct */
 typedef struct camera_ camera_t;
 
+/*  The proj and view matrices are in a uniform block named camera (as
+ *  two std140 mat4s), which is bound to this uniform buffer binding point.
+ *  The model matrix changes per chunk, so it's a plain uniform. */
+#define CAMERA_BINDING 0
+
 typedef struct camera_uniforms_ {
-    GLint proj;
-    GLint view;
     GLint model;
 } camera_uniforms_t;
 
@@ -32,8 +35,12 @@ void camera_end_drag(camera_t* camera);
 void camera_zoom(camera_t* camera, float amount);
 
 /*  Assigns the current mouse position, causing a rotation or
- *  pan if the button was already held down. */
-void camera_set_mouse_pos(camera_t* camera, float x, float y);
+ *  pan if the button was already held down.  Returns true if
+ *  the view changed. */
+bool camera_set_mouse_pos(camera_t* camera, float x, float y);
+
+/*  Checks whether the user is panning or rotating the view */
+bool camera_is_dragging(const camera_t* camera);
 
 /*  Schedules a camera animation to update projection */
 void camera_anim_proj_perspective(camera_t* camera);
@@ -44,8 +51,29 @@ void camera_anim_proj_orthographic(camera_t* camera);
  *  returns true (so the caller should schedule a redraw). */
 bool camera_check_anim(camera_t* camera);
 
-/*  Looks up uniforms for camera binding */
+/*  Looks up uniforms for camera binding, and assigns the program's camera
+ *  uniform block to CAMERA_BINDING */
 camera_uniforms_t camera_get_uniforms(GLuint prog);
 
-/*  Binds the camera matrices to the given uniforms */
+/*  Binds the camera's uniform buffer (updating it if the view changed)
+ *  and its model matrix to the given uniforms */
 void camera_bind(camera_t* camera, camera_uniforms_t u);
+
+/*  Binds the model matrix alone, applied after a per-axis scale and
+ *  offset (used to dequantize a chunk's vertices) */
+void camera_bind_model(camera_t* camera, camera_uniforms_t u,
+                       const float offset[3], const float scale[3]);
+
+/*  Finds the view frustum in model coordinates, as six normalized planes
+ *  (a, b, c, d) where points with ax + by + cz + d < 0 are outside, and
+ *  the eye position in homogeneous model coordinates (with w = 0 for an
+ *  orthographic camera, where the eye is a direction) */
+void camera_get_cull(const camera_t* camera, float planes[6][4],
+                     float eye[4]);
+
+/*  Finds how large things appear on screen:  clip-space w as a function of
+ *  model coordinates (so w[0]x + w[1]y + w[2]z + w[3], which is one
+ *  everywhere for an orthographic camera), and the size in window units
+ *  of a unit length in model coordinates where w is one.  Sizes elsewhere
+ *  scale by 1 / w. */
+void camera_get_scale(const camera_t* camera, float w[4], float* pixels);
@@ -0,0 +1,90 @@
+#include "base.h"
+#include "shader.h"
+
+struct camera_;
+struct model_;
+struct model_chunk_;
+
+/*  Culls a model's clusters (see model.h) against the view frustum and,
+ *  for closed meshes, by their normal cones, then builds a compact list
+ *  of draws for each chunk.  Adjacent visible clusters are merged, so a
+ *  fully visible chunk is drawn with one call per base-vertex range.
+ *
+ *  With OpenGL 4.3, clusters can instead be culled by a compute shader,
+ *  which writes an indirect draw command for every cluster (with zero
+ *  instances if it's culled), so the CPU only does work per chunk. */
+typedef struct cull_ {
+    /*  View, in model coordinates (see camera_get_cull) */
+    float planes[6][4];
+    float eye[4];
+    int orientation;
+
+    /*  Whether to cull clusters (on the GPU, if possible) and draw levels
+     *  of detail, from the model's options */
+    bool enabled;
+    bool gpu;
+    bool lod;
+
+    /*  Screen scale, for picking levels of detail (see camera_get_scale) */
+    float w[4];
+    float pixels;
+
+    /*  Draw list for the latest chunk, which is reused between frames.
+     *  Offsets are in bytes, and firsts are in indices. */
+    GLsizei* counts;
+    void** offsets;
+    GLint* firsts;
+    GLint* bases;
+    unsigned size;
+
+    /*  Compute shader for culling on the GPU, which is only built if the
+     *  context supports it (so shader.prog is zero otherwise) */
+    shader_t shader;
+    GLint u_planes;
+    GLint u_eye;
+    GLint u_orientation;
+    GLint u_cluster_count;
+
+    /*  Statistics since cull_begin.  Clusters culled on the GPU aren't
+     *  counted as visible or drawn, since they're never read back. */
+    uint32_t cluster_count;
+    uint32_t visible_count;
+    uint32_t draw_count;
+} cull_t;
+
+/*  Constructs a culler, building the compute shader if the current
+ *  OpenGL context supports it */
+cull_t* cull_new(void);
+void cull_delete(cull_t* cull);
+
+/*  Prepares to cull a model from the camera's current view */
+void cull_begin(cull_t* cull, struct camera_* camera,
+                const struct model_* model);
+
+/*  Checks whether a sphere is entirely outside one of the frustum planes
+ *  from camera_get_cull */
+bool cull_outside(const float planes[6][4], const float center[3],
+                  float radius);
+
+/*  Checks whether any part of a chunk could be visible, which also
+ *  requires it to be resident on the GPU (see resident.h) */
+bool cull_chunk_visible(const cull_t* cull,
+                        const struct model_chunk_* chunk);
+
+/*  Picks the coarsest level of detail whose error covers at most
+ *  LOD_MAX_PIXELS on screen, anywhere in the chunk's bounding sphere.
+ *  Returns zero for the full-resolution chunk, or the level plus one. */
+unsigned cull_chunk_lod(const cull_t* cull,
+                        const struct model_chunk_* chunk);
+
+/*  Fills the draw list with the chunk's visible clusters, returning the
+ *  number of draws */
+unsigned cull_chunk(cull_t* cull, const struct model_chunk_* chunk);
+
+/*  Culls the clusters of every visible chunk (except those drawn at a
+ *  coarser level of detail) on the GPU, filling each chunk's command
+ *  buffer (uploading its clusters on first use) and waiting for the
+ *  commands to be written before any indirect draws.  Returns false
+ *  if culling on the GPU is disabled or unsupported, in which case the
+ *  caller should use cull_chunk instead. */
+bool cull_gpu(cull_t* cull, struct model_* model);
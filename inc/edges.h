@@ -0,0 +1,59 @@
+#ifndef EDGES_H
+#define EDGES_H
+
+#include "base.h"
+
+struct arena_;
+
+/*  Edges are drawn if the angle between their triangles' normals is
+ *  larger than this */
+#define EDGES_CREASE_DEGREES 30.0f
+
+/*  An edge with only one triangle in its chunk.  It is either a boundary
+ *  of the mesh or shared with a triangle in another chunk, which is only
+ *  known once every chunk has been processed (in edges_merge). */
+typedef struct edges_open_ {
+    float pos[2][3];        /* Endpoints, with the lower one first */
+    float normal[3];        /* Unit normal of the triangle, or zero */
+    uint32_t index[2];      /* Chunk-local vertex indices */
+    bool forward;           /* Whether the triangle winds from pos[0] */
+} edges_open_t;
+
+/*  Feature edges of one chunk:  creases, boundaries, and edges shared by
+ *  more than two triangles.  Arrays are tracked as MEM_EDGES. */
+typedef struct edges_ {
+    uint32_t* lines;        /* Pairs of 0-based vertex indices */
+    uint32_t line_count;
+    uint32_t lines_size;
+
+    edges_open_t* open;
+    uint32_t open_count;
+
+    /*  Number of edges which keep the mesh from being a closed and
+     *  consistently wound surface:  boundaries, edges shared by more than
+     *  two triangles, and edges whose triangles wind in the same direction
+     *  along them.  Edges between chunks are counted by edges_merge. */
+    uint32_t flaws;
+
+    /*  Signed volume of the chunk's triangles relative to the origin
+     *  passed to edges_find, which is only meaningful when summed across
+     *  every chunk of a closed mesh (where it's positive if triangles
+     *  face outwards) */
+    double volume;
+} edges_t;
+
+/*  Finds the feature edges within a chunk, using the arena for scratch
+ *  memory.  tris holds 3 * tri_count 0-based indices into verts.  The
+ *  origin should be shared by every chunk of the model, and nearby. */
+void edges_find(edges_t* edges, struct arena_* arena,
+                const uint32_t* tris, size_t tri_count,
+                const float (*verts)[3], const float origin[3]);
+
+/*  Matches open edges between chunks (by position), adding creases and
+ *  boundaries to their chunks' lines and counting flaws, then releases
+ *  the open edges */
+void edges_merge(edges_t** edges, unsigned count, struct arena_* arena);
+
+void edges_free(edges_t* edges);
+
+#endif
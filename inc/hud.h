@@ -0,0 +1,17 @@
+#include "base.h"
+
+struct timing_;
+
+typedef struct hud_ hud_t;
+
+hud_t* hud_new(void);
+void hud_delete(hud_t* hud);
+
+/*  Draws a rolling graph of recent frame times in the corner of the
+ *  current viewport, as stacked per-stage GPU times with a tick marking
+ *  the CPU time for each frame. */
+void hud_draw(hud_t* hud, const struct timing_* timing);
+
+/*  Draws a progress bar across the middle of the current viewport,
+ *  where progress is in the range 0 to 1 */
+void hud_draw_progress(hud_t* hud, float progress);
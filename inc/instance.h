@@ -3,8 +3,14 @@
 struct app_;
 struct backdrop_;
 struct camera_;
+struct hud_;
+struct lines_;
+struct loader_;
 struct model_;
+struct quality_;
 struct theme_;
+struct timing_;
+struct wireframe_;
 
 typedef struct instance_ {
     struct backdrop_* backdrop;
@@ -13,32 +19,69 @@ typedef struct instance_ {
 
     // Different rendering modes
     struct draw_* shaded;
-    struct draw_* wireframe;
+    struct wireframe_* wireframe;
+    struct lines_* lines;
 
     enum {
         DRAW_SHADED,
-        DRAW_WIREFRAME
+        DRAW_WIREFRAME,
+        DRAW_EDGES
     } draw_mode;
 
+    /*  GPU frame timing, optionally shown in an overlay */
+    struct timing_* timing;
+    struct hud_* hud;
+    bool show_hud;
+
+    /*  Reduces resolution while the view is moving */
+    struct quality_* quality;
+
+    /*  Loader for this instance's model, or NULL once it has finished */
+    struct loader_* loader;
     const char* error; // Error string from the loader
     struct app_* parent;
+    unsigned serial; // Order in which instances were opened
 
     bool focused;
 
+    /*  Set when something visible has changed, so that the main loop
+     *  only redraws windows that need it */
+    bool dirty;
+
+    /*  Latest cursor position, which is applied to the camera once per
+     *  frame (in instance_flush_input) rather than on every event */
+    float mouse_pos[2];
+    bool mouse_pending;
+
     GLFWwindow* window;
 } instance_t;
 
+/*  Constructs an instance and starts loading its model in the background.
+ *  Call instance_check_loader() from the main loop to finish loading. */
 instance_t* instance_new(struct app_* parent, const char* filepath, int proj);
 void instance_delete(instance_t* instance);
 
-/*  Draws an instance
+/*  Advances the instance's loader, allocating GPU buffers when the loader
+ *  is ready for them.  Never blocks on the loader.
+ *
+ *  Returns true if the load finished during this call, in which case
+ *  instance->error is set if it failed. */
+bool instance_check_loader(instance_t* instance);
+
+/*  Applies input which has been coalesced since the last frame,
+ *  marking the instance as dirty if the view changed */
+void instance_flush_input(instance_t* instance);
+
+/*  Draws an instance, clearing its dirty flag
  *
  *  Returns true if the main loop should schedule a redraw immediately
- *  (e.g. because there's an animation running in this instance). */
+ *  (e.g. because there's an animation running in this instance), in
+ *  which case the instance stays dirty. */
 bool instance_draw(instance_t* instance, struct theme_* theme);
 
 void instance_view_shaded(instance_t* instance);
 void instance_view_wireframe(instance_t* instance);
+void instance_view_edges(instance_t* instance);
 void instance_view_orthographic(instance_t* instance);
 void instance_view_perspective(instance_t* instance);
 
@@ -48,3 +91,5 @@ void instance_cb_mouse_pos(instance_t* instance, float xpos, float ypos);
 void instance_cb_mouse_click(instance_t* instance, int button, int action, int mods);
 void instance_cb_mouse_scroll(instance_t* instance, float xoffset, float yoffset);
 void instance_cb_focus(instance_t* instance, bool focus);
+void instance_cb_key(instance_t* instance, int key, int action, int mods);
+void instance_cb_refresh(instance_t* instance);
@@ -0,0 +1,15 @@
+#include "base.h"
+
+struct camera_;
+struct model_;
+
+/*  Draws each chunk's feature edges (see edges.h) as lines, darkening the
+ *  pixels beneath them.  These are drawn over the shaded model. */
+typedef struct lines_ lines_t;
+
+/*  Constructs a line drawer.  Requires an OpenGL context. */
+lines_t* lines_new(void);
+void lines_delete(lines_t* lines);
+
+void lines_draw(lines_t* lines, struct model_* model,
+                struct camera_* camera);
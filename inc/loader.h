@@ -2,19 +2,17 @@
 
 struct model_;
 struct camera_;
+struct options_;
+struct report_;
+struct pool_;
+struct worker_;
 
 typedef enum loader_state_ {
     LOADER_START,
 
-    /*  The loader has populated the triangle and vertex counts, so the
-     *  OpenGL thread can allocate and map buffers */
-    LOADER_MODEL_SIZE,
-
-    /*  The OpenGL thread has allocated and mapped buffers */
-    LOADER_GPU_BUFFER,
-
-    /*  The loader thread has split the GPU buffer to each worker */
-    LOADER_WORKER_GPU,
+    /*  The loader has split the model into chunks, which the OpenGL
+     *  thread uploads (with loader_upload) as they become ready */
+    LOADER_CHUNKS,
 
     LOADER_DONE,
 
@@ -22,24 +20,70 @@ typedef enum loader_state_ {
     LOADER_ERROR_NO_FILE,
     LOADER_ERROR_BAD_ASCII_STL,
     LOADER_ERROR_WRONG_SIZE,
+    LOADER_ERROR_CANCELLED,
 } loader_state_t;
 
 typedef struct loader_ loader_t;
 
-loader_t* loader_new(const char* filename);
+/*  Starts loading a file in the background, running the heavy lifting
+ *  as tasks on the given thread pool.  The options are copied. */
+loader_t* loader_new(const char* filename, const struct options_* options,
+                     struct pool_* pool);
 void loader_delete(loader_t* loader);
 
 void loader_wait(loader_t* loader, loader_state_t target);
 void loader_next(loader_t* loader, loader_state_t target);
 
-void loader_allocate_vbo(loader_t* loader);
-void loader_finish(loader_t* loader, struct model_* model,
+/*  Returns the current state, without blocking on state changes */
+loader_state_t loader_get_state(loader_t* loader);
+
+/*  Returns the approximate fraction of the load that is complete,
+ *  reading atomic counters without locking */
+float loader_get_progress(loader_t* loader);
+
+/*  Records that a worker has deduplicated some triangles */
+void loader_add_progress(loader_t* loader, uint32_t tri_count);
+
+/*  Releases a worker's scratch memory once it's done with its chunk, then
+ *  starts deduplicating the next chunk in its place */
+void loader_release_chunk(loader_t* loader, struct worker_* worker);
+
+/*  Moves chunks of the model to the GPU as they become ready, without
+ *  blocking.  Maps buffers for chunks which have been deduplicated, and
+ *  adds chunks which have been copied into their buffers to the model,
+ *  refitting the camera around them.  The loader can't reach LOADER_DONE
+ *  until every chunk has been uploaded, so this must be called regularly
+ *  from the main thread, with the model's GL context current.
+ *
+ *  Returns true if any chunks were added to the model. */
+bool loader_upload(loader_t* loader, struct model_* model,
                    struct camera_* camera);
 
+/*  Adds feature edges and levels of detail to every chunk of the model,
+ *  and records whether it's closed (which enables backface culling of its
+ *  clusters), once the loader has reached LOADER_DONE.  Must be called
+ *  with the model's GL context. */
+void loader_finish(loader_t* loader, struct model_* model);
+
 /*  Returns an error string based on loader->state, or NULL
  *  if the state is LOADER_DONE. */
 const char* loader_error_string(loader_t* loader);
 
-/*  Increments the mutex-protected count variable, notifying anything
- *  that is waiting on its condition variable. */
-void loader_increment_count(loader_t* loader);
+/*  Returns the load report, or NULL if the load has not finished
+ *  successfully.  The report is owned by the loader and is valid
+ *  until loader_delete is called. */
+const struct report_* loader_get_report(loader_t* loader);
+
+/*  Abandons the load:  queued pool tasks are dropped, and the loader
+ *  thread stops at its next checkpoint and moves to LOADER_ERROR_CANCELLED.
+ *  loader_delete must still be called (with the GL context current),
+ *  which waits for the loader thread and frees any GPU buffers. */
+void loader_cancel(loader_t* loader);
+
+/*  Checks whether loader_cancel has been called.  This is cheap enough to
+ *  call frequently, and long-running tasks poll it every few milliseconds
+ *  so that a cancelled load frees its threads quickly. */
+bool loader_cancelled(loader_t* loader);
+
+/*  Sets the pool priority of this load's tasks (higher runs first) */
+void loader_set_priority(loader_t* loader, int priority);
@@ -0,0 +1,39 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "base.h"
+#include "model.h"
+
+struct arena_;
+
+/*  Each level of detail aims for this fraction of the previous level's
+ *  triangles, stopping once a level would have fewer than LOD_MIN_TRIS */
+#define LOD_RATIO 4
+#define LOD_MIN_TRIS 256
+
+/*  A coarser level is drawn if its error, projected onto the screen, is
+ *  at most this many pixels (in window units) */
+#define LOD_MAX_PIXELS 1.0f
+
+/*  Simplified copies of a chunk, built by quadric error edge collapse.
+ *  Every collapse moves a vertex onto one of its neighbours, so levels
+ *  reuse the chunk's vertex buffer, and vertices on open or non-manifold
+ *  edges never move, so levels of adjacent chunks meet without cracks. */
+typedef struct lod_ {
+    /*  Every level's triangles, as 0-based indices (tracked as MEM_LOD) */
+    uint32_t* tris;
+    uint32_t index_count;
+
+    model_lod_t levels[MODEL_MAX_LODS];
+    unsigned level_count;
+} lod_t;
+
+/*  Builds levels of detail for a chunk, given its triangles as 0-based
+ *  indices into verts.  Chunks with non-finite vertices get no levels. */
+void lod_build(lod_t* lod, struct arena_* arena,
+               const uint32_t* tris, size_t tri_count,
+               const float (*verts)[3], size_t vert_count);
+
+void lod_free(lod_t* lod);
+
+#endif
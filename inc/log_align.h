@@ -0,0 +1 @@
+#define LOG_ALIGN (1 + 18)
@@ -0,0 +1,48 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include "base.h"
+
+/*  Subsystems which are charged for memory usage */
+typedef enum {
+    MEM_LOADER,     /* ASCII parse buffers and re-packed binary copies */
+    MEM_WORKER,     /* Per-worker triangle arrays */
+    MEM_VSET,       /* Vertex set data, links, and buckets */
+    MEM_EDGES,      /* Edge tables and feature edge lines */
+    MEM_LOD,        /* Simplified levels of detail */
+    MEM_RESIDENT,   /* Chunk buffers kept in RAM, for streaming to the GPU */
+    MEM_ICOSPHERE,  /* Builtin model generation */
+    MEM_FILE,       /* Memory-mapped input files (tracked only) */
+    MEM_GPU,        /* Mapped GPU buffers (tracked only) */
+    MEM_ARENA,      /* Arena memory that is retained but not in use */
+    MEM_SUBSYSTEM_COUNT,
+} mem_subsystem_t;
+
+typedef struct mem_stats_ {
+    size_t current[MEM_SUBSYSTEM_COUNT];
+    size_t peak[MEM_SUBSYSTEM_COUNT];
+
+    /*  Sum of all subsystems, and its high-water mark.  The total peak
+     *  is tracked separately, since subsystems peak at different times. */
+    size_t total;
+    size_t total_peak;
+} mem_stats_t;
+
+/*  Tracked allocation wrappers.  These behave like their libc equivalents,
+ *  but charge the allocation to the given subsystem.  Memory from these
+ *  functions must be released with mem_free (not free). */
+void* mem_malloc(mem_subsystem_t s, size_t bytes);
+void* mem_calloc(mem_subsystem_t s, size_t count, size_t size);
+void* mem_realloc(void* ptr, size_t bytes);
+void mem_free(void* ptr);
+
+/*  Records memory that isn't allocated through the wrappers above
+ *  (e.g. mmapped files or mapped GPU buffers).  delta may be negative. */
+void mem_track(mem_subsystem_t s, int64_t delta);
+
+/*  Takes a snapshot of the current counters */
+void mem_get_stats(mem_stats_t* stats);
+
+const char* mem_subsystem_name(mem_subsystem_t s);
+
+#endif
@@ -1,12 +1,212 @@
+#ifndef MODEL_H
+#define MODEL_H
+
 #include "base.h"
+#include "options.h"
 
-typedef struct model_ {
+/*  Largest number of vertices that a range of 16-bit indices can span.
+ *  Ranges of a chunk's indices are drawn with a base vertex that is added
+ *  to every index, which lets chunks with more vertices than this use
+ *  16-bit indices, as long as each range spans fewer. */
+#define MODEL_RANGE_VERTS 65536
+
+/*  Largest number of triangles in a cluster */
+#define MODEL_CLUSTER_TRIS 256
+
+/*  A cluster is a run of triangles within a range, which is culled as a
+ *  unit (and is spatially coherent because chunks are sorted along a
+ *  Morton curve).  Bounds are in model coordinates, before quantization. */
+typedef struct model_cluster_ {
+    uint32_t first;         /* Offset into the index buffer, in indices */
+    uint32_t count;         /* Number of indices */
+    int32_t base;           /* Base vertex of the cluster's range */
+
+    /*  Bounding sphere */
+    float center[3];
+    float radius;
+
+    /*  Cone containing every triangle's normal, as a unit axis and the
+     *  sine of its half-angle.  The sine is above 1 if the cone is too
+     *  wide to ever be culled. */
+    float axis[3];
+    float cone_sin;
+} model_cluster_t;
+
+/*  Marks the end of the list of resident chunks (see resident.h) */
+#define MODEL_NO_CHUNK UINT_MAX
+
+/*  Largest number of simplified levels of detail per chunk */
+#define MODEL_MAX_LODS 4
+
+/*  A simplified level of detail (see lod.h), as a run of the chunk's LOD
+ *  index buffer.  Its triangles use the chunk's own vertices. */
+typedef struct model_lod_ {
+    uint32_t first;         /* Offset into the LOD index buffer, in indices */
+    uint32_t count;         /* Number of indices */
+
+    /*  Largest error of any collapse that built this level, as the
+     *  area-weighted RMS distance (in model coordinates) from the moved
+     *  vertex to the planes of the original triangles it replaces */
+    float error;
+} model_lod_t;
+
+/*  Indirect draw command, as read by glMultiDrawElementsIndirect */
+typedef struct model_command_ {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first;
+    int32_t base;
+    uint32_t base_instance;
+} model_command_t;
+
+/*  Models are split into chunks, each with its own buffers, so that
+ *  chunks can be drawn as soon as they are loaded */
+typedef struct model_chunk_ {
     uint32_t tri_count;
 
+    /*  The vbo and ibo (along with the vao and buffer textures over them)
+     *  are zero while the chunk isn't resident on the GPU, in which case
+     *  it isn't drawn */
     GLuint vao;
     GLuint vbo;
     GLuint ibo;
+
+    /*  Copies of the vbo and ibo contents in RAM (tracked as MEM_RESIDENT),
+     *  for chunks which are streamed to the GPU within a memory budget
+     *  (see resident.h).  These are NULL if the chunk is always resident.
+     *  The sizes of the vbo and ibo are known either way. */
+    void* vertex_data;
+    void* index_data;
+    size_t vbo_bytes;
+    size_t ibo_bytes;
+
+    /*  Frame in which the chunk was last visible, and its neighbours in
+     *  the model's list of streamed chunks which are resident, for LRU
+     *  eviction */
+    uint64_t used;
+    unsigned lru_prev;
+    unsigned lru_next;
+
+    /*  Indices are GL_UNSIGNED_SHORT (relative to each cluster's base) or
+     *  GL_UNSIGNED_INT, in which case every base is zero */
+    GLenum index_type;
+    model_cluster_t* clusters;
+    unsigned cluster_count;
+
+    /*  Bounding sphere of the whole chunk, in model coordinates */
+    float center[3];
+    float radius;
+
+    /*  For culling on the GPU (see cull.h):  a shader storage buffer of
+     *  clusters, and an indirect draw command for each cluster.  These
+     *  are created by model_upload_clusters on first use. */
+    GLuint cluster_buf;
+    GLuint command_buf;
+
+    /*  Positions in the vbo are either packed floats, or (if quantized)
+     *  normalized 16-bit integers, which map to offset + scale * q.  The
+     *  offset and scale are otherwise zero and one, so that they can be
+     *  folded into the model matrix either way (see camera_bind_model). */
+    bool quantized;
+    float offset[3];
+    float scale[3];
+
+    /*  Buffer textures over the vbo and ibo, so that shaders can look up
+     *  every vertex of a triangle (used to draw wireframes) */
+    GLuint vert_tex;
+    GLuint tri_tex;
+
+    /*  Feature edges, drawn as lines from the same vertex buffer.  These
+     *  are added once the whole model is loaded. */
+    uint32_t line_count;
+    GLuint line_vao;
+    GLuint lbo;
+
+    /*  Levels of detail, from finest to coarsest, drawn from the same
+     *  vertex buffer with their own index buffer (of lod_type and
+     *  lod_bytes).  These are also added once the whole model is loaded. */
+    model_lod_t lods[MODEL_MAX_LODS];
+    unsigned lod_count;
+    GLenum lod_type;
+    GLuint lod_vao;
+    GLuint lod_ibo;
+    size_t lod_bytes;
+} model_chunk_t;
+
+typedef struct model_ {
+    uint32_t tri_count; /* Across all chunks */
+
+    /*  Copied from the caller, for drawing (see cull.h) and streaming */
+    options_t options;
+
+    /*  1 if the mesh is closed and consistently wound with outward-facing
+     *  triangles, -1 if it's closed with inward-facing triangles, or 0
+     *  otherwise.  This is only known once the whole model is loaded, and
+     *  enables culling of backfacing clusters. */
+    int orientation;
+
+    model_chunk_t* chunks;
+    unsigned chunk_count;
+    unsigned chunks_size;
+
+    /*  Streaming state (see resident.h):  the number of chunks with copies
+     *  in RAM, the GPU memory used by every buffer of the model, its budget
+     *  if it's been shrunk below options.gpu_budget (zero otherwise) and
+     *  when it was last shrunk, a frame counter, and the most and least
+     *  recently visible resident chunks which can be evicted */
+    unsigned streamed_count;
+    size_t resident_bytes;
+    size_t budget;
+    int64_t budget_time;
+    uint64_t frame;
+    unsigned lru_head;
+    unsigned lru_tail;
 } model_t;
 
-model_t* model_new(void);
+model_t* model_new(const options_t* options);
 void model_delete(model_t* model);
+
+/*  Adds a chunk to the model, which takes ownership of its buffers (which
+ *  may be zero, if the chunk's data is added with model_set_data).
+ *  The ibo contains indices of the given type for tri_count triangles,
+ *  split into clusters (which are copied).  The vbo contains packed
+ *  3-float positions, or if quantized is true, packed 16-bit normalized
+ *  positions within the model's lattice bounds.  The chunk's own bounds
+ *  are [min, max]. */
+void model_add_chunk(model_t* model, GLuint vbo, GLuint ibo,
+                     uint32_t tri_count, GLenum index_type,
+                     const model_cluster_t* clusters, unsigned cluster_count,
+                     bool quantized, const float lattice_min[3],
+                     const float lattice_max[3],
+                     const float min[3], const float max[3]);
+
+/*  Hands copies of a chunk's buffer contents to the model, which takes
+ *  ownership of them (they must be allocated with mem_malloc).  This is
+ *  used for chunks added with zero vbo and ibo, which are uploaded by
+ *  model_upload_chunk when they're needed. */
+void model_set_data(model_t* model, unsigned chunk,
+                    void* vertex_data, size_t vbo_bytes,
+                    void* index_data, size_t ibo_bytes);
+
+/*  Uploads a chunk's buffers from its copies in RAM, returning false
+ *  (and leaving it non-resident) if the GPU is out of memory */
+bool model_upload_chunk(model_t* model, unsigned chunk);
+
+/*  Frees a resident chunk's buffers, leaving its copies in RAM */
+void model_evict_chunk(model_t* model, unsigned chunk);
+
+/*  Uploads feature edges for a chunk, as pairs of 32-bit indices */
+void model_set_lines(model_t* model, unsigned chunk,
+                     const uint32_t* lines, uint32_t line_count);
+
+/*  Uploads levels of detail for a chunk, given every level's triangles
+ *  as 32-bit indices (which are stored as 16-bit indices if they fit) */
+void model_set_lods(model_t* model, unsigned chunk,
+                    const model_lod_t* lods, unsigned lod_count,
+                    const uint32_t* indices, uint32_t index_count);
+
+/*  Copies a chunk's clusters to the GPU, and allocates a command per
+ *  cluster.  Requires OpenGL 4.3. */
+void model_upload_clusters(model_t* model, unsigned chunk);
+
+#endif
@@ -0,0 +1,17 @@
+#include "base.h"
+
+struct arena_;
+
+/*  Bits per axis when quantizing positions to a Morton code */
+#define MORTON_BITS 10
+
+/*  Interleaves the low MORTON_BITS bits of each coordinate */
+uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z);
+
+/*  Sorts triangles in place along a Morton curve through their centroids,
+ *  quantized within the bounds [min, max].  tris holds 3 * tri_count
+ *  1-based indices into verts (so verts[0] is unused), as produced by a
+ *  vset.  The sort is stable, so coincident triangles keep their order. */
+void morton_sort(struct arena_* arena, uint32_t* tris, size_t tri_count,
+                 const float (*verts)[3],
+                 const float min[3], const float max[3]);
@@ -0,0 +1,29 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "base.h"
+
+/*  Settings which can be changed from the environment, e.g. to benchmark
+ *  with and without an optimization.  These are read once at startup,
+ *  then copied into each loader and model, so worker threads never read
+ *  anything that the main thread may change. */
+typedef struct options_ {
+    bool vcache;        /* ERIZO_VCACHE:  reorder for the vertex cache */
+    bool morton;        /* ERIZO_MORTON:  sort chunks along a Morton curve */
+    bool quantize;      /* ERIZO_QUANTIZE:  store 16-bit positions */
+    bool cull;          /* ERIZO_CULL:  cull clusters */
+    bool cull_gpu;      /* ERIZO_CULL_GPU:  cull on the GPU if possible */
+    bool lod;           /* ERIZO_LOD:  build and draw levels of detail */
+    bool staging;       /* ERIZO_STAGING:  fill chunks through a ring */
+
+    /*  ERIZO_GPU_BUDGET, in megabytes:  keeps every chunk in RAM and
+     *  streams it to the GPU when visible (see resident.h).  This is in
+     *  bytes, and zero (the default) means there's no budget. */
+    size_t gpu_budget;
+} options_t;
+
+/*  Reads options from the environment.  Everything is on by default, and
+ *  is turned off by setting its variable to 0. */
+void options_read(options_t* options);
+
+#endif
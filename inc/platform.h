@@ -8,10 +8,23 @@ const char* platform_mmap_data(platform_mmap_t* m);
 size_t platform_mmap_size(platform_mmap_t* m);
 void platform_munmap(platform_mmap_t* m);
 
+/*  Allocates and frees page-aligned memory directly from the OS.
+ *  If huge is true, the OS is advised to back it with huge pages. */
+void* platform_pages_alloc(size_t bytes, bool huge);
+void platform_pages_free(void* ptr, size_t bytes);
+
 /*  Returns time in microseconds */
 int64_t platform_get_time(void);
+
+/*  Returns the current and peak resident set size of the process,
+ *  in bytes (or 0 if it can't be determined) */
+size_t platform_get_rss(void);
+size_t platform_get_peak_rss(void);
 bool platform_is_tty(void);
 
+/*  Returns the number of online logical CPUs (at least 1) */
+unsigned platform_get_cpu_count(void);
+
 /*  Based on 8-color ANSI terminals */
 typedef enum {
     TERM_COLOR_BLACK,
@@ -0,0 +1,46 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "base.h"
+
+/*  A thread pool shared by every load in the app, so that loading
+ *  several files at once stays within a fixed thread budget.  Work is
+ *  submitted as tasks which never block, each belonging to a group
+ *  (one per load).  Free threads always run the oldest queued
+ *  task from the highest-priority group. */
+typedef struct pool_ pool_t;
+typedef struct pool_group_ pool_group_t;
+
+/*  Starts a pool with the given number of threads */
+pool_t* pool_new(unsigned thread_count);
+
+/*  Stops and joins every thread.  All groups must already be deleted. */
+void pool_delete(pool_t* pool);
+
+unsigned pool_thread_count(pool_t* pool);
+
+pool_group_t* pool_group_new(pool_t* pool);
+
+/*  Deletes a group, which must have no queued or running tasks */
+void pool_group_delete(pool_group_t* group);
+
+/*  Sets the priority of a group's queued tasks (higher runs first) */
+void pool_group_set_priority(pool_group_t* group, int priority);
+
+/*  Queues fn(data) to run on the pool.  Tasks submitted to a cancelled
+ *  group are dropped. */
+void pool_submit(pool_group_t* group, void (*fn)(void*), void* data);
+
+/*  Like pool_submit, but the task runs before the group's other queued
+ *  tasks.  This is used for work that frees up memory or lets the main
+ *  thread make progress. */
+void pool_submit_front(pool_group_t* group, void (*fn)(void*), void* data);
+
+/*  Waits until every task submitted to the group has run or been dropped */
+void pool_group_wait(pool_group_t* group);
+
+/*  Drops the group's queued tasks, returning their threads to other
+ *  groups.  Tasks which are already running are left to finish. */
+void pool_group_cancel(pool_group_t* group);
+
+#endif
@@ -0,0 +1,56 @@
+#include "base.h"
+
+struct backdrop_;
+
+/*  Adaptive render quality.  While the view is moving, frames are drawn
+ *  into a reduced-resolution offscreen framebuffer (without MSAA) and
+ *  upscaled, with the resolution chosen to keep GPU frame times under a
+ *  target.  Once the view settles, a full-quality frame is drawn. */
+typedef struct quality_ quality_t;
+
+/*  Anti-aliasing modes.  The MSAA modes set the sample count of each
+ *  window's framebuffer.  Post-process AA always draws the scene into the
+ *  single-sampled offscreen framebuffer, then smooths edges with FXAA
+ *  while copying it to the window, which is much cheaper on large windows
+ *  and software renderers. */
+typedef enum {
+    QUALITY_AA_MSAA8,
+    QUALITY_AA_MSAA4,
+    QUALITY_AA_FXAA,
+    QUALITY_AA_NONE,
+    QUALITY_AA_COUNT,
+} quality_aa_t;
+
+/*  Returns the mode selected by the ERIZO_AA environment variable
+ *  (e.g. ERIZO_AA=fxaa), defaulting to 8x MSAA */
+quality_aa_t quality_aa_get(void);
+
+/*  Returns the number of samples to request for the window framebuffer */
+int quality_aa_samples(quality_aa_t aa);
+const char* quality_aa_name(quality_aa_t aa);
+
+/*  Constructs a quality controller.  Requires an OpenGL context, which
+ *  should have been created with quality_aa_samples(aa) samples. */
+quality_t* quality_new(quality_aa_t aa);
+void quality_delete(quality_t* quality);
+
+/*  Records input which changed the view.  Frames are drawn at reduced
+ *  quality until a short time after the last such input. */
+void quality_interact(quality_t* quality);
+
+/*  Feeds back the GPU time (in ms) of the most recent frame with timing
+ *  results (or a negative value if there isn't one), along with the
+ *  target frame time.  Call once per frame, before quality_begin. */
+void quality_update(quality_t* quality, float frame_ms, float target_ms);
+
+/*  Starts drawing a frame.  If moving is true (or there was recent input)
+ *  and full-quality frames have been too slow, this binds the offscreen
+ *  framebuffer and a reduced viewport.  Returns true in that case, where
+ *  the caller should schedule another frame so that the full-quality
+ *  frame is drawn once the view settles. */
+bool quality_begin(quality_t* quality, bool moving);
+
+/*  Finishes the frame, upscaling into the framebuffer that was bound in
+ *  quality_begin (using the backdrop's quad) if it was drawn at reduced
+ *  resolution */
+void quality_end(quality_t* quality, struct backdrop_* backdrop);
@@ -0,0 +1,33 @@
+#include "base.h"
+
+/*  Vertex positions may be stored as normalized 16-bit integers within
+ *  the model's bounding box, which halves the size of the vertex buffer.
+ *  Every chunk is quantized onto this one lattice, so a vertex shared
+ *  by two chunks rounds to the same position in both, and there are no
+ *  cracks along chunk seams.
+ *
+ *  The rounding error is at most half a lattice step on each axis.  A
+ *  model is only quantized if that's under a pixel when its shortest
+ *  edge is drawn QUANTIZE_EDGE_PIXELS long, i.e. at any zoom where its
+ *  finest detail is still barely visible; otherwise, it keeps 32-bit
+ *  float positions. */
+#define QUANTIZE_MAX 65535
+#define QUANTIZE_EDGE_PIXELS 8.0f
+
+/*  Checks whether a model with the given bounds and shortest (non-zero)
+ *  edge length can be quantized within the error bound.  This requires
+ *  finite bounds, so models with NaN / inf vertices (which should pass
+ *  an edge length of zero) or no vertices at all are left as floats. */
+bool quantize_check(const float min[3], const float max[3], float edge);
+
+/*  Converts positions to normalized 16-bit integers within [min, max] */
+void quantize_encode(const float (*verts)[3], size_t count,
+                     const float min[3], const float max[3],
+                     uint16_t (*out)[3]);
+
+/*  Rounds positions to the values that the GPU will see once they've been
+ *  encoded, so that anything derived from them (e.g. culling bounds)
+ *  matches what's drawn */
+void quantize_round(const float (*verts)[3], size_t count,
+                    const float min[3], const float max[3],
+                    float (*out)[3]);
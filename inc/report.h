@@ -0,0 +1,144 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "base.h"
+#include "mem.h"
+#include "vset.h"
+
+typedef enum {
+    REPORT_FORMAT_BINARY,
+    REPORT_FORMAT_ASCII,
+    REPORT_FORMAT_BUILTIN,
+} report_format_t;
+
+/*  Per-worker results, recorded before the worker's vset is discarded */
+typedef struct report_worker_ {
+    uint32_t tri_count;
+    uint32_t vert_count;
+    uint32_t nan_count;     /* Vertices with a NaN / inf coordinate */
+    vset_stats_t vset;
+    float acmr[2];          /* Before and after reordering */
+    int64_t time_vcache;
+    bool quantized;         /* Vertices are stored as 16-bit positions */
+    unsigned index_size;    /* Bytes per index */
+    unsigned range_count;   /* Base-vertex ranges (see model.h) */
+    unsigned cluster_count;
+    unsigned lod_count;     /* Simplified levels of detail */
+    int64_t time_lod;
+} report_worker_t;
+
+/*  Memory usage, sampled whenever the loader changes state */
+typedef struct report_sample_ {
+    const char* stage;
+    int64_t time;           /* Since the start of the load */
+    size_t rss;             /* Resident set size of the whole process */
+    size_t tracked;         /* Bytes tracked by mem.h, across subsystems */
+} report_sample_t;
+
+#define REPORT_MAX_SAMPLES 8
+
+/*  Structured summary of a single load, populated by the loader thread.
+ *  Times are in microseconds, measured from the start of the load. */
+typedef struct report_ {
+    const char* filename;
+    report_format_t format;
+    size_t file_size;
+
+    uint32_t tri_count;
+    uint32_t vert_count;    /* Total vertices in the VBO */
+    uint32_t nan_count;
+    uint32_t line_count;    /* Feature edges */
+
+    /*  Edges which keep the mesh from being closed and consistently wound
+     *  (see edges.h), and its signed volume (if there are none) */
+    uint32_t flaw_count;
+    double volume;
+
+    /*  Average cache miss ratio (vertices shaded per triangle, in a FIFO
+     *  cache of VCACHE_SIZE) in file order and as uploaded, and whether
+     *  chunks were sorted spatially and reordered for the vertex cache */
+    float acmr[2];
+    bool morton;
+    bool vcache;
+
+    /*  Size of every chunk's vertex buffer, and how many chunks were
+     *  quantized to 16-bit positions */
+    size_t vbo_bytes;
+    unsigned quantized_count;
+
+    /*  Size of every chunk's index buffer, and how many chunks use 16-bit
+     *  indices (drawn in a total of range_count base-vertex ranges) */
+    size_t ibo_bytes;
+    unsigned short_index_count;
+    unsigned range_count;
+    unsigned cluster_count; /* Culled as units (see cull.h) */
+
+    /*  Triangles across every chunk's levels of detail, and whether they
+     *  were built (see lod.h) */
+    uint32_t lod_tri_count;
+    bool lod;
+
+    unsigned worker_count;
+    report_worker_t* workers;
+
+    /*  Instruction set used by the loader's kernels (see simd.h) */
+    const char* simd;
+
+    /*  Peak resident set size of the process at the end of the load */
+    size_t peak_rss;
+
+    /*  Tracked allocations at the end of the load.  Peaks are high-water
+     *  marks for the whole process, so they include concurrent loads. */
+    mem_stats_t mem;
+
+    unsigned sample_count;
+    report_sample_t samples[REPORT_MAX_SAMPLES];
+
+    /*  Duration of each stage of the load */
+    int64_t time_open;      /* Mapping or generating the file */
+    int64_t time_parse;     /* Converting ASCII to binary */
+    int64_t time_dedup;     /* Workers measuring and building vertex sets */
+    int64_t time_copy;      /* Uploading chunks left after dedup finished */
+    int64_t time_edges;     /* Matching feature edges between chunks */
+    int64_t time_total;
+
+    /*  Time from the start of the load until the first chunk was added
+     *  to the model, which overlaps with the stages above */
+    int64_t time_first_chunk;
+} report_t;
+
+/*  Records RSS and tracked memory for the given stage */
+void report_sample(report_t* report, const char* stage, int64_t time);
+
+/*  Writes tracked memory statistics as a JSON object */
+void report_write_mem_json(const mem_stats_t* mem, FILE* out);
+
+/*  Sums time spent reordering chunks, across workers */
+int64_t report_vcache_time(const report_t* report);
+
+/*  Sums time spent building levels of detail, across workers */
+int64_t report_lod_time(const report_t* report);
+
+/*  Ratio of raw STL vertices to deduplicated vertices */
+float report_dedup_ratio(const report_t* report);
+
+const char* report_format_string(report_format_t format);
+
+/*  Prints the report to the log at the info level */
+void report_log(const report_t* report);
+
+/*  Writes the report as a single-line JSON object */
+void report_write_json(const report_t* report, FILE* out);
+
+/*  Writes a string as a quoted, escaped JSON string */
+void report_write_string(const char* s, FILE* out);
+
+/*  Opens the file named by the ERIZO_REPORT environment variable for
+ *  appending.  Returns NULL if it is unset or can't be opened. */
+FILE* report_open(void);
+
+/*  Appends the report to the file named by the ERIZO_REPORT environment
+ *  variable, if it is set.  Does nothing otherwise. */
+void report_save(const report_t* report);
+
+#endif
@@ -0,0 +1,26 @@
+#include "base.h"
+
+struct camera_;
+struct model_;
+
+/*  Chunks of very large models can be kept in RAM and streamed to the GPU
+ *  as they come into view, so that the model doesn't need to fit in GPU
+ *  memory.  This is only done if the model's options set a budget (see
+ *  options.h), in which case every chunk is kept in RAM.  Every frame,
+ *  visible chunks are uploaded (up to this many bytes per frame, so that
+ *  a sudden change of view doesn't stall), and the least recently
+ *  visible chunks are evicted to stay within the budget. */
+#define RESIDENT_UPLOAD_BYTES (32 << 20)
+
+/*  If the GPU runs out of memory, a model's budget is shrunk to what fit,
+ *  then raised by RESIDENT_UPLOAD_BYTES after this many microseconds (and
+ *  again after each interval), until it's back to the full budget */
+#define RESIDENT_RETRY_US 1000000
+
+/*  Uploads visible chunks which aren't resident (see model_set_data), and
+ *  evicts others to make room for them.  Every buffer of the model counts
+ *  against the budget, but only chunks with copies in RAM can be evicted;
+ *  the rest (and each chunk's lines, levels of detail, and clusters) are
+ *  always resident.  Returns true if visible chunks are still waiting to
+ *  be uploaded, in which case the caller should draw another frame. */
+bool resident_update(struct model_* model, const struct camera_* camera);
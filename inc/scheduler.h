@@ -0,0 +1,29 @@
+#include "base.h"
+
+/*  Decides when the main loop draws a frame.  Input that arrives between
+ *  frames is coalesced (the main loop handles it all, then draws once),
+ *  frames are paced to the display's refresh rate, and the loop sleeps
+ *  until the next event when nothing is animating.
+ *
+ *  The ERIZO_FRAME_CAP environment variable (e.g. ERIZO_FRAME_CAP=30)
+ *  sets a lower frame rate limit than the display's. */
+typedef struct scheduler_ scheduler_t;
+
+scheduler_t* scheduler_new(void);
+
+/*  Logs frame statistics (and appends them to the ERIZO_REPORT file,
+ *  if it is set), then frees the scheduler */
+void scheduler_delete(scheduler_t* scheduler);
+
+/*  Processes events until the next frame is due.  If animating is false,
+ *  this sleeps until an event arrives; either way, it then keeps handling
+ *  events until a full frame interval has passed since the last frame. */
+void scheduler_wait(scheduler_t* scheduler, bool animating);
+
+/*  Returns the target time between frames, in milliseconds */
+float scheduler_get_interval_ms(const scheduler_t* scheduler);
+
+/*  Records that a frame has been drawn.  If the previous frame was part
+ *  of an animation, any refresh intervals skipped since then are
+ *  counted as missed frames. */
+void scheduler_frame(scheduler_t* scheduler);
@@ -1,3 +1,6 @@
+#ifndef SHADER_H
+#define SHADER_H
+
 #include "base.h"
 
 #define GLSL(version, shader)  "#version " #version "\n" #shader
@@ -6,15 +9,29 @@ typedef struct shader_ {
     GLuint vs;
     GLuint gs;
     GLuint fs;
+    GLuint cs;
     GLuint prog;
 } shader_t;
 
+/*  Builds a program, or returns the existing one with the same sources.
+ *  Programs are shared by every window, so their uniforms must be set
+ *  before each use rather than once after building. */
 shader_t shader_new(const char* vs, const char* gs, const char* fs);
+
+/*  Builds a compute shader program, which requires OpenGL 4.3 */
+shader_t shader_new_compute(const char* cs);
+
+/*  Releases a reference to a program, deleting it once unused */
 void shader_deinit(shader_t shader);
 
+/*  Assigns a uniform block to a uniform buffer binding point */
+void shader_set_block(GLuint prog, const char* name, GLuint binding);
+
 #define SHADER_GET_UNIFORM(target) do {                 \
     u.target = glGetUniformLocation(prog, #target);     \
     if (u.target == -1) {                               \
         log_error("Failed to get uniform " #target);    \
     }                                                   \
 } while(0)
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "base.h"
+
+/*  Instruction sets with kernel implementations, in increasing order
+ *  of preference on their respective architectures */
+typedef enum {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_NEON,
+    SIMD_LEVEL_COUNT,
+} simd_level_t;
+
+/*  Hot loops used when loading a model.  Every instruction set produces
+ *  bit-identical results to the scalar reference implementations. */
+typedef struct simd_kernels_ {
+    simd_level_t level;
+
+    /*  Copies the vertices of tri_count triangles from binary STL data
+     *  into a packed array of 9 floats per triangle.  stl points to the
+     *  first vertex of the first triangle, and may be unaligned. */
+    void (*destride)(const char (*stl)[50], size_t tri_count, float* out);
+
+    /*  Computes XXH32(vert, 12, 0) for each vertex, matching vset_insert */
+    void (*hash)(const float (*verts)[3], size_t count, uint32_t* out);
+
+    /*  Expands min and max to include every vertex, skipping NaN and
+     *  infinite coordinates.  Returns the number of vertices which
+     *  contain at least one such coordinate. */
+    uint32_t (*bounds)(const float (*verts)[3], size_t count,
+                       float min[3], float max[3]);
+
+    /*  Returns a pointer to the first occurrence of "vertex " in the
+     *  range [data, end), or NULL if there isn't one. */
+    const char* (*find_vertex)(const char* data, const char* end);
+} simd_kernels_t;
+
+/*  Detects CPU features and selects kernels.  The ERIZO_SIMD environment
+ *  variable (e.g. ERIZO_SIMD=scalar) may be used to select a lower level.
+ *  Must be called before simd_get(). */
+void simd_init(void);
+
+/*  Returns the kernels selected by simd_init() */
+const simd_kernels_t* simd_get(void);
+
+/*  Returns kernels for a specific level, or NULL if they aren't compiled
+ *  in or aren't supported by this CPU.  Used to test against the scalar
+ *  reference implementation. */
+const simd_kernels_t* simd_get_level(simd_level_t level);
+
+const char* simd_level_name(simd_level_t level);
+
+/*  Architecture-specific kernels, which return NULL if unsupported */
+const simd_kernels_t* simd_x86_kernels(simd_level_t level);
+const simd_kernels_t* simd_neon_kernels(void);
+
+#endif
@@ -0,0 +1,56 @@
+#include "base.h"
+
+/*  With OpenGL 4.4 (or ARB_buffer_storage), chunks are filled through a
+ *  staging ring:  one buffer which stays mapped for its whole lifetime, so
+ *  workers write into it directly and the main thread never maps or unmaps
+ *  anything.  Each chunk's region is copied into its own buffers on the
+ *  GPU, then a fence marks when the region can be reused. */
+#define STAGING_SIZE (32 << 20)
+
+/*  Maximum number of regions in flight (including those whose copies
+ *  the GPU hasn't finished yet) */
+#define STAGING_MAX_REGIONS 32
+
+/*  Alignment of every region, which is more than enough for any type */
+#define STAGING_ALIGN 64
+
+typedef struct staging_region_ {
+    size_t offset;
+    size_t bytes;       /* Including padding before the next region */
+    GLsync fence;       /* Zero until the region is released */
+} staging_region_t;
+
+typedef struct staging_ {
+    GLuint buf;
+    uint8_t* ptr;
+
+    /*  Regions are allocated at the head, and reclaimed from the tail once
+     *  their fences have signalled, in allocation order */
+    size_t head;
+    size_t tail;
+    staging_region_t regions[STAGING_MAX_REGIONS];
+    unsigned first;
+    unsigned count;
+} staging_t;
+
+/*  Constructs a staging ring in the current OpenGL context, returning NULL
+ *  if it's not supported (in which case the caller should map
+ *  buffers itself) */
+staging_t* staging_new(void);
+
+/*  Deletes the ring.  Copies which are still in flight are unaffected. */
+void staging_delete(staging_t* staging);
+
+/*  Allocates a region, returning its index and storing a pointer to it in
+ *  ptr (which may be written from any thread until the region is copied).
+ *  Returns -1 without blocking if there's no room until the GPU catches
+ *  up, or if bytes is larger than the ring. */
+int staging_alloc(staging_t* staging, size_t bytes, void** ptr);
+
+/*  Copies part of a region into the start of a buffer, which must already
+ *  have storage for at least the given number of bytes */
+void staging_copy(staging_t* staging, int region, size_t offset,
+                  GLuint buffer, size_t bytes);
+
+/*  Marks a region as free once the GPU finishes the copies issued so far */
+void staging_release(staging_t* staging, int region);
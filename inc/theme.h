@@ -1,24 +1,28 @@
 #include "base.h"
 
+/*  The key, fill, and base colors are in a uniform block named theme (as
+ *  three std140 vec3s), which is bound to this uniform buffer binding point */
+#define THEME_BINDING 1
+
 typedef struct theme_ {
     float corners[4][3];
 
     float key[3];
     float fill[3];
     float base[3];
-} theme_t;
 
-typedef struct theme_uniforms_ {
-    GLint key;
-    GLint fill;
-    GLint base;
-} theme_uniforms_t;
+    /*  Uniform buffer with the model colors, which is created on first
+     *  use and shared by every window */
+    GLuint ubo;
+} theme_t;
 
 theme_t* theme_new_solarized(void);
 theme_t* theme_new_nord(void);
 theme_t* theme_new_gruvbox(void);
+void theme_delete(theme_t* theme);
 
-/*  Looks up uniforms for theme binding */
-theme_uniforms_t theme_get_uniforms(GLuint prog);
+/*  Assigns the program's theme uniform block to THEME_BINDING */
+void theme_get_uniforms(GLuint prog);
 
-void theme_bind(theme_t* theme, theme_uniforms_t u);
+/*  Binds the theme's uniform buffer */
+void theme_bind(theme_t* theme);
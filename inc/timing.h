@@ -0,0 +1,75 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "base.h"
+
+/*  Stages of a frame which are timed on the GPU */
+typedef enum {
+    TIMING_BACKDROP,
+    TIMING_MODEL,
+    TIMING_HUD,
+    TIMING_STAGE_COUNT,
+} timing_stage_t;
+
+/*  Number of frames kept for rolling statistics */
+#define TIMING_HISTORY 128
+
+/*  Rolling statistics over the most recent frames, in milliseconds */
+typedef struct timing_stats_ {
+    unsigned frames;        /* Frames with complete GPU results */
+    float cpu_mean;
+    float cpu_max;
+    float swap_mean;        /* CPU time spent swapping buffers */
+    float swap_max;
+    float gpu_mean[TIMING_STAGE_COUNT];
+    float gpu_max[TIMING_STAGE_COUNT];
+    float gpu_total_mean;
+    float gpu_total_max;
+} timing_stats_t;
+
+typedef struct timing_ timing_t;
+
+/*  Constructs a new frame timer.  Requires an OpenGL context. */
+timing_t* timing_new(const char* name);
+void timing_delete(timing_t* timing);
+
+/*  Marks the start and end of a frame.  Results from earlier frames are
+ *  collected in timing_frame_begin, but only if the GPU has already
+ *  finished with them, so this never stalls the pipeline. */
+void timing_frame_begin(timing_t* timing);
+void timing_frame_end(timing_t* timing);
+
+/*  Wraps a stage of the frame in a GL_TIME_ELAPSED query.
+ *  Stages may not be nested. */
+void timing_begin(timing_t* timing, timing_stage_t stage);
+void timing_end(timing_t* timing);
+
+/*  Wraps the buffer swap, which is timed on the CPU (since it issues no
+ *  GPU work of its own, but may block until the GPU catches up).  This
+ *  time is also included in the frame's CPU time. */
+void timing_swap_begin(timing_t* timing);
+void timing_swap_end(timing_t* timing);
+
+/*  Looks up the GPU time (in ms) of a stage for a frame in the history,
+ *  where age 0 is the most recent frame with results.  Returns a
+ *  negative value if there's no result for that frame. */
+float timing_get_gpu(const timing_t* timing, unsigned age,
+                     timing_stage_t stage);
+
+/*  Looks up the CPU time (in ms) of a recent frame, or a negative value */
+float timing_get_cpu(const timing_t* timing, unsigned age);
+
+/*  Looks up the swap time (in ms) of a recent frame, or a negative value */
+float timing_get_swap(const timing_t* timing, unsigned age);
+
+void timing_get_stats(const timing_t* timing, timing_stats_t* stats);
+const char* timing_stage_name(timing_stage_t stage);
+
+/*  Writes rolling statistics as a single-line JSON object */
+void timing_write_json(const timing_t* timing, FILE* out);
+
+/*  Appends rolling statistics to the ERIZO_REPORT file, if it is set
+ *  and at least one frame has been drawn */
+void timing_save(const timing_t* timing);
+
+#endif
@@ -0,0 +1,30 @@
+#include "base.h"
+
+struct arena_;
+
+/*  Size of the FIFO post-transform cache that triangles are ordered for,
+ *  and which is simulated to measure the average cache miss ratio (ACMR,
+ *  i.e. vertices shaded per triangle) */
+#define VCACHE_SIZE 16
+
+/*  Returns the ACMR of the triangles in a FIFO cache of VCACHE_SIZE.
+ *  tris holds 3 * tri_count 1-based indices (as produced by a vset), and
+ *  vert_count is the largest index. */
+float vcache_acmr(struct arena_* arena, const uint32_t* tris,
+                  size_t tri_count, size_t vert_count);
+
+/*  Reorders triangles in place to improve vertex cache hits, using
+ *  Tipsify (Sander, Nehab, and Barczak 2007), which runs in linear time.
+ *  Indices are 1-based, as above.  Triangles are only reordered within
+ *  each run of run_tris, so that runs which are already spatially compact
+ *  (e.g. clusters of Morton-sorted triangles) stay that way; passing
+ *  tri_count reorders them all together, which gives the lowest ACMR. */
+void vcache_optimize(struct arena_* arena, uint32_t* tris, size_t tri_count,
+                     size_t vert_count, size_t run_tris);
+
+/*  Renumbers vertices in the order that triangles first use them, so that
+ *  vertex fetches walk forward through the buffer.  verts is indexed by
+ *  the 1-based indices (i.e. verts[0] is unused) and is permuted in place;
+ *  every vertex must be used by at least one triangle. */
+void vcache_reorder(struct arena_* arena, uint32_t* tris, size_t tri_count,
+                    float (*verts)[3], size_t vert_count);
@@ -1,3 +1,6 @@
+#ifndef VSET_H
+#define VSET_H
+
 #include "base.h"
 
 /*  Used to refer to nodes within the tree */
@@ -17,14 +20,33 @@ typedef struct vset_ {
     uint32_t num_buckets;
 
     uint32_t count;             /* Number of used nodes */
+    uint32_t rehash_count;      /* Number of times the table has grown */
 } vset_t;
 
-/*  Constructs a new vset */
+/*  Summary of hash table behavior, used in the load report */
+typedef struct vset_stats_ {
+    uint32_t count;
+    uint32_t num_buckets;
+    uint32_t occupied_buckets;
+    uint32_t max_chain;
+    float mean_chain;           /* Averaged over occupied buckets */
+    uint32_t rehash_count;
+} vset_stats_t;
+
+/*  Constructs a new vset, whose arrays are allocated on the heap (tracked
+ *  as MEM_VSET), so that they can grow without leaving old copies behind */
 vset_t* vset_new(void);
 void vset_delete(vset_t* v);
 
 /*  Inserts a vertex (three floats) into the set, returning an index */
 uint32_t vset_insert(vset_t* restrict v, const float* restrict f);
 
-/*  Prints statistics about the hashset */
-void vset_print_stats(vset_t* v);
+/*  Inserts a vertex with a precomputed hash, which must match the hash
+ *  used by vset_insert (i.e. from the hash kernel in simd.h) */
+uint32_t vset_insert_hashed(vset_t* restrict v, const float* restrict f,
+                            uint32_t hash);
+
+/*  Walks the hashset and collects statistics about it */
+void vset_get_stats(vset_t* v, vset_stats_t* stats);
+
+#endif
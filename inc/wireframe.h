@@ -1,4 +1,15 @@
 #include "base.h"
 
-struct draw_;
-struct draw_* wireframe_new(void);
+struct camera_;
+struct model_;
+struct theme_;
+
+/*  Draws a model with shading, darkening pixels near triangle edges */
+typedef struct wireframe_ wireframe_t;
+
+/*  Constructs a wireframe drawer.  Requires an OpenGL context. */
+wireframe_t* wireframe_new(void);
+void wireframe_delete(wireframe_t* wireframe);
+
+void wireframe_draw(wireframe_t* wireframe, struct model_* model,
+                    struct camera_* camera, struct theme_* theme);
@@ -1,15 +1,70 @@
 #include "base.h"
+#include "edges.h"
+#include "lod.h"
+#include "model.h"
+#include "vset.h"
 
+/*  Number of triangles which are de-strided and hashed at once */
+#define WORKER_BLOCK_SIZE 1024
+
+/*  Number of values copied to the GPU between cancellation checks */
+#define WORKER_COPY_SIZE (1 << 16)
+
+struct arena_;
+
+/*  Progress of a worker's chunk, which is read and written atomically
+ *  since it is shared between pool threads and the main thread */
+typedef enum worker_state_ {
+    WORKER_DEDUP,       /* Building the vertex set */
+    WORKER_READY,       /* Waiting for the main thread to map buffers */
+    WORKER_MAPPED,      /* Copying into mapped buffers */
+    WORKER_COPIED,      /* Waiting for the main thread to unmap buffers */
+    WORKER_UPLOADED,    /* Buffers belong to the model */
+} worker_state_t;
+
+/*  A worker handles one chunk of the model:  a contiguous range of
+ *  triangles, which is deduplicated and drawn independently of the others.
+ *  Its work is split into two tasks for the app's thread pool, neither
+ *  of which blocks:  worker_dedup builds the vertex set and reorders it
+ *  spatially and for the vertex cache, then (once the main thread has
+ *  mapped the chunk's buffers) worker_copy fills them, then finds the
+ *  chunk's feature edges and builds its levels of detail. */
 typedef struct worker_ {
-    struct platform_thread_* thread;
     struct loader_* loader;
+    const struct options_* options; /* The loader's */
+    worker_state_t state;
 
     /*  Mesh input */
     const char (*stl)[50];
 
-    /*  Mapped OpenGL vertex and index buffer */
-    float *vertex_buf;
-    uint32_t *index_buf;
+    /*  OpenGL vertex and index buffer for this chunk, and their mapped
+     *  pointers.  These are only touched by worker_copy while the state
+     *  is WORKER_MAPPED, and otherwise belong to the main thread. */
+    GLuint vbo;
+    GLuint ibo;
+    void *vertex_buf;
+    void *index_buf;
+
+    /*  Set if the mapped pointers are into a region of the loader's
+     *  staging ring (see staging.h), in which case vbo and ibo are
+     *  created when the chunk is copied out of it */
+    bool staged;
+    int region;
+
+    /*  Whether vertices are stored as 16-bit positions (see quantize.h),
+     *  which is decided for the whole model before dedup starts, and the
+     *  model's bounds that positions are quantized within */
+    bool quantized;
+    float lattice_min[3];
+    float lattice_max[3];
+
+    /*  Index type and clusters (within base-vertex ranges), also decided
+     *  after dedup.  The clusters array is tracked as MEM_LOADER and
+     *  copied by the model. */
+    GLenum index_type;
+    model_cluster_t* clusters;
+    unsigned cluster_count;
+    unsigned range_count;
 
     /*  Number of triangles to process */
     size_t tri_count;
@@ -17,14 +72,54 @@ typedef struct worker_ {
     /*  Calculated vertex count (after deduplication) */
     size_t vert_count;
 
-    /*  Offset applied to triangle indices before loading them into the GPU
-     *  buffer, since each worker starts numbering at 0 */
-    int32_t tri_offset;
+    /*  Feature edges, found by worker_copy once the chunk is uploaded.
+     *  Open edges are matched between chunks by the loader thread.  The
+     *  origin is shared by every chunk, for the mesh's signed volume. */
+    edges_t edges;
+    float origin[3];
+
+    /*  Levels of detail, which are also built once the chunk is uploaded
+     *  and added to the model after the load finishes */
+    lod_t lod;
+
+    /*  Index of this chunk in the model, once it has been added */
+    unsigned chunk;
 
     /*  Bounds for this set of vertices */
     float min[3];
     float max[3];
+
+    /*  Length of the shortest non-zero edge, or zero if any vertex isn't
+     *  finite, found by worker_measure */
+    float edge;
+
+    /*  Statistics for the load report */
+    uint32_t nan_count;
+    vset_stats_t stats;
+    float acmr[2];          /* Before and after reordering */
+    int64_t time_vcache;    /* Microseconds spent reordering */
+    int64_t time_lod;       /* Microseconds spent simplifying */
+
+    /*  Scratch data, held between the two tasks */
+    struct arena_* arena;
+    vset_t* vset;
+    uint32_t* tris;
 } worker_t;
 
-void worker_start(worker_t* worker);
-void worker_finish(worker_t* worker);
+/*  Pool tasks, where the argument is a worker_t*.  worker_measure is
+ *  run on every chunk before the others, if the model may be quantized. */
+void worker_measure(void* worker);
+void worker_dedup(void* worker);
+void worker_copy(void* worker);
+
+/*  Returns the size of this chunk's vertex or index buffer, in bytes */
+size_t worker_vbo_bytes(const worker_t* worker);
+size_t worker_ibo_bytes(const worker_t* worker);
+
+/*  Releases scratch data, if it hasn't already been released by
+ *  worker_copy (e.g. because the load was abandoned) */
+void worker_release(worker_t* worker);
+
+/*  Frees the clusters array, once the chunk has been added to the model
+ *  or the load has been abandoned */
+void worker_free_clusters(worker_t* worker);
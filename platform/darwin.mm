@@ -10,6 +10,7 @@ extern "C" {
 #import <Foundation/Foundation.h>
 #import <Foundation/NSObjCRuntime.h>
 #import <objc/runtime.h>
+#include <mach/mach.h>
 
 @interface InstanceHandle : NSObject {
 @public
@@ -25,6 +26,7 @@ extern "C" {
 
     NSMenuItem* shaded;
     NSMenuItem* wireframe;
+    NSMenuItem* edges;
 
     NSMenuItem* perspective;
     NSMenuItem* orthographic;
@@ -65,15 +67,24 @@ extern "C" {
 -(void) onShaded {
     [self->shaded setState:NSControlStateValueOn];
     [self->wireframe setState:NSControlStateValueOff];
+    [self->edges setState:NSControlStateValueOff];
     app_view_shaded(self->app);
 }
 
 -(void) onWireframe {
     [self->shaded setState:NSControlStateValueOff];
     [self->wireframe setState:NSControlStateValueOn];
+    [self->edges setState:NSControlStateValueOff];
     app_view_wireframe(self->app);
 }
 
+-(void) onEdges {
+    [self->shaded setState:NSControlStateValueOff];
+    [self->wireframe setState:NSControlStateValueOff];
+    [self->edges setState:NSControlStateValueOn];
+    app_view_edges(self->app);
+}
+
 -(void) onPerspective {
     [self->perspective setState:NSControlStateValueOn];
     [self->orthographic setState:NSControlStateValueOff];
@@ -204,6 +215,17 @@ extern "C" void platform_init(app_t* app, int argc, char** argv)
         GLUE->wireframe = wireframe;
     }
 
+    {
+        NSMenuItem *edges = [[[NSMenuItem alloc]
+            initWithTitle:@"Edges"
+            action:@selector(onEdges)
+            keyEquivalent:@""
+            ] autorelease];
+        edges.target = GLUE;
+        [viewMenu addItem:edges];
+        GLUE->edges = edges;
+    }
+
     [viewMenu addItem:[NSMenuItem separatorItem]];
 
     {
@@ -240,6 +262,16 @@ extern "C" void platform_init(app_t* app, int argc, char** argv)
     aboutItem.target = GLUE;
 }
 
+extern "C" size_t platform_get_rss(void) {
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+}
+
 extern "C" void platform_warning(const char* title, const char* text) {
     NSAlert *alert = [[NSAlert alloc] init];
     [alert setMessageText:[NSString stringWithUTF8String:title]];
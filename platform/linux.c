@@ -1,3 +1,5 @@
+#include <unistd.h>
+
 #include "app.h"
 #include "log.h"
 #include "window.h"
@@ -23,6 +25,17 @@ void platform_init(app_t* app, int argc, char** argv) {
     }
 }
 
+size_t platform_get_rss(void) {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    unsigned long size, resident;
+    const int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return (n == 2) ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
@@ -1,7 +1,11 @@
+/*  base.h must come first, since it sets feature macros */
+#include "base.h"
+
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -54,6 +58,28 @@ size_t platform_mmap_size(platform_mmap_t* m) {
     return m->size;
 }
 
+void* platform_pages_alloc(size_t bytes, bool huge) {
+    void* ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (ptr == MAP_FAILED) {
+        log_error("Anonymous mmap failed (errno: %i)", errno);
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    /*  Transparent huge pages are only a hint, so ignore failures */
+    if (huge) {
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+    }
+#else
+    (void)huge;
+#endif
+    return ptr;
+}
+
+void platform_pages_free(void* ptr, size_t bytes) {
+    munmap(ptr, bytes);
+}
+
 int64_t platform_get_time() {
     static struct timeval t;
     gettimeofday(&t, NULL);
@@ -61,6 +87,18 @@ int64_t platform_get_time() {
     return t.tv_sec * 1000000 + t.tv_usec;
 }
 
+size_t platform_get_peak_rss() {
+    struct rusage r;
+    if (getrusage(RUSAGE_SELF, &r)) {
+        return 0;
+    }
+#ifdef PLATFORM_DARWIN
+    return r.ru_maxrss;         /* Reported in bytes */
+#else
+    return r.ru_maxrss * 1024;  /* Reported in kilobytes */
+#endif
+}
+
 void platform_set_terminal_color(FILE* f, platform_terminal_color_t c) {
     fprintf(f, "\x1b[3%im", c - TERM_COLOR_BLACK);
 }
@@ -160,3 +198,8 @@ const char* platform_filename(const char* filepath) {
 bool platform_is_tty() {
     return isatty(STDOUT_FILENO);
 }
+
+unsigned platform_get_cpu_count() {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? n : 1;
+}
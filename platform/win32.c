@@ -1,5 +1,6 @@
 #define _WIN32_WINNT _WIN32_WINNT_WIN7
 #include <windows.h>
+#include <psapi.h>
 
 #include "app.h"
 #include "instance.h"
@@ -60,6 +61,23 @@ void platform_munmap(platform_mmap_t* m) {
     free(m);
 }
 
+void* platform_pages_alloc(size_t bytes, bool huge) {
+    /*  Large pages require special privileges on Windows, so they
+     *  aren't requested here. */
+    (void)huge;
+    void* ptr = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT,
+                             PAGE_READWRITE);
+    if (!ptr) {
+        log_error("VirtualAlloc failed (%lu)", GetLastError());
+    }
+    return ptr;
+}
+
+void platform_pages_free(void* ptr, size_t bytes) {
+    (void)bytes;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
 int64_t platform_get_time(void) {
     FILETIME t;
     GetSystemTimePreciseAsFileTime(&t);
@@ -69,6 +87,28 @@ int64_t platform_get_time(void) {
     return i.QuadPart / 10;
 }
 
+size_t platform_get_rss(void) {
+    PROCESS_MEMORY_COUNTERS c;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &c, sizeof(c))) {
+        return 0;
+    }
+    return c.WorkingSetSize;
+}
+
+size_t platform_get_peak_rss(void) {
+    PROCESS_MEMORY_COUNTERS c;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &c, sizeof(c))) {
+        return 0;
+    }
+    return c.PeakWorkingSetSize;
+}
+
+unsigned platform_get_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+}
+
 void platform_set_terminal_color(FILE* f, platform_terminal_color_t c) {
     (void)f;
     (void)c;
@@ -203,6 +243,7 @@ void platform_init(app_t* app, int argc, char** argv) {
 #define ID_VIEW_WIREFRAME       9004
 #define ID_VIEW_ORTHOGRAPHIC    9005
 #define ID_VIEW_PERSPECTIVE     9006
+#define ID_VIEW_EDGES           9007
 
 /*  We hot-swap the WNDPROC pointer from the one defined in GLFW to our
  *  own here, which lets us respond to menu events (ignored in GLFW). */
@@ -243,6 +284,8 @@ static LRESULT CALLBACK wndproc(HWND hWnd, UINT message,
                         ID_VIEW_SHADED, MF_CHECKED);
                 CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
                         ID_VIEW_WIREFRAME, MF_UNCHECKED);
+                CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
+                        ID_VIEW_EDGES, MF_UNCHECKED);
                 instance_view_shaded(app_get_front(app_handle));
                 break;
 
@@ -251,9 +294,21 @@ static LRESULT CALLBACK wndproc(HWND hWnd, UINT message,
                         ID_VIEW_SHADED, MF_UNCHECKED);
                 CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
                         ID_VIEW_WIREFRAME, MF_CHECKED);
+                CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
+                        ID_VIEW_EDGES, MF_UNCHECKED);
                 instance_view_wireframe(app_get_front(app_handle));
                 break;
 
+            case ID_VIEW_EDGES:
+                CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
+                        ID_VIEW_SHADED, MF_UNCHECKED);
+                CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
+                        ID_VIEW_WIREFRAME, MF_UNCHECKED);
+                CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
+                        ID_VIEW_EDGES, MF_CHECKED);
+                instance_view_edges(app_get_front(app_handle));
+                break;
+
             case ID_VIEW_ORTHOGRAPHIC:
                 CheckMenuItem(GetSubMenu(GetMenu(hWnd), 1),
                         ID_VIEW_PERSPECTIVE, MF_UNCHECKED);
@@ -293,6 +348,7 @@ void platform_window_bind(GLFWwindow* window) {
     AppendMenuW(view, MF_STRING, ID_VIEW_SHADED, L"Shaded");
     CheckMenuItem(view, ID_VIEW_SHADED, MF_CHECKED);
     AppendMenuW(view, MF_STRING, ID_VIEW_WIREFRAME, L"Wireframe");
+    AppendMenuW(view, MF_STRING, ID_VIEW_EDGES, L"Edges");
 
     AppendMenuW(view, MF_SEPARATOR, 0, NULL);
 
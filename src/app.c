@@ -2,21 +2,27 @@
 #include "backdrop.h"
 #include "camera.h"
 #include "instance.h"
+#include "loader.h"
 #include "log.h"
 #include "platform.h"
+#include "scheduler.h"
 
-instance_t* app_open(app_t* app, const char* filename) {
-    instance_t* instance = instance_new(app, filename, app->draw_proj);
-
-    /*  If loading failed, then do a special one-time drawing of
-     *  the backdrop, show an error dialog, and mark the window
-     *  as closing in the next event loop */
+/*  If loading failed, then do a special one-time drawing of
+ *  the backdrop, show an error dialog, and mark the window
+ *  as closing in the next event loop */
+static void app_check_error(app_t* app, instance_t* instance) {
     if (instance->error) {
+        glfwMakeContextCurrent(instance->window);
         backdrop_draw(instance->backdrop, app->theme);
         glfwSwapBuffers(instance->window);
         platform_warning("Loading the file failed", instance->error);
         glfwSetWindowShouldClose(instance->window, 1);
     }
+}
+
+instance_t* app_open(app_t* app, const char* filename) {
+    instance_t* instance = instance_new(app, filename, app->draw_proj);
+    app_check_error(app, instance);
 
     /*  Add this instance at the back of the array */
     if (app->instance_count == app->instances_size) {
@@ -30,6 +36,10 @@ instance_t* app_open(app_t* app, const char* filename) {
     }
     instance->draw_mode = app->draw_mode;
     app->instances[app->instance_count++] = instance;
+
+    /*  Rank the new load against the others as soon as it starts, rather
+     *  than waiting for the window system to report the focus change */
+    app_update_priorities(app);
     instance_cb_focus(instance, true);
     return instance;
 }
@@ -57,6 +67,13 @@ void app_view_wireframe(app_t* app) {
     }
 }
 
+void app_view_edges(app_t* app) {
+    app->draw_mode = DRAW_EDGES;
+    for (unsigned i=0; i < app->instance_count; ++i) {
+        instance_view_edges(app->instances[i]);
+    }
+}
+
 void app_view_orthographic(app_t* app) {
     app->draw_proj = CAMERA_PROJ_ORTHOGRAPHIC;
     for (unsigned i=0; i < app->instance_count; ++i) {
@@ -90,6 +107,16 @@ instance_t* app_get_front(app_t* app) {
     return app->instances[0];
 }
 
+void app_update_priorities(app_t* app) {
+    for (unsigned i=0; i < app->instance_count; ++i) {
+        instance_t* instance = app->instances[i];
+        if (instance->loader) {
+            loader_set_priority(instance->loader, instance->focused
+                    ? INT_MAX : (int)instance->serial);
+        }
+    }
+}
+
 bool app_run(app_t* app) {
     /*  On some platforms, we defer loading of files until the event loop
      *  begins running, so handle them all here. */
@@ -104,9 +131,21 @@ bool app_run(app_t* app) {
     }
 
     bool needs_redraw = false;
+    bool drew = false;
     unsigned i = 0;
     while (i < app->instance_count) {
-        needs_redraw |= instance_draw(app->instances[i], app->theme);
+        /*  Finish any loads which are ready, without blocking */
+        if (instance_check_loader(app->instances[i])) {
+            app_check_error(app, app->instances[i]);
+        }
+        /*  Only redraw windows where something has changed, so that
+         *  (for example) moving the mouse over one window doesn't redraw
+         *  every model that's open */
+        instance_flush_input(app->instances[i]);
+        if (app->instances[i]->dirty) {
+            needs_redraw |= instance_draw(app->instances[i], app->theme);
+            drew = true;
+        }
         if (glfwWindowShouldClose(app->instances[i]->window)) {
             instance_t* target = app->instances[i];
             const bool focused = target->focused;
@@ -127,9 +166,14 @@ bool app_run(app_t* app) {
         }
     }
 
-    if (needs_redraw) {
-        glfwPostEmptyEvent();
+    if (drew) {
+        scheduler_frame(app->scheduler);
     }
+    app->animating = needs_redraw;
 
     return app->instance_count;
 }
+
+void app_wait(app_t* app) {
+    scheduler_wait(app->scheduler, app->animating);
+}
@@ -0,0 +1,197 @@
+#include "arena.h"
+#include "log.h"
+#include "platform.h"
+
+/*  Blocks are allocated straight from the OS, in multiples of the
+ *  (typical) huge page size.  Allocations are 16-byte aligned. */
+#define ARENA_BLOCK_SIZE    ((size_t)4 << 20)
+#define ARENA_PAGE_SIZE     ((size_t)2 << 20)
+#define ARENA_ALIGN         ((size_t)16)
+
+/*  Upper bound on memory kept in the pool between loads */
+#define ARENA_POOL_RETAIN   ((size_t)1 << 30)
+
+typedef struct arena_block_ {
+    struct arena_block_* next;
+    size_t size;    /* Total size of the mapping, including this header */
+    size_t used;    /* Offset of the next allocation */
+} arena_block_t;
+
+/*  Keeps the first allocation in each block aligned */
+#define ARENA_HEADER \
+    ((sizeof(arena_block_t) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct arena_ {
+    arena_block_t* blocks;
+    arena_block_t* current;
+    size_t capacity;
+
+    /*  Most recent allocation, which can be grown in place */
+    void* last;
+
+    /*  Bytes handed out to each subsystem, so they can be un-charged
+     *  when the arena is released */
+    size_t used[MEM_SUBSYSTEM_COUNT];
+
+    /*  Link in the pool's free list */
+    struct arena_* next;
+};
+
+static platform_mutex_t* arena_pool_mutex = NULL;
+static arena_t* arena_pool = NULL;
+static size_t arena_pool_capacity = 0;
+static bool arena_huge_pages = true;
+
+void arena_init() {
+    assert(arena_pool_mutex == NULL);
+    arena_pool_mutex = platform_mutex_new();
+
+    /*  Transparent huge pages are used for arena blocks by default;
+     *  set ERIZO_HUGEPAGES=0 in the environment to disable them. */
+    const char* huge = getenv("ERIZO_HUGEPAGES");
+    if (huge && !strcmp(huge, "0")) {
+        arena_huge_pages = false;
+    }
+}
+
+static size_t arena_round(size_t bytes) {
+    return (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static arena_block_t* arena_block_new(arena_t* arena, size_t bytes) {
+    size_t size = ARENA_HEADER + bytes;
+    if (size < ARENA_BLOCK_SIZE) {
+        size = ARENA_BLOCK_SIZE;
+    }
+    size = (size + ARENA_PAGE_SIZE - 1) & ~(ARENA_PAGE_SIZE - 1);
+
+    arena_block_t* block = (arena_block_t*)platform_pages_alloc(
+            size, arena_huge_pages);
+    if (!block) {
+        log_error_and_abort("Failed to allocate %lu byte arena block",
+                            (unsigned long)size);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = ARENA_HEADER;
+
+    /*  Append to the end of the list, so that blocks are filled in order */
+    arena_block_t** b = &arena->blocks;
+    while (*b) {
+        b = &(*b)->next;
+    }
+    *b = block;
+
+    arena->capacity += size;
+    mem_track(MEM_ARENA, size);
+    return block;
+}
+
+void* arena_alloc(arena_t* arena, mem_subsystem_t s, size_t bytes) {
+    bytes = arena_round(bytes);
+
+    /*  Find a block with enough space, preferring the current block */
+    arena_block_t* block = arena->current;
+    if (!block || block->size - block->used < bytes) {
+        for (block = arena->blocks; block; block = block->next) {
+            if (block->size - block->used >= bytes) {
+                break;
+            }
+        }
+        if (!block) {
+            block = arena_block_new(arena, bytes);
+        }
+        arena->current = block;
+    }
+
+    void* ptr = (char*)block + block->used;
+    block->used += bytes;
+    arena->last = ptr;
+
+    arena->used[s] += bytes;
+    mem_track(MEM_ARENA, -(int64_t)bytes);
+    mem_track(s, bytes);
+    return ptr;
+}
+
+void* arena_calloc(arena_t* arena, mem_subsystem_t s, size_t bytes) {
+    void* ptr = arena_alloc(arena, s, bytes);
+    memset(ptr, 0, bytes);
+    return ptr;
+}
+
+void* arena_grow(arena_t* arena, mem_subsystem_t s, void* ptr,
+                 size_t old_bytes, size_t new_bytes)
+{
+    assert(new_bytes >= old_bytes);
+    const size_t old_size = arena_round(old_bytes);
+    const size_t new_size = arena_round(new_bytes);
+    arena_block_t* block = arena->current;
+
+    if (ptr && ptr == arena->last &&
+        (char*)ptr + old_size == (char*)block + block->used &&
+        block->size - block->used >= new_size - old_size)
+    {
+        block->used += new_size - old_size;
+        arena->used[s] += new_size - old_size;
+        mem_track(MEM_ARENA, -(int64_t)(new_size - old_size));
+        mem_track(s, new_size - old_size);
+    } else {
+        void* n = arena_alloc(arena, s, new_bytes);
+        if (ptr) {
+            memcpy(n, ptr, old_bytes);
+        }
+        ptr = n;
+    }
+    memset((char*)ptr + old_bytes, 0, new_bytes - old_bytes);
+    return ptr;
+}
+
+arena_t* arena_acquire() {
+    platform_mutex_lock(arena_pool_mutex);
+    arena_t* arena = arena_pool;
+    if (arena) {
+        arena_pool = arena->next;
+        arena_pool_capacity -= arena->capacity;
+    }
+    platform_mutex_unlock(arena_pool_mutex);
+
+    if (!arena) {
+        arena = (arena_t*)calloc(1, sizeof(arena_t));
+    }
+    arena->next = NULL;
+    return arena;
+}
+
+void arena_release(arena_t* arena) {
+    /*  Un-charge every subsystem; the memory is now idle in the arena */
+    for (unsigned i=0; i < MEM_SUBSYSTEM_COUNT; ++i) {
+        if (arena->used[i]) {
+            mem_track(i, -(int64_t)arena->used[i]);
+            mem_track(MEM_ARENA, arena->used[i]);
+            arena->used[i] = 0;
+        }
+    }
+    for (arena_block_t* b = arena->blocks; b; b = b->next) {
+        b->used = ARENA_HEADER;
+    }
+    arena->current = arena->blocks;
+    arena->last = NULL;
+
+    platform_mutex_lock(arena_pool_mutex);
+    if (arena_pool_capacity + arena->capacity > ARENA_POOL_RETAIN) {
+        /*  The pool is full, so give this arena's memory back to the OS */
+        while (arena->blocks) {
+            arena_block_t* next = arena->blocks->next;
+            mem_track(MEM_ARENA, -(int64_t)arena->blocks->size);
+            platform_pages_free(arena->blocks, arena->blocks->size);
+            arena->blocks = next;
+        }
+        arena->current = NULL;
+        arena->capacity = 0;
+    }
+    arena->next = arena_pool;
+    arena_pool = arena;
+    arena_pool_capacity += arena->capacity;
+    platform_mutex_unlock(arena_pool_mutex);
+}
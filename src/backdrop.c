@@ -86,6 +86,10 @@ void backdrop_draw(backdrop_t* backdrop, theme_t* theme) {
     glDisable(GL_DEPTH_TEST);
     glUseProgram(backdrop->shader.prog);
     glUniform3fv(backdrop->u_corners, 4, (const float*)&theme->corners);
+    backdrop_draw_quad(backdrop);
+}
+
+void backdrop_draw_quad(backdrop_t* backdrop) {
     glBindVertexArray(backdrop->vao);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
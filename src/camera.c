@@ -40,6 +40,11 @@ struct camera_ {
     /* Matrix calculated in loader and stored in model */
     mat4_t model;
 
+    /*  Uniform buffer holding proj and view (see camera_bind), which is
+     *  created on first use and refilled whenever they change */
+    GLuint ubo;
+    bool ubo_dirty;
+
     /*  Mouse position and state tracking */
     enum { CAMERA_IDLE,
            CAMERA_ROT,
@@ -59,6 +64,7 @@ struct camera_ {
 
 /*  Updates the proj matrix from width and height */
 static void camera_update_proj(camera_t* camera) {
+    camera->ubo_dirty = true;
     camera->proj = mat4_identity();
     const float aspect = (float)camera->width / (float)camera->height;
     if (aspect > 1) {
@@ -72,6 +78,7 @@ static void camera_update_proj(camera_t* camera) {
 
 /*  Recalculates the view matrix */
 static void camera_update_view(camera_t* camera) {
+    camera->ubo_dirty = true;
     camera->view = mat4_identity();
 
     /* Apply translation */
@@ -126,6 +133,9 @@ camera_t* camera_new(float width, float height, camera_proj_t proj) {
 }
 
 void camera_delete(camera_t* camera) {
+    if (camera->ubo) {
+        glDeleteBuffers(1, &camera->ubo);
+    }
     free(camera->anim);
     free(camera);
 }
@@ -142,7 +152,7 @@ void camera_set_model(camera_t* camera, float* center, float scale) {
     camera->model = mat4_mul(t, s);
 }
 
-void camera_set_mouse_pos(camera_t* camera, float x, float y) {
+bool camera_set_mouse_pos(camera_t* camera, float x, float y) {
     x = 2.0f * x / (camera->width) - 1.0f;
     y = 1.0f - 2.0f * y / (camera->height);
     camera->mouse_pos[0] = x;
@@ -153,7 +163,7 @@ void camera_set_mouse_pos(camera_t* camera, float x, float y) {
 
     switch (camera->state) {
         case CAMERA_IDLE:   /* Fallthrough */
-        case CAMERA_ANIM:   break;
+        case CAMERA_ANIM:   return false;
         case CAMERA_PAN: {
             vec3_t v = {{camera->click_pos[0], camera->click_pos[1], 0.0f}};
             v = mat4_apply(camera->drag_mat, v);
@@ -163,7 +173,7 @@ void camera_set_mouse_pos(camera_t* camera, float x, float y) {
                 camera->center.v[i] = camera->start.v[i] + v.v[i] - w.v[i];
             }
             camera_update_view(camera);
-            break;
+            return true;
         }
         case CAMERA_ROT: {
             const float start_pitch = camera->start.v[0];
@@ -188,9 +198,10 @@ void camera_set_mouse_pos(camera_t* camera, float x, float y) {
 
             /*  Rebuild view matrix with new values */
             camera_update_view(camera);
-            break;
+            return true;
          }
     }
+    return false;
 }
 
 static void camera_set_anim(camera_t* camera, anim_t* anim) {
@@ -256,6 +267,10 @@ void camera_end_drag(camera_t* camera) {
     camera->state = CAMERA_IDLE;
 }
 
+bool camera_is_dragging(const camera_t* camera) {
+    return camera->state == CAMERA_PAN || camera->state == CAMERA_ROT;
+}
+
 void camera_zoom(camera_t* camera, float amount) {
     const vec3_t mouse = {{camera->mouse_pos[0], camera->mouse_pos[1], 0.0f}};
 
@@ -277,18 +292,97 @@ void camera_zoom(camera_t* camera, float amount) {
 
 camera_uniforms_t camera_get_uniforms(GLuint prog) {
     camera_uniforms_t u;
-    SHADER_GET_UNIFORM(proj);
-    SHADER_GET_UNIFORM(view);
+    shader_set_block(prog, "camera", CAMERA_BINDING);
     SHADER_GET_UNIFORM(model);
     return u;
 }
 
 void camera_bind(camera_t* camera, camera_uniforms_t u) {
-    glUniformMatrix4fv(u.proj,  1, GL_FALSE, (float*)&camera->proj);
-    glUniformMatrix4fv(u.view,  1, GL_FALSE, (float*)&camera->view);
+    if (!camera->ubo) {
+        glGenBuffers(1, &camera->ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, camera->ubo);
+        glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4_t), NULL,
+                     GL_DYNAMIC_DRAW);
+        camera->ubo_dirty = true;
+    }
+    if (camera->ubo_dirty) {
+        glBindBuffer(GL_UNIFORM_BUFFER, camera->ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mat4_t),
+                        &camera->proj);
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4_t), sizeof(mat4_t),
+                        &camera->view);
+        camera->ubo_dirty = false;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, camera->ubo);
     glUniformMatrix4fv(u.model, 1, GL_FALSE, (float*)&camera->model);
 }
 
+void camera_bind_model(camera_t* camera, camera_uniforms_t u,
+                       const float offset[3], const float scale[3])
+{
+    mat4_t d = mat4_identity();
+    for (unsigned i=0; i < 3; ++i) {
+        d.m[i][i] = scale[i];
+        d.m[3][i] = offset[i];
+    }
+    const mat4_t m = mat4_mul(d, camera->model);
+    glUniformMatrix4fv(u.model, 1, GL_FALSE, (float*)&m);
+}
+
+void camera_get_cull(const camera_t* camera, float planes[6][4],
+                     float eye[4])
+{
+    const mat4_t mv = mat4_mul(camera->model, camera->view);
+    const mat4_t mvp = mat4_mul(mv, camera->proj);
+
+    /*  Clip-space bounds -w <= x, y, z <= w are rows of the matrix */
+    for (unsigned i=0; i < 6; ++i) {
+        const float sign = (i & 1) ? -1.0f : 1.0f;
+        float norm = 0.0f;
+        for (unsigned k=0; k < 4; ++k) {
+            planes[i][k] = mvp.m[k][3] + sign * mvp.m[k][i / 2];
+            norm += (k < 3) ? planes[i][k] * planes[i][k] : 0.0f;
+        }
+        norm = sqrtf(norm);
+        for (unsigned k=0; k < 4; ++k) {
+            planes[i][k] = (norm > 0.0f) ? planes[i][k] / norm : 0.0f;
+        }
+    }
+
+    /*  In view coordinates, clip w is 1 + lens * z, so the eye is where
+     *  that reaches zero.  The model and view matrices are affine, so w
+     *  is unchanged in model coordinates. */
+    const mat4_t inv = mat4_inv(mv);
+    const float e[4] = {0.0f, 0.0f, -1.0f, camera->lens};
+    for (unsigned i=0; i < 4; ++i) {
+        eye[i] = 0.0f;
+        for (unsigned j=0; j < 4; ++j) {
+            eye[i] += inv.m[j][i] * e[j];
+        }
+    }
+}
+
+void camera_get_scale(const camera_t* camera, float w[4], float* pixels) {
+    const mat4_t mvp = mat4_mul(mat4_mul(camera->model, camera->view),
+                                camera->proj);
+    float sx = 0.0f;
+    float sy = 0.0f;
+    for (unsigned k=0; k < 4; ++k) {
+        w[k] = mvp.m[k][3];
+        if (k < 3) {
+            sx += mvp.m[k][0] * mvp.m[k][0];
+            sy += mvp.m[k][1] * mvp.m[k][1];
+        }
+    }
+
+    /*  Clip space spans two units across the window, and the model and
+     *  view matrices scale uniformly, so each row's length is the scale
+     *  along that axis (which match, since proj corrects for aspect) */
+    *pixels = fmaxf(sqrtf(sx) * camera->width,
+                    sqrtf(sy) * camera->height) / 2.0f;
+}
+
 bool camera_check_anim(camera_t* camera) {
     if (!camera->anim) {
         return false;
@@ -0,0 +1,285 @@
+#include "camera.h"
+#include "cull.h"
+#include "lod.h"
+#include "log.h"
+#include "model.h"
+#include "object.h"
+
+/*  Each invocation tests one cluster (with the same tests as cull_visible
+ *  below), then writes its draw command.  Structs match model_cluster_t
+ *  and model_command_t, which have no padding under std430 rules. */
+static const GLchar* CULL_CS_SRC = GLSL(430,
+layout(local_size_x = 64) in;
+
+struct cluster_t {
+    uint first;
+    uint count;
+    int base;
+    float center[3];
+    float radius;
+    float axis[3];
+    float cone_sin;
+};
+
+struct command_t {
+    uint count;
+    uint instance_count;
+    uint first;
+    int base;
+    uint base_instance;
+};
+
+layout(std430, binding=0) readonly buffer cluster_buf {
+    cluster_t clusters[];
+};
+layout(std430, binding=1) writeonly buffer command_buf {
+    command_t commands[];
+};
+
+uniform vec4 planes[6];
+uniform vec4 eye;
+uniform int orientation;
+uniform uint cluster_count;
+
+bool visible(cluster_t c) {
+    vec3 center = vec3(c.center[0], c.center[1], c.center[2]);
+    for (int i=0; i < 6; ++i) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -c.radius) {
+            return false;
+        }
+    }
+    if (orientation != 0 && c.cone_sin <= 1.0f) {
+        vec3 d = eye.w * center - eye.xyz;
+        vec3 axis = vec3(c.axis[0], c.axis[1], c.axis[2]);
+        if (float(orientation) * dot(d, axis) >
+            length(d) * c.cone_sin + c.radius * abs(eye.w))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i < cluster_count) {
+        cluster_t c = clusters[i];
+        bool v = c.count > 0u && visible(c);
+        commands[i] = command_t(c.count, v ? 1u : 0u, c.first, c.base, 0u);
+    }
+}
+);
+
+/*  Clusters handled by each compute shader work group */
+#define CULL_GROUP_SIZE 64
+
+cull_t* cull_new() {
+    OBJECT_ALLOC(cull);
+    if (GLEW_VERSION_4_3 && glDispatchCompute && glMultiDrawElementsIndirect) {
+        cull->shader = shader_new_compute(CULL_CS_SRC);
+        {   // Make a temporary struct to unpack uniforms
+            GLint prog = cull->shader.prog;
+            struct { GLint planes; GLint eye; GLint orientation;
+                     GLint cluster_count; } u;
+            SHADER_GET_UNIFORM(planes);
+            SHADER_GET_UNIFORM(eye);
+            SHADER_GET_UNIFORM(orientation);
+            SHADER_GET_UNIFORM(cluster_count);
+            cull->u_planes = u.planes;
+            cull->u_eye = u.eye;
+            cull->u_orientation = u.orientation;
+            cull->u_cluster_count = u.cluster_count;
+        }
+        log_trace("Built compute shader for culling");
+    }
+    log_gl_error();
+    return cull;
+}
+
+void cull_delete(cull_t* cull) {
+    if (cull->shader.prog) {
+        shader_deinit(cull->shader);
+    }
+    free(cull->counts);
+    free(cull->offsets);
+    free(cull->firsts);
+    free(cull->bases);
+    free(cull);
+}
+
+/*  Index of the near plane (z >= -w) from camera_get_cull */
+#define CULL_NEAR 4
+
+bool cull_outside(const float planes[6][4], const float center[3],
+                  float radius)
+{
+    for (unsigned i=0; i < 6; ++i) {
+        const float* p = planes[i];
+        if (p[0] * center[0] + p[1] * center[1]
+          + p[2] * center[2] + p[3] < -radius)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void cull_begin(cull_t* cull, camera_t* camera, const model_t* model) {
+    camera_get_cull(camera, cull->planes, cull->eye);
+    camera_get_scale(camera, cull->w, &cull->pixels);
+    cull->orientation = model->orientation;
+    cull->enabled = model->options.cull;
+    cull->gpu = model->options.cull_gpu;
+    cull->lod = model->options.lod;
+    cull->cluster_count = 0;
+    cull->visible_count = 0;
+    cull->draw_count = 0;
+
+    /*  Backfaces of a closed mesh are hidden behind its front faces, unless
+     *  the near plane cuts through the mesh (e.g. when the camera is zoomed
+     *  into the model), so backface culling is only safe if every chunk
+     *  is entirely in front of the near plane */
+    const float* p = cull->planes[CULL_NEAR];
+    for (unsigned i=0; i < model->chunk_count && cull->orientation; ++i) {
+        const model_chunk_t* c = &model->chunks[i];
+        if (c->tri_count && !(p[0] * c->center[0] + p[1] * c->center[1]
+                            + p[2] * c->center[2] + p[3] >= c->radius))
+        {
+            cull->orientation = 0;
+        }
+    }
+}
+
+bool cull_chunk_visible(const cull_t* cull, const model_chunk_t* chunk) {
+    return chunk->vbo && (!cull->enabled || !cull_outside(cull->planes,
+                                                          chunk->center,
+                                                          chunk->radius));
+}
+
+unsigned cull_chunk_lod(const cull_t* cull, const model_chunk_t* chunk) {
+    if (!cull->lod || !chunk->lod_count) {
+        return 0;
+    }
+
+    /*  Errors look largest at the nearest point of the bounding sphere,
+     *  which has the smallest w.  If that's at or behind the eye, the
+     *  full-resolution chunk is drawn. */
+    const float* w = cull->w;
+    const float w_min = w[0] * chunk->center[0] + w[1] * chunk->center[1]
+                      + w[2] * chunk->center[2] + w[3]
+                      - chunk->radius * sqrtf(w[0]*w[0] + w[1]*w[1]
+                                            + w[2]*w[2]);
+    if (!(w_min > 0.0f)) {
+        return 0;
+    }
+    const float pixels = cull->pixels / w_min;
+    unsigned lod = 0;
+    for (unsigned i=0; i < chunk->lod_count; ++i) {
+        if (chunk->lods[i].error * pixels <= LOD_MAX_PIXELS) {
+            lod = i + 1;
+        }
+    }
+    return lod;
+}
+
+/*  Checks whether any part of the cluster could be visible */
+static bool cull_visible(const cull_t* cull, const model_cluster_t* c) {
+    if (cull_outside(cull->planes, c->center, c->radius)) {
+        return false;
+    }
+
+    /*  Every triangle faces away from the eye if the direction from the
+     *  eye to any point in the bounding sphere is within 90 degrees of
+     *  every normal in the cone.  With an orthographic camera, the eye
+     *  is a direction (with w = 0), so the sphere's radius drops out. */
+    if (cull->orientation && c->cone_sin <= 1.0f) {
+        const float* e = cull->eye;
+        float d[3];
+        float dot = 0.0f;
+        float len = 0.0f;
+        for (unsigned j=0; j < 3; ++j) {
+            d[j] = e[3] * c->center[j] - e[j];
+            dot += d[j] * c->axis[j];
+            len += d[j] * d[j];
+        }
+        if (cull->orientation * dot >
+            sqrtf(len) * c->cone_sin + c->radius * fabsf(e[3]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned cull_chunk(cull_t* cull, const model_chunk_t* chunk) {
+    cull->cluster_count += chunk->cluster_count;
+    if (!cull_chunk_visible(cull, chunk)) {
+        return 0;
+    }
+    if (cull->size < chunk->cluster_count) {
+        cull->size = chunk->cluster_count;
+        cull->counts = (GLsizei*)realloc(
+                cull->counts, sizeof(GLsizei) * cull->size);
+        cull->offsets = (void**)realloc(
+                cull->offsets, sizeof(void*) * cull->size);
+        cull->firsts = (GLint*)realloc(
+                cull->firsts, sizeof(GLint) * cull->size);
+        cull->bases = (GLint*)realloc(
+                cull->bases, sizeof(GLint) * cull->size);
+    }
+
+    const size_t index_size = (chunk->index_type == GL_UNSIGNED_SHORT)
+        ? sizeof(uint16_t) : sizeof(uint32_t);
+    unsigned n = 0;
+    for (unsigned i=0; i < chunk->cluster_count; ++i) {
+        const model_cluster_t* c = &chunk->clusters[i];
+        if (!c->count || (cull->enabled && !cull_visible(cull, c))) {
+            continue;
+        }
+        cull->visible_count++;
+
+        /*  Extend the previous draw if it ends where this cluster starts */
+        if (n && cull->bases[n - 1] == c->base &&
+            (uint32_t)(cull->firsts[n - 1] + cull->counts[n - 1]) == c->first)
+        {
+            cull->counts[n - 1] += c->count;
+            continue;
+        }
+        cull->counts[n] = c->count;
+        cull->firsts[n] = c->first;
+        cull->offsets[n] = (void*)(c->first * index_size);
+        cull->bases[n] = c->base;
+        n++;
+    }
+    cull->draw_count += n;
+    return n;
+}
+
+bool cull_gpu(cull_t* cull, model_t* model) {
+    if (!cull->enabled || !cull->gpu || !cull->shader.prog) {
+        return false;
+    }
+
+    glUseProgram(cull->shader.prog);
+    glUniform4fv(cull->u_planes, 6, &cull->planes[0][0]);
+    glUniform4fv(cull->u_eye, 1, cull->eye);
+    glUniform1i(cull->u_orientation, cull->orientation);
+    for (unsigned i=0; i < model->chunk_count; ++i) {
+        const model_chunk_t* chunk = &model->chunks[i];
+        cull->cluster_count += chunk->cluster_count;
+        if (!cull_chunk_visible(cull, chunk) || cull_chunk_lod(cull, chunk)) {
+            continue;
+        }
+        if (!chunk->cluster_buf) {
+            model_upload_clusters(model, i);
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, chunk->cluster_buf);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, chunk->command_buf);
+        glUniform1ui(cull->u_cluster_count, chunk->cluster_count);
+        glDispatchCompute((chunk->cluster_count + CULL_GROUP_SIZE - 1)
+                          / CULL_GROUP_SIZE, 1, 1);
+    }
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    log_gl_error();
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "camera.h"
+#include "cull.h"
 #include "draw.h"
 #include "log.h"
 #include "theme.h"
@@ -15,8 +16,8 @@ struct draw_ {
     /*  Uniform locations for matrices */
     camera_uniforms_t u_camera;
 
-    /*  Uniform locations for lighting */
-    theme_uniforms_t u_theme;
+    /*  Per-frame list of visible clusters */
+    cull_t* cull;
 };
 
 draw_t* draw_new(const char* vs, const char* gs, const char* fs) {
@@ -24,7 +25,8 @@ draw_t* draw_new(const char* vs, const char* gs, const char* fs) {
     draw->shader = shader_new(vs, gs, fs);
 
     draw->u_camera = camera_get_uniforms(draw->shader.prog);
-    draw->u_theme = theme_get_uniforms(draw->shader.prog);
+    theme_get_uniforms(draw->shader.prog);
+    draw->cull = cull_new();
 
     log_gl_error();
     return draw;
@@ -32,18 +34,64 @@ draw_t* draw_new(const char* vs, const char* gs, const char* fs) {
 
 void draw_delete(draw_t* draw) {
     shader_deinit(draw->shader);
+    cull_delete(draw->cull);
     free(draw);
 }
 
 void draw(draw_t* draw, model_t* model, camera_t* camera, theme_t* theme)
 {
+    /*  Cull clusters on the GPU if possible, which uses its own program,
+     *  so this happens before binding the draw program */
+    cull_t* const cull = draw->cull;
+    cull_begin(cull, camera, model);
+    const bool gpu = cull_gpu(cull, model);
+
+    /*  Push triangles back slightly, so that feature edges drawn over
+     *  them (in lines.c) aren't hidden by their own triangles.  This is
+     *  only enabled for the shaded pass, so it doesn't leak into the
+     *  passes drawn after it. */
     glEnable(GL_DEPTH_TEST);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0f, 1.0f);
     glUseProgram(draw->shader.prog);
-    glBindVertexArray(model->vao);
-
     camera_bind(camera, draw->u_camera);
-    theme_bind(theme, draw->u_theme);
+    theme_bind(theme);
+
+    for (unsigned i=0; i < model->chunk_count; ++i) {
+        const model_chunk_t* chunk = &model->chunks[i];
 
-    glDrawElements(GL_TRIANGLES, model->tri_count * 3, GL_UNSIGNED_INT, NULL);
+        /*  Chunks drawn at a coarser level of detail are culled as a
+         *  whole, since their levels don't have clusters */
+        const unsigned lod = cull_chunk_lod(cull, chunk);
+        const unsigned n = (gpu || lod) ? cull_chunk_visible(cull, chunk)
+                                        : cull_chunk(cull, chunk);
+        if (!n) {
+            continue;
+        }
+        camera_bind_model(camera, draw->u_camera, chunk->offset, chunk->scale);
+        if (lod) {
+            const model_lod_t* level = &chunk->lods[lod - 1];
+            const size_t index_size = (chunk->lod_type == GL_UNSIGNED_SHORT)
+                ? sizeof(uint16_t) : sizeof(uint32_t);
+            glBindVertexArray(chunk->lod_vao);
+            glDrawElements(GL_TRIANGLES, level->count, chunk->lod_type,
+                           (void*)(level->first * index_size));
+            continue;
+        }
+        glBindVertexArray(chunk->vao);
+        if (gpu) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, chunk->command_buf);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, chunk->index_type,
+                                        NULL, chunk->cluster_count, 0);
+        } else {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, cull->counts,
+                                          chunk->index_type, cull->offsets,
+                                          n, cull->bases);
+        }
+    }
+    if (gpu) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
     log_gl_error();
 }
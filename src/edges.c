@@ -0,0 +1,248 @@
+#include "arena.h"
+#include "edges.h"
+#include "mem.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash/xxhash.h"
+
+/*  Hash table slot for an edge within a chunk, keyed by its vertex indices
+ *  (lowest first).  Since the two indices differ, a key with every bit set
+ *  marks an empty slot. */
+typedef struct edges_slot_ {
+    uint64_t key;
+    uint32_t tri[2];
+    uint32_t count;
+    uint32_t forward;   /* Triangles which wind from the lower index */
+} edges_slot_t;
+
+#define EDGES_EMPTY UINT64_MAX
+
+/*  Returns the number of bits for an open addressing table which is at
+ *  most half full with the given number of entries */
+static unsigned edges_table_bits(size_t count) {
+    unsigned bits = 4;
+    while (((size_t)1 << bits) < count * 2) {
+        bits++;
+    }
+    return bits;
+}
+
+static void edges_push(edges_t* edges, uint32_t a, uint32_t b) {
+    if (!edges->lines) {
+        edges->lines_size = 256;
+        edges->lines = (uint32_t*)mem_malloc(
+                MEM_EDGES, sizeof(uint32_t) * 2 * edges->lines_size);
+    } else if (edges->line_count == edges->lines_size) {
+        edges->lines_size *= 2;
+        edges->lines = (uint32_t*)mem_realloc(
+                edges->lines, sizeof(uint32_t) * 2 * edges->lines_size);
+    }
+    edges->lines[edges->line_count * 2] = a;
+    edges->lines[edges->line_count * 2 + 1] = b;
+    edges->line_count++;
+}
+
+static bool edges_is_crease(const float* a, const float* b) {
+    const float d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+    const bool degenerate = (a[0] == 0.0f && a[1] == 0.0f && a[2] == 0.0f)
+                         || (b[0] == 0.0f && b[1] == 0.0f && b[2] == 0.0f);
+    return !degenerate && d < cosf(EDGES_CREASE_DEGREES * (float)M_PI / 180);
+}
+
+static void edges_normal(const float* a, const float* b, const float* c,
+                         float* out)
+{
+    float u[3], v[3];
+    for (unsigned i=0; i < 3; ++i) {
+        u[i] = b[i] - a[i];
+        v[i] = c[i] - a[i];
+    }
+    out[0] = u[1]*v[2] - u[2]*v[1];
+    out[1] = u[2]*v[0] - u[0]*v[2];
+    out[2] = u[0]*v[1] - u[1]*v[0];
+    const float len = sqrtf(out[0]*out[0] + out[1]*out[1] + out[2]*out[2]);
+    for (unsigned i=0; i < 3; ++i) {
+        out[i] = (len > 0.0f && isfinite(len)) ? out[i] / len : 0.0f;
+    }
+}
+
+/*  Returns six times the signed volume of the tetrahedron between a
+ *  triangle and the origin */
+static double edges_volume(const float* a, const float* b, const float* c,
+                           const float* origin)
+{
+    double u[3], v[3], w[3];
+    for (unsigned i=0; i < 3; ++i) {
+        u[i] = (double)a[i] - origin[i];
+        v[i] = (double)b[i] - origin[i];
+        w[i] = (double)c[i] - origin[i];
+    }
+    return u[0] * (v[1]*w[2] - v[2]*w[1])
+         + u[1] * (v[2]*w[0] - v[0]*w[2])
+         + u[2] * (v[0]*w[1] - v[1]*w[0]);
+}
+
+void edges_find(edges_t* edges, arena_t* arena,
+                const uint32_t* tris, size_t tri_count,
+                const float (*verts)[3], const float origin[3])
+{
+    memset(edges, 0, sizeof(*edges));
+
+    float (*normals)[3] = (float(*)[3])arena_alloc(
+            arena, MEM_EDGES, sizeof(float) * 3 * tri_count);
+    double volume = 0.0;
+    for (size_t i=0; i < tri_count; ++i) {
+        const uint32_t* t = &tris[i * 3];
+        edges_normal(verts[t[0]], verts[t[1]], verts[t[2]], normals[i]);
+        volume += edges_volume(verts[t[0]], verts[t[1]], verts[t[2]],
+                               origin);
+    }
+    edges->volume = volume / 6.0;
+
+    /*  Count the triangles on each edge, recording the first two */
+    const unsigned bits = edges_table_bits(tri_count * 3);
+    const size_t mask = ((size_t)1 << bits) - 1;
+    edges_slot_t* table = (edges_slot_t*)arena_alloc(
+            arena, MEM_EDGES, sizeof(edges_slot_t) << bits);
+    for (size_t i=0; i <= mask; ++i) {
+        table[i].key = EDGES_EMPTY;
+    }
+    for (size_t i=0; i < tri_count; ++i) {
+        const uint32_t* t = &tris[i * 3];
+        for (unsigned j=0; j < 3; ++j) {
+            uint32_t a = t[j];
+            uint32_t b = t[(j + 1) % 3];
+            const bool forward = a < b;
+            if (a == b) {
+                continue;
+            } else if (a > b) {
+                const uint32_t tmp = a;
+                a = b;
+                b = tmp;
+            }
+            const uint64_t key = ((uint64_t)a << 32) | b;
+            size_t slot = (key * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+            while (table[slot].key != EDGES_EMPTY && table[slot].key != key) {
+                slot = (slot + 1) & mask;
+            }
+            edges_slot_t* s = &table[slot];
+            if (s->key == EDGES_EMPTY) {
+                s->key = key;
+                s->count = 0;
+                s->forward = 0;
+            }
+            if (s->count < 2) {
+                s->tri[s->count] = i;
+            }
+            s->count++;
+            s->forward += forward;
+        }
+    }
+
+    /*  Keep edges with one triangle for edges_merge, since they may be
+     *  shared with another chunk */
+    size_t open_count = 0;
+    for (size_t i=0; i <= mask; ++i) {
+        open_count += (table[i].key != EDGES_EMPTY && table[i].count == 1);
+    }
+    edges->open = (edges_open_t*)mem_malloc(
+            MEM_EDGES, sizeof(edges_open_t) * (open_count ? open_count : 1));
+
+    for (size_t i=0; i <= mask; ++i) {
+        const edges_slot_t* s = &table[i];
+        if (s->key == EDGES_EMPTY) {
+            continue;
+        }
+        const uint32_t a = s->key >> 32;
+        const uint32_t b = s->key & UINT32_MAX;
+        if (s->count == 1) {
+            edges_open_t* e = &edges->open[edges->open_count++];
+            const bool swap = memcmp(verts[a], verts[b], sizeof(*verts)) > 0;
+            memcpy(e->pos[0], verts[swap ? b : a], sizeof(*verts));
+            memcpy(e->pos[1], verts[swap ? a : b], sizeof(*verts));
+            memcpy(e->normal, normals[s->tri[0]], sizeof(e->normal));
+            e->index[0] = a;
+            e->index[1] = b;
+            e->forward = (s->forward == 1) != swap;
+            continue;
+        }
+
+        /*  A closed, consistently wound mesh has two triangles on each
+         *  edge, which traverse it in opposite directions */
+        edges->flaws += (s->count > 2 || s->forward != 1);
+        if (s->count > 2 ||
+            edges_is_crease(normals[s->tri[0]], normals[s->tri[1]]))
+        {
+            edges_push(edges, a, b);
+        }
+    }
+}
+
+/******************************************************************************/
+
+/*  Hash table slot for an open edge, referring to the first two chunks
+ *  that contain it */
+typedef struct edges_match_ {
+    const edges_open_t* open[2];
+    edges_t* chunk;
+    uint32_t count;
+} edges_match_t;
+
+void edges_merge(edges_t** edges, unsigned count, arena_t* arena) {
+    size_t total = 0;
+    for (unsigned i=0; i < count; ++i) {
+        total += edges[i]->open_count;
+    }
+
+    const unsigned bits = edges_table_bits(total);
+    const size_t mask = ((size_t)1 << bits) - 1;
+    edges_match_t* table = (edges_match_t*)arena_calloc(
+            arena, MEM_EDGES, sizeof(edges_match_t) << bits);
+    for (unsigned i=0; i < count; ++i) {
+        for (uint32_t j=0; j < edges[i]->open_count; ++j) {
+            const edges_open_t* e = &edges[i]->open[j];
+            size_t slot = XXH32(e->pos, sizeof(e->pos), 0) & mask;
+            while (table[slot].count &&
+                   memcmp(table[slot].open[0]->pos, e->pos, sizeof(e->pos)))
+            {
+                slot = (slot + 1) & mask;
+            }
+            edges_match_t* m = &table[slot];
+            if (!m->count) {
+                m->chunk = edges[i];
+            }
+            if (m->count < 2) {
+                m->open[m->count] = e;
+            }
+            m->count++;
+        }
+    }
+
+    /*  Each line is drawn (and each flaw counted) from the first chunk
+     *  that contains it */
+    for (size_t i=0; i <= mask; ++i) {
+        const edges_match_t* m = &table[i];
+        if (m->count) {
+            m->chunk->flaws += (m->count != 2 ||
+                                m->open[0]->forward == m->open[1]->forward);
+        }
+        if (m->count == 1 || m->count > 2 ||
+            (m->count == 2 &&
+             edges_is_crease(m->open[0]->normal, m->open[1]->normal)))
+        {
+            edges_push(m->chunk, m->open[0]->index[0], m->open[0]->index[1]);
+        }
+    }
+
+    for (unsigned i=0; i < count; ++i) {
+        mem_free(edges[i]->open);
+        edges[i]->open = NULL;
+        edges[i]->open_count = 0;
+    }
+}
+
+void edges_free(edges_t* edges) {
+    mem_free(edges->lines);
+    mem_free(edges->open);
+    memset(edges, 0, sizeof(*edges));
+}
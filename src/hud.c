@@ -0,0 +1,213 @@
+#include "hud.h"
+#include "log.h"
+#include "object.h"
+#include "shader.h"
+#include "timing.h"
+
+static const GLchar* HUD_VS_SRC = GLSL(330,
+layout(location=0) in vec2 pos;
+layout(location=1) in vec4 color;
+
+out vec4 frag_color;
+
+void main() {
+    frag_color = color;
+    gl_Position = vec4(pos, 0.0f, 1.0f);
+}
+);
+
+static const GLchar* HUD_FS_SRC = GLSL(330,
+in vec4 frag_color;
+out vec4 out_color;
+
+void main() {
+    out_color = frag_color;
+}
+);
+
+/*  Graph layout, in pixels */
+#define HUD_MARGIN      10.0f
+#define HUD_BAR_WIDTH   2.0f
+#define HUD_HEIGHT      100.0f
+
+/*  Frame time at the top of the graph, in milliseconds.  A reference
+ *  line is drawn at half of this value (i.e. 60 FPS). */
+#define HUD_SCALE_MS    (2000.0f / 60.0f)
+
+/*  Progress bar size, as a fraction of viewport width and in pixels */
+#define HUD_PROGRESS_WIDTH  0.4f
+#define HUD_PROGRESS_HEIGHT 6.0f
+
+/*  Background, reference line, and stacked bars plus CPU and swap ticks
+ *  per frame */
+#define HUD_MAX_QUADS   (2 + TIMING_HISTORY * (TIMING_STAGE_COUNT + 2))
+#define HUD_FLOATS_PER_VERT 6
+
+static const float HUD_STAGE_COLORS[TIMING_STAGE_COUNT][4] = {
+    {0.35f, 0.55f, 0.95f, 0.9f},    /* backdrop */
+    {0.95f, 0.60f, 0.20f, 0.9f},    /* model */
+    {0.60f, 0.60f, 0.60f, 0.9f},    /* hud */
+};
+static const float HUD_SWAP_COLOR[4] = {0.30f, 0.85f, 0.40f, 0.9f};
+
+struct hud_ {
+    GLuint vao;
+    GLuint vbo;
+
+    /*  Shader program */
+    shader_t shader;
+
+    /*  Vertex data, rebuilt on every draw */
+    float* verts;
+    unsigned vert_count;
+
+    /*  Pixel to NDC conversion for the current viewport */
+    float sx, sy;
+};
+
+hud_t* hud_new() {
+    OBJECT_ALLOC(hud);
+    hud->shader = shader_new(HUD_VS_SRC, NULL, HUD_FS_SRC);
+    hud->verts = (float*)calloc(HUD_MAX_QUADS * 6 * HUD_FLOATS_PER_VERT,
+                                sizeof(float));
+
+    glGenBuffers(1, &hud->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, hud->vbo);
+    glGenVertexArrays(1, &hud->vao);
+    glBindVertexArray(hud->vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
+                          HUD_FLOATS_PER_VERT * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE,
+                          HUD_FLOATS_PER_VERT * sizeof(float),
+                          (void*)(2 * sizeof(float)));
+    log_trace("Initialized HUD");
+
+    return hud;
+}
+
+void hud_delete(hud_t* hud) {
+    glDeleteBuffers(1, &hud->vbo);
+    glDeleteVertexArrays(1, &hud->vao);
+    shader_deinit(hud->shader);
+    free(hud->verts);
+    free(hud);
+}
+
+/*  Appends a rectangle, with corners specified in pixels
+ *  from the bottom-left corner of the viewport */
+static void hud_rect(hud_t* hud, float x0, float y0, float x1, float y1,
+                     const float color[4])
+{
+    const float xs[6] = {x0, x1, x0, x0, x1, x1};
+    const float ys[6] = {y0, y0, y1, y1, y0, y1};
+    for (unsigned i=0; i < 6; ++i) {
+        float* v = &hud->verts[hud->vert_count++ * HUD_FLOATS_PER_VERT];
+        v[0] = xs[i] * hud->sx - 1.0f;
+        v[1] = ys[i] * hud->sy - 1.0f;
+        memcpy(&v[2], color, 4 * sizeof(float));
+    }
+}
+
+/*  Prepares to build rectangles in pixel coordinates, returning the
+ *  viewport's width and height in pixels */
+static void hud_begin(hud_t* hud, float* width, float* height) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    hud->sx = 2.0f / viewport[2];
+    hud->sy = 2.0f / viewport[3];
+    hud->vert_count = 0;
+    if (width) {
+        *width = viewport[2];
+    }
+    if (height) {
+        *height = viewport[3];
+    }
+}
+
+/*  Draws every rectangle built since hud_begin */
+static void hud_end(hud_t* hud) {
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(hud->shader.prog);
+    glBindVertexArray(hud->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, hud->vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 hud->vert_count * HUD_FLOATS_PER_VERT * sizeof(float),
+                 hud->verts, GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, hud->vert_count);
+
+    glDisable(GL_BLEND);
+    log_gl_error();
+}
+
+void hud_draw(hud_t* hud, const timing_t* timing) {
+    hud_begin(hud, NULL, NULL);
+
+    const float width = TIMING_HISTORY * HUD_BAR_WIDTH;
+    const float x0 = HUD_MARGIN;
+    const float y0 = HUD_MARGIN;
+    const float px_per_ms = HUD_HEIGHT / HUD_SCALE_MS;
+
+    const float background[4] = {0.0f, 0.0f, 0.0f, 0.5f};
+    hud_rect(hud, x0, y0, x0 + width, y0 + HUD_HEIGHT, background);
+
+    /*  Newest frames are on the right */
+    for (unsigned age=0; age < TIMING_HISTORY; ++age) {
+        const float x = x0 + width - (age + 1) * HUD_BAR_WIDTH;
+        if (timing_get_gpu(timing, age, 0) >= 0.0f) {
+            float y = y0;
+            for (unsigned i=0; i < TIMING_STAGE_COUNT; ++i) {
+                const float h = fminf(timing_get_gpu(timing, age, i) *
+                                      px_per_ms, y0 + HUD_HEIGHT - y);
+                if (h > 0.0f) {
+                    hud_rect(hud, x, y, x + HUD_BAR_WIDTH, y + h,
+                             HUD_STAGE_COLORS[i]);
+                    y += h;
+                }
+            }
+        }
+
+        const float cpu = timing_get_cpu(timing, age);
+        if (cpu >= 0.0f) {
+            const float y = y0 + fminf(cpu * px_per_ms, HUD_HEIGHT - 1.0f);
+            const float white[4] = {1.0f, 1.0f, 1.0f, 0.9f};
+            hud_rect(hud, x, y, x + HUD_BAR_WIDTH, y + 1.0f, white);
+        }
+
+        /*  The swap is timed on the CPU, so it gets a tick rather than
+         *  a place in the stacked GPU bar */
+        const float swap = timing_get_swap(timing, age);
+        if (swap >= 0.0f) {
+            const float y = y0 + fminf(swap * px_per_ms, HUD_HEIGHT - 1.0f);
+            hud_rect(hud, x, y, x + HUD_BAR_WIDTH, y + 1.0f, HUD_SWAP_COLOR);
+        }
+    }
+
+    const float line[4] = {1.0f, 0.2f, 0.2f, 0.8f};
+    const float y60 = y0 + HUD_HEIGHT / 2.0f;
+    hud_rect(hud, x0, y60, x0 + width, y60 + 1.0f, line);
+
+    hud_end(hud);
+}
+
+void hud_draw_progress(hud_t* hud, float progress) {
+    float width, height;
+    hud_begin(hud, &width, &height);
+
+    const float w = width * HUD_PROGRESS_WIDTH;
+    const float x0 = (width - w) / 2.0f;
+    const float y0 = (height - HUD_PROGRESS_HEIGHT) / 2.0f;
+    const float y1 = y0 + HUD_PROGRESS_HEIGHT;
+    progress = fmaxf(0.0f, fminf(1.0f, progress));
+
+    const float background[4] = {0.0f, 0.0f, 0.0f, 0.25f};
+    const float foreground[4] = {1.0f, 1.0f, 1.0f, 0.6f};
+    hud_rect(hud, x0, y0, x0 + w, y1, background);
+    hud_rect(hud, x0, y0, x0 + w * progress, y1, foreground);
+
+    hud_end(hud);
+}
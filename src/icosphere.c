@@ -1,6 +1,8 @@
+#include "arena.h"
 #include "icosphere.h"
 #include "log.h"
 #include "mat.h"
+#include "mem.h"
 #include "vset.h"
 
 struct icosphere_ {
@@ -44,13 +46,13 @@ uint32_t edge_lookup(icosphere_t* ico, uint32_t (*edge)[6][2],
 }
 
 icosphere_t* subdivide(const icosphere_t* in) {
-    icosphere_t* ico = malloc(sizeof(icosphere_t));
+    icosphere_t* ico = mem_malloc(MEM_ICOSPHERE, sizeof(icosphere_t));
 
     const uint32_t num_ts_next = in->num_ts * 4;
     const uint32_t num_vs_next = in->num_vs + in->num_ts * 3 / 2;
 
-    ico->ts = malloc(num_ts_next * sizeof(*ico->ts));
-    ico->vs = malloc(num_vs_next * sizeof(*ico->vs));
+    ico->ts = mem_malloc(MEM_ICOSPHERE, num_ts_next * sizeof(*ico->ts));
+    ico->vs = mem_malloc(MEM_ICOSPHERE, num_vs_next * sizeof(*ico->vs));
     ico->num_ts = 0;
 
     // Copy over the initial set of vertices, which will still exist
@@ -62,7 +64,8 @@ icosphere_t* subdivide(const icosphere_t* in) {
      *      a) The neighbor's index
      *      b) The index of the new vertex on that neighbor edge
      *  It is all zeros to start, because we have no neighbor information. */
-    uint32_t (*edge)[6][2] = calloc(in->num_vs, sizeof(*edge));
+    uint32_t (*edge)[6][2] = mem_calloc(MEM_ICOSPHERE, in->num_vs,
+                                        sizeof(*edge));
 
     for (unsigned t=0; t < in->num_ts; ++t) {
         //  This is the triangle that we're currently operating on
@@ -96,6 +99,8 @@ icosphere_t* subdivide(const icosphere_t* in) {
             }
         }
     }
+    mem_free(edge);
+
     if (ico->num_ts != num_ts_next) {
         log_error_and_abort("Wrong number of triangles (expected %u, got %u)",
                             num_ts_next, ico->num_ts);
@@ -108,7 +113,7 @@ icosphere_t* subdivide(const icosphere_t* in) {
 }
 
 icosphere_t* icosphere_new(unsigned depth) {
-    icosphere_t* ico = malloc(sizeof(icosphere_t));
+    icosphere_t* ico = mem_malloc(MEM_ICOSPHERE, sizeof(icosphere_t));
 
     {   // Load initial vertices into the vset
         const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
@@ -131,7 +136,7 @@ icosphere_t* icosphere_new(unsigned depth) {
             {-t,  0.0f,  1.0f},
         };
         ico->num_vs = sizeof(ts) / sizeof(*ts);
-        ico->vs = malloc(sizeof(ts));
+        ico->vs = mem_malloc(MEM_ICOSPHERE, sizeof(ts));
         memcpy(ico->vs, ts, sizeof(ts));
         for (unsigned i=1; i < ico->num_vs; ++i) {
             ico->vs[i] = vec3_normalized(ico->vs[i]);
@@ -166,7 +171,7 @@ icosphere_t* icosphere_new(unsigned depth) {
             {10, 9, 2}};
 
         ico->num_ts = sizeof(ts) / sizeof(*ts);
-        ico->ts = malloc(sizeof(ts));
+        ico->ts = mem_malloc(MEM_ICOSPHERE, sizeof(ts));
         memcpy(ico->ts, ts, sizeof(ts));
     }
 
@@ -180,15 +185,15 @@ icosphere_t* icosphere_new(unsigned depth) {
 }
 
 void icosphere_delete(icosphere_t* ico) {
-    free(ico->vs);
-    free(ico->ts);
-    free(ico);
+    mem_free(ico->vs);
+    mem_free(ico->ts);
+    mem_free(ico);
 }
 
-const char* icosphere_stl(unsigned depth, size_t* size) {
+const char* icosphere_stl(arena_t* arena, unsigned depth, size_t* size) {
     icosphere_t* ico = icosphere_new(depth);
     *size = ico->num_ts * 50 + 84;
-    char* out = calloc(1, *size);
+    char* out = arena_calloc(arena, MEM_ICOSPHERE, *size);
 
     // Record the triangle count
     char* ptr = out + 80;
@@ -2,74 +2,136 @@
 #include "backdrop.h"
 #include "camera.h"
 #include "draw.h"
+#include "hud.h"
 #include "instance.h"
+#include "lines.h"
 #include "loader.h"
 #include "log.h"
 #include "mat.h"
 #include "model.h"
 #include "object.h"
 #include "platform.h"
+#include "quality.h"
+#include "resident.h"
+#include "scheduler.h"
 #include "shaded.h"
 #include "theme.h"
+#include "timing.h"
 #include "window.h"
 #include "wireframe.h"
 
 instance_t* instance_new(app_t* parent, const char* filepath, int proj) {
-    /*  Kick the loader off in a separate thread */
-    loader_t* loader = loader_new(filepath);
+    OBJECT_ALLOC(instance);
+    instance->parent = parent;
+
+    /*  Kick the loader off in a separate thread.  It is polled from the
+     *  main loop (in instance_check_loader), so that the UI keeps running
+     *  while the model loads. */
+    instance->loader = loader_new(filepath, &parent->options,
+                                  parent->pool);
+    instance->serial = parent->open_count++;
 
     const float width = 500;
     const float height = 500;
     const char* filename = platform_filename(filepath);
     GLFWwindow* window = window_new(filename, width, height);
 
-    /*  Highest priority once OpenGL is running: allocate the VBO
-     *  and pass it to the loader thread.  */
-    loader_allocate_vbo(loader);
-
     glfwShowWindow(window);
     log_trace("Showed window");
 
-    OBJECT_ALLOC(instance);
-    instance->parent = parent;
-
     /*  Next, build the OpenGL-dependent objects */
     instance->backdrop = backdrop_new();
     instance->camera = camera_new(width, height, proj);
-    instance->model = model_new();
+    instance->model = model_new(&parent->options);
     instance->shaded = shaded_new();
     instance->wireframe = wireframe_new();
+    instance->lines = lines_new();
     instance->draw_mode = DRAW_SHADED;
-
-    /*  At the very last moment, check on the loader */
-    loader_finish(loader, instance->model, instance->camera);
+    instance->dirty = true;
+    instance->timing = timing_new(filename);
+    instance->hud = hud_new();
+    instance->quality = quality_new(quality_aa_get());
 
     /*  This needs to happen after setting up the instance, because
      *  on Windows, the window size callback is invoked when we add
      *  the menu, which requires the camera to be populated. */
     window_bind(window, instance);
 
-    /*  Sets the error string, or NULL if there was no error. */
-    instance->error = loader_error_string(loader);
+    /*  The loader may have already finished (e.g. for small files) */
+    instance_check_loader(instance);
+    return instance;
+}
 
-    /*  Clean up and return */
+bool instance_check_loader(instance_t* instance) {
+    loader_t* const loader = instance->loader;
+    if (!loader) {
+        return false;
+    }
+
+    /*  GPU buffers belong to this window's context.  Chunks of the model
+     *  are moved into it as they arrive, so it fills in while loading. */
+    glfwMakeContextCurrent(instance->window);
+    if (loader_upload(loader, instance->model, instance->camera)) {
+        /*  New chunks are drawn (and the camera refit around them) */
+        instance->dirty = true;
+    }
+
+    const loader_state_t state = loader_get_state(loader);
+    if (state != LOADER_DONE && state < LOADER_ERROR) {
+        return false;
+    }
+
+    /*  Set the error string (or NULL if there was no error), and
+     *  redraw once more to remove the progress bar */
+    instance->error = loader_error_string(loader);
+    instance->dirty = true;
+    loader_finish(loader, instance->model);
+    if (instance->error) {
+        log_error("Loading failed");
+    }
     loader_delete(loader);
-    return instance;
+    instance->loader = NULL;
+    glfwPostEmptyEvent();
+    return true;
 }
 
 void instance_delete(instance_t* instance) {
+    /*  Buffers and programs are shared between windows, but vertex arrays
+     *  belong to this window's context, so it must be current */
+    glfwMakeContextCurrent(instance->window);
+
+    /*  If the window is closed mid-load, abandon the load so that its
+     *  queued work doesn't hold up other windows, then free its buffers */
+    if (instance->loader) {
+        loader_cancel(instance->loader);
+        loader_delete(instance->loader);
+    }
+
     OBJECT_DELETE_MEMBER(instance, backdrop);
     OBJECT_DELETE_MEMBER(instance, camera);
     OBJECT_DELETE_MEMBER(instance, model);
     draw_delete(instance->shaded);
-    draw_delete(instance->wireframe);
+    wireframe_delete(instance->wireframe);
+    lines_delete(instance->lines);
+    timing_save(instance->timing);
+    OBJECT_DELETE_MEMBER(instance, timing);
+    OBJECT_DELETE_MEMBER(instance, hud);
+    OBJECT_DELETE_MEMBER(instance, quality);
     OBJECT_DELETE_MEMBER(instance, window);
     free(instance);
 }
 
+/*  Marks the instance as dirty and wakes up the main loop, for changes
+ *  which don't come from this window's input callbacks (e.g. from the
+ *  app's menus), since the main loop may be asleep */
+static void instance_changed(instance_t* instance) {
+    instance->dirty = true;
+    glfwPostEmptyEvent();
+}
+
 static void instance_set_view(instance_t* instance, int draw_mode) {
     instance->draw_mode = draw_mode;
-    glfwPostEmptyEvent();
+    instance_changed(instance);
 }
 
 void instance_view_shaded(instance_t* instance) {
@@ -80,12 +142,18 @@ void instance_view_wireframe(instance_t* instance) {
     instance_set_view(instance, DRAW_WIREFRAME);
 }
 
+void instance_view_edges(instance_t* instance) {
+    instance_set_view(instance, DRAW_EDGES);
+}
+
 void instance_view_orthographic(instance_t* instance) {
     camera_anim_proj_orthographic(instance->camera);
+    instance_changed(instance);
 }
 
 void instance_view_perspective(instance_t* instance) {
     camera_anim_proj_perspective(instance->camera);
+    instance_changed(instance);
 }
 
 /******************************************************************************/
@@ -94,6 +162,7 @@ void instance_cb_window_size(instance_t* instance, int width, int height)
 {
     /*  Update camera size (and recalculate projection matrix) */
     camera_set_size(instance->camera, width, height);
+    instance->dirty = true;
 
 #ifdef PLATFORM_DARWIN
     /*  Continue to render while the window is being resized
@@ -108,14 +177,34 @@ void instance_cb_window_size(instance_t* instance, int width, int height)
 #endif
 }
 
+void instance_flush_input(instance_t* instance) {
+    if (instance->mouse_pending) {
+        /*  Moving the mouse only changes the view while dragging */
+        if (camera_set_mouse_pos(instance->camera, instance->mouse_pos[0],
+                                 instance->mouse_pos[1]))
+        {
+            quality_interact(instance->quality);
+            instance->dirty = true;
+        }
+        instance->mouse_pending = false;
+    }
+}
+
 void instance_cb_mouse_pos(instance_t* instance, float xpos, float ypos) {
-    camera_set_mouse_pos(instance->camera, xpos, ypos);
+    /*  Cursor events can arrive much faster than the display refreshes,
+     *  so only the latest position is kept */
+    instance->mouse_pos[0] = xpos;
+    instance->mouse_pos[1] = ypos;
+    instance->mouse_pending = true;
 }
 
 void instance_cb_mouse_click(instance_t* instance, int button,
                              int action, int mods)
 {
     (void)mods;
+
+    /*  Drags start from the current mouse position */
+    instance_flush_input(instance);
     if (action == GLFW_PRESS) {
         if (button == GLFW_MOUSE_BUTTON_1) {
             camera_begin_pan(instance->camera);
@@ -125,41 +214,127 @@ void instance_cb_mouse_click(instance_t* instance, int button,
     } else {
         camera_end_drag(instance->camera);
     }
+
+    /*  Starting or ending a drag changes the quality of the next frame
+     *  (see quality.h), even if the view hasn't moved */
+    instance->dirty = true;
 }
 
 void instance_cb_mouse_scroll(instance_t* instance,
                               float xoffset, float yoffset)
 {
     (void)xoffset;
+
+    /*  Zooming is centered on the mouse position */
+    instance_flush_input(instance);
     camera_zoom(instance->camera, yoffset);
+    quality_interact(instance->quality);
+    instance->dirty = true;
 }
 
 void instance_cb_focus(instance_t* instance, bool focus)
 {
     instance->focused = focus;
+
+    /*  Only the focused window waits for vsync when swapping buffers, so
+     *  that drawing several windows doesn't add up several vsync waits.
+     *  The frame scheduler paces the other windows. */
+    glfwMakeContextCurrent(instance->window);
+    glfwSwapInterval(focus ? 1 : 0);
     if (focus) {
         app_set_front(instance->parent, instance);
     }
+    app_update_priorities(instance->parent);
+}
+
+void instance_cb_key(instance_t* instance, int key, int action, int mods)
+{
+    (void)mods;
+    if (action == GLFW_PRESS && key == GLFW_KEY_H) {
+        instance->show_hud = !instance->show_hud;
+        instance->dirty = true;
+        glfwPostEmptyEvent();
+    }
+}
+
+void instance_cb_refresh(instance_t* instance)
+{
+    /*  The window system has discarded the window's contents */
+    instance->dirty = true;
+}
+
+/*  Returns the GPU time spent on the scene (backdrop and model) in the
+ *  latest frame with timing results, or a negative value */
+static float instance_scene_ms(instance_t* instance) {
+    const float backdrop = timing_get_gpu(instance->timing, 0,
+                                          TIMING_BACKDROP);
+    const float model = timing_get_gpu(instance->timing, 0, TIMING_MODEL);
+    return (backdrop < 0.0f || model < 0.0f) ? -1.0f : backdrop + model;
 }
 
 bool instance_draw(instance_t* instance, theme_t* theme) {
-    const bool needs_redraw = camera_check_anim(instance->camera);
+    const bool animating = camera_check_anim(instance->camera);
 
     glfwMakeContextCurrent(instance->window);
+    timing_frame_begin(instance->timing);
+    quality_update(instance->quality, instance_scene_ms(instance),
+                   scheduler_get_interval_ms(instance->parent->scheduler));
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+    /*  While the view is moving, the scene may be drawn offscreen at a
+     *  lower resolution, then upscaled at the end of the model stage */
+    const bool reduced = quality_begin(
+            instance->quality,
+            animating || camera_is_dragging(instance->camera));
+    timing_begin(instance->timing, TIMING_BACKDROP);
     backdrop_draw(instance->backdrop, theme);
+    timing_end(instance->timing);
 
+    /*  Draw whichever chunks of the model have arrived (and are resident
+     *  on the GPU), with a progress bar on top until the rest of it is
+     *  loaded */
+    timing_begin(instance->timing, TIMING_MODEL);
+    const bool streaming = resident_update(instance->model, instance->camera);
     switch (instance->draw_mode) {
         case DRAW_SHADED:
-            draw(instance->shaded, instance->model, instance->camera, theme);
+            draw(instance->shaded, instance->model,
+                 instance->camera, theme);
             break;
         case DRAW_WIREFRAME:
-            draw(instance->wireframe, instance->model, instance->camera, theme);
+            wireframe_draw(instance->wireframe, instance->model,
+                           instance->camera, theme);
+            break;
+        case DRAW_EDGES:
+            draw(instance->shaded, instance->model,
+                 instance->camera, theme);
+            lines_draw(instance->lines, instance->model, instance->camera);
             break;
     }
+    quality_end(instance->quality, instance->backdrop);
+    if (instance->loader) {
+        hud_draw_progress(instance->hud,
+                          loader_get_progress(instance->loader));
+    }
+    timing_end(instance->timing);
 
+    if (instance->show_hud) {
+        timing_begin(instance->timing, TIMING_HUD);
+        hud_draw(instance->hud, instance->timing);
+        timing_end(instance->timing);
+    }
+
+    timing_swap_begin(instance->timing);
     glfwSwapBuffers(instance->window);
-    return needs_redraw;
+    timing_swap_end(instance->timing);
+
+    timing_frame_end(instance->timing);
+
+    /*  Keep redrawing while loading (or streaming visible chunks to the
+     *  GPU), to animate the progress bar and show new chunks of the model,
+     *  and after a reduced frame, so that a full-quality frame is drawn
+     *  once the view settles */
+    instance->dirty = animating || reduced || instance->loader || streaming;
+    return instance->dirty;
 }
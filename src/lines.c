@@ -0,0 +1,73 @@
+#include "camera.h"
+#include "lines.h"
+#include "log.h"
+#include "model.h"
+#include "object.h"
+#include "shader.h"
+
+static const GLchar* LINES_VS_SRC = GLSL(330,
+layout(location=0) in vec3 pos;
+
+layout(std140) uniform camera { mat4 proj; mat4 view; };
+uniform mat4 model;
+
+void main() {
+    gl_Position = proj * view * model * vec4(pos, 1.0f);
+}
+);
+
+/*  Lines are blended multiplicatively, so they darken the shading */
+static const GLchar* LINES_FS_SRC = GLSL(330,
+out vec4 out_color;
+
+void main() {
+    out_color = vec4(0.35f, 0.35f, 0.35f, 1.0f);
+}
+);
+
+struct lines_ {
+    shader_t shader;
+    camera_uniforms_t u_camera;
+};
+
+lines_t* lines_new() {
+    OBJECT_ALLOC(lines);
+    lines->shader = shader_new(LINES_VS_SRC, NULL, LINES_FS_SRC);
+    lines->u_camera = camera_get_uniforms(lines->shader.prog);
+    log_gl_error();
+    return lines;
+}
+
+void lines_delete(lines_t* lines) {
+    shader_deinit(lines->shader);
+    free(lines);
+}
+
+void lines_draw(lines_t* lines, model_t* model, camera_t* camera) {
+    /*  Lines pass the depth test against their own triangles because
+     *  triangles are drawn with a polygon offset (see draw.c).  Each edge
+     *  is stored once, so it's only darkened once. */
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+
+    glUseProgram(lines->shader.prog);
+    camera_bind(camera, lines->u_camera);
+    for (unsigned i=0; i < model->chunk_count; ++i) {
+        const model_chunk_t* chunk = &model->chunks[i];
+        if (chunk->line_count && chunk->vbo) {
+            camera_bind_model(camera, lines->u_camera,
+                              chunk->offset, chunk->scale);
+            glBindVertexArray(chunk->line_vao);
+            glDrawElements(GL_LINES, chunk->line_count * 2,
+                           GL_UNSIGNED_INT, NULL);
+        }
+    }
+
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    log_gl_error();
+}
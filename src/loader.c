@@ -1,27 +1,56 @@
+#include "arena.h"
 #include "camera.h"
 #include "icosphere.h"
 #include "loader.h"
+#include "lod.h"
 #include "log.h"
 #include "mat.h"
+#include "mem.h"
 #include "model.h"
 #include "object.h"
+#include "options.h"
 #include "platform.h"
+#include "pool.h"
+#include "quantize.h"
+#include "report.h"
+#include "simd.h"
+#include "staging.h"
 #include "worker.h"
 
 struct loader_ {
-    const char* filename;
+    char* filename;
+
+    /*  Copied from the caller, so that workers can read them safely */
+    options_t options;
 
     /*  Model parameters */
-    GLuint vbo;
-    GLuint ibo;
     uint32_t tri_count;
     uint32_t vert_count;
-    vec3_t center;
-    float scale;
 
-    /*  GPU-mapped buffers, populated by main thread */
-    float* vertex_buf;
-    uint32_t* index_buf;
+    /*  One worker per chunk of the model, allocated before LOADER_CHUNKS */
+    worker_t* workers;
+    unsigned worker_count;
+
+    /*  Chunks with mapped buffers, which is only used by the main thread */
+    unsigned mapped_count;
+
+    /*  Index of the next chunk to be deduplicated, which is incremented
+     *  atomically by the pool tasks that start each chunk */
+    unsigned next_dedup;
+
+    /*  Persistently mapped ring that chunks are filled through, if it's
+     *  supported (see staging.h).  This is created by the main thread on
+     *  the first call to loader_upload, since it needs an OpenGL context. */
+    staging_t* staging;
+    bool staging_checked;
+
+    /*  Chunks that have been moved into the model, which is written by
+     *  the main thread and protected by the mutex */
+    unsigned uploaded_count;
+
+    /*  Bounds of the uploaded chunks, used by the main thread */
+    float min[3];
+    float max[3];
 
     /*  Synchronization system */
     struct platform_thread_* thread;
@@ -29,47 +58,123 @@ struct loader_ {
     struct platform_mutex_* mutex;
     struct platform_cond_* cond;
 
-    /*  Each worker thread increments count when they are
-     *  done building their vertex set, using the same mutex
-     *  and condition variable. */
-    unsigned count;
+    /*  Workers run as tasks on the app's shared thread pool */
+    pool_group_t* group;
+
+    /*  Set (atomically) when the load is abandoned */
+    bool cancelled;
+
+    /*  Progress counters, which are updated atomically by the loader and
+     *  worker threads and read without locking by the main thread */
+    size_t parse_total;     /* Bytes of ASCII STL (0 for binary files) */
+    size_t parse_done;
+    uint32_t dedup_total;   /* Triangles */
+    uint32_t dedup_done;
+
+    /*  Statistics about the load, finalized before LOADER_DONE */
+    report_t report;
+    int64_t start_time;
 };
 
+/*  Triangles per chunk.  Chunks are deduplicated and drawn independently,
+ *  so this trades off duplicated vertices (at chunk edges) and draw calls
+ *  against how soon the first part of the model appears on screen. */
+#define LOADER_CHUNK_TRIS (1 << 16)
+
+/*  Maximum number of chunks with mapped GPU buffers at once */
+#define LOADER_MAX_MAPPED 8
+
+/*  Maximum number of chunks holding scratch memory at once (from the start
+ *  of dedup until their scratch is released).  This bounds the loader's
+ *  peak RAM, rather than letting chunks pile up while they wait to be
+ *  mapped; it must be larger than LOADER_MAX_MAPPED, so that chunks are
+ *  always ready to fill the mapped slots. */
+#define LOADER_MAX_SCRATCH (2 * LOADER_MAX_MAPPED)
+
 static void* loader_run(void* loader_);
 
+/*  Submits the next chunk's dedup task, if any chunks are left */
+static void loader_start_chunk(loader_t* loader) {
+    const unsigned i = __atomic_fetch_add(&loader->next_dedup, 1,
+                                          __ATOMIC_RELAXED);
+    if (i < loader->worker_count) {
+        pool_submit(loader->group, worker_dedup, &loader->workers[i]);
+    }
+}
+
+void loader_release_chunk(loader_t* loader, worker_t* worker) {
+    if (worker->arena) {
+        worker_release(worker);
+        loader_start_chunk(loader);
+    }
+}
+
+bool loader_cancelled(loader_t* loader) {
+    return __atomic_load_n(&loader->cancelled, __ATOMIC_ACQUIRE);
+}
+
 void loader_wait(loader_t* loader, loader_state_t target) {
     platform_mutex_lock(loader->mutex);
-    while (loader->state < target) {
+    while (loader->state < target && !loader->cancelled) {
         platform_cond_wait(loader->cond, loader->mutex);
     }
     platform_mutex_unlock(loader->mutex);
 }
 
+static const char* loader_state_name(loader_state_t state) {
+    switch (state) {
+        case LOADER_START:      return "start";
+        case LOADER_CHUNKS:     return "chunks";
+        case LOADER_DONE:       return "done";
+        case LOADER_ERROR_CANCELLED:    return "cancelled";
+        default:                return "error";
+    }
+}
+
 void loader_next(loader_t* loader, loader_state_t target) {
     platform_mutex_lock(loader->mutex);
     loader->state = target;
+    report_sample(&loader->report, loader_state_name(target),
+                  platform_get_time() - loader->start_time);
     platform_cond_broadcast(loader->cond);
     platform_mutex_unlock(loader->mutex);
 }
 
-loader_t* loader_new(const char* filename) {
+loader_t* loader_new(const char* filename, const options_t* options,
+                     pool_t* pool)
+{
     OBJECT_ALLOC(loader);
+    loader->options = *options;
     loader->mutex = platform_mutex_new();
     loader->cond = platform_cond_new();
+    loader->group = pool_group_new(pool);
+    for (unsigned i=0; i < 3; ++i) {
+        loader->min[i] = INFINITY;
+        loader->max[i] = -INFINITY;
+    }
 
-    loader->filename = filename;
+    loader->filename = (char*)calloc(1, strlen(filename) + 1);
+    strcpy(loader->filename, filename);
+    loader->start_time = platform_get_time();
     loader->thread = platform_thread_new(loader_run, loader);
     return loader;
 }
 
-static const char* loader_parse_ascii(const char* data, size_t* size) {
+static const char* loader_parse_ascii(loader_t* loader, arena_t* arena,
+                                      const char* data, size_t in_size,
+                                      size_t* size) {
+    const char* const start = data;
+    const char* const end = data + in_size;
+    const simd_kernels_t* simd = simd_get();
+    __atomic_store_n(&loader->parse_total, in_size, __ATOMIC_RELAXED);
+
     size_t buf_size = 256;
     size_t buf_count = 0;
-    float* buffer = (float*)malloc(sizeof(float) * buf_size);
+    float* buffer = (float*)arena_alloc(arena, MEM_LOADER,
+                                        sizeof(float) * buf_size);
 
 #define ABORT_IF(cond, msg) \
     if (cond) {             \
-        free(buffer);       \
         log_error(msg);     \
         return NULL;        \
     }
@@ -84,13 +189,18 @@ static const char* loader_parse_ascii(const char* data, size_t* size) {
      *  the word 'vertex', then read three floats after each one. */
     const char VERTEX_STR[] = "vertex ";
     while (1) {
-        data = strstr(data, VERTEX_STR);
+        data = simd->find_vertex(data, end);
         if (!data) {
             break;
         }
 
         /* Skip to the first character after 'vertex' */
         data += strlen(VERTEX_STR);
+        __atomic_store_n(&loader->parse_done, data - start,
+                         __ATOMIC_RELAXED);
+        if (loader_cancelled(loader)) {
+            return NULL;
+        }
 
         for (unsigned i=0; i < 3; ++i) {
             /* errno can be set by realloc even on non-failures,
@@ -100,8 +210,10 @@ static const char* loader_parse_ascii(const char* data, size_t* size) {
             const float f = strtof(data, &end_ptr);
             ABORT_IF(errno != 0, "Failed to parse float");
             if (buf_size == buf_count) {
+                buffer = (float*)arena_grow(arena, MEM_LOADER, buffer,
+                                            buf_size * sizeof(float),
+                                            buf_size * 2 * sizeof(float));
                 buf_size *= 2;
-                buffer = (float*)realloc(buffer, buf_size * sizeof(float));
             }
             buffer[buf_count++] = f;
             data = end_ptr;
@@ -112,7 +224,7 @@ static const char* loader_parse_ascii(const char* data, size_t* size) {
     ABORT_IF(buf_count % 9 != 0, "Total vertex count isn't divisible by 9");
     const uint32_t triangle_count = buf_count / 9;
     *size = 84 + 50 * triangle_count;
-    char* out = (char*)malloc(*size);
+    char* out = (char*)arena_alloc(arena, MEM_LOADER, *size);
 
     /*  Copy triangle count into the buffer */
     memcpy(&out[80], &triangle_count, 4);
@@ -122,15 +234,66 @@ static const char* loader_parse_ascii(const char* data, size_t* size) {
     for (unsigned i=0; i < buf_count / 9; i++)  {
         memcpy(&out[84 + i*50 + 12], &buffer[i*9], 36);
     }
-    free(buffer);
 
     return out;
 }
 
-static void* loader_run(void* loader_) {
-    loader_t* loader = (loader_t*)loader_;
+/*  Arguments and result for parsing an ASCII file on the thread pool */
+typedef struct loader_parse_ {
+    loader_t* loader;
+    arena_t* arena;
+    const char* data;
+    size_t size;
+
+    const char* out;
+    size_t out_size;
+} loader_parse_t;
+
+static void loader_parse_task(void* parse_) {
+    loader_parse_t* parse = (loader_parse_t*)parse_;
+    parse->out = loader_parse_ascii(parse->loader, parse->arena,
+                                    parse->data, parse->size,
+                                    &parse->out_size);
+}
+
+/*  Releases a memory-mapped file, which may be NULL.  Other file data
+ *  (for ASCII files and builtin models) belongs to the loader's arena. */
+static void loader_unmap(platform_mmap_t* mapped) {
+    if (mapped) {
+        mem_track(MEM_FILE, -(int64_t)platform_mmap_size(mapped));
+        platform_munmap(mapped);
+    }
+}
+
+/*  Unwinds a cancelled load, after waiting for running pool tasks to
+ *  notice.  Partial buffers live in the arenas, and GPU buffers are freed
+ *  by loader_delete. */
+static void loader_abandon(loader_t* loader, platform_mmap_t* mapped) {
+    pool_group_wait(loader->group);
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        worker_release(&loader->workers[i]);
+    }
+    loader_unmap(mapped);
+    log_trace("Load cancelled");
+    loader_next(loader, LOADER_ERROR_CANCELLED);
+}
+
+static void loader_load(loader_t* loader, arena_t* arena) {
     loader_next(loader, LOADER_START);
 
+    report_t* const report = &loader->report;
+    report->filename = loader->filename;
+    report->simd = simd_level_name(simd_get()->level);
+    report->morton = loader->options.morton;
+    report->lod = loader->options.lod;
+    report->vcache = loader->options.vcache;
+    int64_t stage_time = loader->start_time;
+#define STAGE_TIME(t) do {                          \
+        const int64_t now = platform_get_time();    \
+        report->t = now - stage_time;               \
+        stage_time = now;                           \
+    } while (0)
+
     platform_mmap_t* mapped = NULL;
     const char* data = NULL;
     size_t size; /* filesize in bytes */
@@ -138,18 +301,22 @@ static void* loader_run(void* loader_) {
     /*  This magic filename tells us to load a builtin array,
      *  rather than something in the filesystem */
     if (!strcmp(loader->filename, ":/sphere")) {
-        data = icosphere_stl(1, &size);
+        data = icosphere_stl(arena, 1, &size);
+        report->format = REPORT_FORMAT_BUILTIN;
     } else {
         mapped = platform_mmap(loader->filename);
         if (mapped) {
             data = platform_mmap_data(mapped);
             size = platform_mmap_size(mapped);
+            mem_track(MEM_FILE, size);
         } else {
             log_error("Could not open %s", loader->filename);
             loader_next(loader, LOADER_ERROR_NO_FILE);
-            return NULL;
+            return;
         }
     }
+    report->file_size = size;
+    STAGE_TIME(time_open);
 
     /*  Check whether this is an ASCII stl.  Some binary STL files
      *  still start with the word 'solid', so we check the file size
@@ -169,26 +336,33 @@ static void* loader_run(void* loader_) {
     /*  Convert from an ASCII STL to a binary STL so that the rest of the
      *  loader can run unobstructed. */
     if (is_ascii) {
-        size_t new_size;
-        const char* new_data = loader_parse_ascii(data, &new_size);
-        if (new_data) {
-            platform_munmap(mapped);
+        report->format = REPORT_FORMAT_ASCII;
+        loader_parse_t parse = {
+            .loader = loader, .arena = arena, .data = data, .size = size};
+        pool_submit(loader->group, loader_parse_task, &parse);
+        pool_group_wait(loader->group);
+        if (loader_cancelled(loader)) {
+            loader_abandon(loader, mapped);
+            return;
+        } else if (parse.out) {
+            loader_unmap(mapped);
             mapped = NULL;
-            data = new_data;
-            size = new_size;
+            data = parse.out;
+            size = parse.out_size;
         } else {
             loader_next(loader, LOADER_ERROR_BAD_ASCII_STL);
-            platform_munmap(mapped);
-            return NULL;
+            loader_unmap(mapped);
+            return;
         }
     }
+    STAGE_TIME(time_parse);
 
     /*  Check whether the file is a valid size. */
     if (size < 84) {
         log_error("File is too small to be an STL (%u < 84)", (unsigned)size);
         loader_next(loader, LOADER_ERROR_WRONG_SIZE);
-        platform_munmap(mapped);
-        return NULL;
+        loader_unmap(mapped);
+        return;
     }
 
     /*  Pull the number of triangles from the raw STL data */
@@ -200,80 +374,189 @@ static void* loader_run(void* loader_) {
         log_error("Invalid file size for %u triangles (expected %u, got %u)",
                   loader->tri_count, expected_size, (unsigned)size);
         loader_next(loader, LOADER_ERROR_WRONG_SIZE);
-        platform_munmap(mapped);
-        return NULL;
+        loader_unmap(mapped);
+        return;
+    }
+
+    __atomic_store_n(&loader->dedup_total, loader->tri_count,
+                     __ATOMIC_RELAXED);
+
+    /*  Split the model into chunks, each of which is deduplicated by a
+     *  pool task.  The main thread polls the workers (in loader_upload),
+     *  mapping buffers for each chunk as it becomes ready; another task
+     *  copies the chunk into the buffers, then the main thread adds it to
+     *  the model so that it's drawn while the rest of the model loads. */
+    loader->worker_count = (loader->tri_count + LOADER_CHUNK_TRIS - 1)
+                         / LOADER_CHUNK_TRIS;
+    loader->workers = (worker_t*)mem_calloc(
+            MEM_LOADER, loader->worker_count, sizeof(worker_t));
+
+    /*  Every chunk measures its volume from the model's first vertex,
+     *  which keeps the sum precise for models far from the origin */
+    float origin[3] = {0.0f, 0.0f, 0.0f};
+    if (loader->tri_count) {
+        memcpy(origin, &data[80 + 4 + 12], sizeof(origin));
+        for (unsigned j=0; j < 3; ++j) {
+            origin[j] = isfinite(origin[j]) ? origin[j] : 0.0f;
+        }
+    }
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        const size_t start = (size_t)i * LOADER_CHUNK_TRIS;
+        size_t end = start + LOADER_CHUNK_TRIS;
+        if (end > loader->tri_count) {
+            end = loader->tri_count;
+        }
+
+        worker_t* const worker = &loader->workers[i];
+        worker->loader = loader;
+        worker->options = &loader->options;
+        worker->state = WORKER_DEDUP;
+        worker->tri_count = end - start;
+        worker->stl = (const char (*)[50])&data[80 + 4 + 12 + 50 * start];
+        memcpy(worker->origin, origin, sizeof(origin));
     }
 
-    /*  The worker threads deduplicate a subset of the vertices, then
-     *  increment loader->count to indicate that they're done. */
-    const size_t NUM_WORKERS = 6;
-    worker_t workers[NUM_WORKERS];
-    for (unsigned i=0; i < NUM_WORKERS; ++i) {
-        const size_t start = i * loader->tri_count / NUM_WORKERS;
-        const size_t end = (i + 1) * loader->tri_count / NUM_WORKERS;
+    /*  Measure every chunk to pick one quantization lattice for the whole
+     *  model, which must be known before any chunk is copied */
+    bool quantized = false;
+    float lattice_min[3] = {INFINITY, INFINITY, INFINITY};
+    float lattice_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    if (loader->options.quantize) {
+        for (unsigned i=0; i < loader->worker_count; ++i) {
+            pool_submit(loader->group, worker_measure, &loader->workers[i]);
+        }
+        pool_group_wait(loader->group);
+        if (loader_cancelled(loader)) {
+            loader_abandon(loader, mapped);
+            return;
+        }
+        float edge = INFINITY;
+        for (unsigned i=0; i < loader->worker_count; ++i) {
+            const worker_t* const worker = &loader->workers[i];
+            for (unsigned j=0; j < 3; ++j) {
+                lattice_min[j] = fminf(lattice_min[j], worker->min[j]);
+                lattice_max[j] = fmaxf(lattice_max[j], worker->max[j]);
+            }
+            edge = fminf(edge, worker->edge);
+        }
+        quantized = quantize_check(lattice_min, lattice_max, edge);
+    }
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        worker_t* const worker = &loader->workers[i];
+        worker->quantized = quantized;
+        memcpy(worker->lattice_min, lattice_min, sizeof(lattice_min));
+        memcpy(worker->lattice_max, lattice_max, sizeof(lattice_max));
+    }
+    loader_next(loader, LOADER_CHUNKS);
+    glfwPostEmptyEvent();
 
-        workers[i].loader = loader;
-        workers[i].tri_count = end - start;
-        workers[i].stl = (const char (*)[50])&data[80 + 4 + 12 + 50 * start];
+    /*  Start the first few chunks; each chunk starts the next one as it
+     *  releases its scratch memory (in loader_release_chunk) */
+    loader->next_dedup = 0;
+    for (unsigned i=0; i < LOADER_MAX_SCRATCH; ++i) {
+        loader_start_chunk(loader);
+    }
 
-        worker_start(&workers[i]);
+    /*  Wait for every chunk to be deduplicated.  This also waits for any
+     *  copy tasks that the main thread has submitted in the meantime, and
+     *  the dedup tasks that they start. */
+    pool_group_wait(loader->group);
+    if (loader_cancelled(loader)) {
+        loader_abandon(loader, mapped);
+        return;
     }
+    log_trace("Workers have deduplicated vertices");
+    STAGE_TIME(time_dedup);
 
-    /*  Wait for all of the worker threads to finish deduplicating vertices */
+    /*  The raw file is no longer needed */
+    loader_unmap(mapped);
+    mapped = NULL;
+
+    /*  Wait for the main thread to upload the remaining chunks */
     platform_mutex_lock(loader->mutex);
-    while (loader->count != NUM_WORKERS) {
+    while (loader->uploaded_count < loader->worker_count &&
+           !loader->cancelled)
+    {
         platform_cond_wait(loader->cond, loader->mutex);
     }
     platform_mutex_unlock(loader->mutex);
-    log_trace("Workers have deduplicated vertices");
+    if (loader_cancelled(loader)) {
+        loader_abandon(loader, mapped);
+        return;
+    }
+    log_trace("Main thread has uploaded every chunk");
+    STAGE_TIME(time_copy);
+
+    /*  Wait for the last chunks' edges and levels of detail, then match
+     *  the edges that cross between chunks */
+    pool_group_wait(loader->group);
+    if (loader_cancelled(loader)) {
+        loader_abandon(loader, mapped);
+        return;
+    }
+    edges_t** const edges = (edges_t**)arena_alloc(
+            arena, MEM_LOADER, sizeof(edges_t*) * loader->worker_count);
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        edges[i] = &loader->workers[i].edges;
+    }
+    edges_merge(edges, loader->worker_count, arena);
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        report->line_count += edges[i]->line_count;
+        report->flaw_count += edges[i]->flaws;
+        report->volume += edges[i]->volume;
+    }
+    log_trace("Found %u feature edges", report->line_count);
+    STAGE_TIME(time_edges);
 
-    /*  Accumulate the total vertex count, then wait for the OpenGL thread
-     *  to allocate the vertex and triangle buffers */
     loader->vert_count = 0;
-    for (unsigned i=0; i < NUM_WORKERS; ++i) {
-        workers[i].tri_offset = loader->vert_count;
-        loader->vert_count += workers[i].vert_count;
-    }
-    log_trace("Got %u vertices (%u triangles)", loader->vert_count,
-            loader->tri_count);
-    loader_next(loader, LOADER_MODEL_SIZE);
-
-    log_trace("Waiting for buffer...");
-    loader_wait(loader, LOADER_GPU_BUFFER);
-
-    /*  Populate GPU pointers, then kick off workers copying triangles */
-    size_t tri_offset = 0;
-    size_t vert_offset = 0;
-    for (unsigned i=0; i < NUM_WORKERS; ++i) {
-        workers[i].vertex_buf = &loader->vertex_buf[vert_offset];
-        workers[i].index_buf  = &loader->index_buf[tri_offset];
-        vert_offset += workers[i].vert_count * 3;
-        tri_offset  += workers[i].tri_count  * 3;
-    }
-    loader_next(loader, LOADER_WORKER_GPU);
-    log_trace("Sent buffers to worker threads");
-
-    for (unsigned i=0; i < NUM_WORKERS; ++i) {
-        worker_finish(&workers[i]);
-    }
-    log_trace("Joined worker threads");
-
-    /*  Reduce min / max arrays from worker subprocesses */
-    for (unsigned v=0; v < 3; ++v) {
-        for (unsigned i=1; i < NUM_WORKERS; ++i) {
-            if (workers[i].max[v] > workers[0].max[v]) {
-                workers[0].max[v] = workers[i].max[v];
-            }
-            if (workers[i].min[v] < workers[0].min[v]) {
-                workers[0].min[v] = workers[i].min[v];
-            }
-        }
-        loader->center.v[v] = (workers[0].max[v] + workers[0].min[v]) / 2.0f;
-        const float d = workers[0].max[v] - workers[0].min[v];
-        if (d > loader->scale) {
-            loader->scale = d;
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        loader->vert_count += loader->workers[i].vert_count;
+    }
+    log_trace("Got %u vertices (%u triangles) in %u chunks",
+              loader->vert_count, loader->tri_count, loader->worker_count);
+
+    /*  Record per-worker statistics, which are otherwise discarded */
+    report->tri_count = loader->tri_count;
+    report->vert_count = loader->vert_count;
+    report->worker_count = loader->worker_count;
+    report->workers = (report_worker_t*)mem_calloc(
+            MEM_LOADER, loader->worker_count, sizeof(report_worker_t));
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        const worker_t* const worker = &loader->workers[i];
+        report->workers[i].tri_count = worker->tri_count;
+        report->workers[i].vert_count = worker->vert_count;
+        report->workers[i].nan_count = worker->nan_count;
+        report->workers[i].vset = worker->stats;
+        report->workers[i].time_vcache = worker->time_vcache;
+        report->workers[i].quantized = worker->quantized;
+        report->vbo_bytes += worker_vbo_bytes(worker);
+        report->quantized_count += worker->quantized;
+        report->workers[i].index_size =
+            (worker->index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+        report->workers[i].range_count = worker->range_count;
+        report->workers[i].cluster_count = worker->cluster_count;
+        report->workers[i].lod_count = worker->lod.level_count;
+        report->workers[i].time_lod = worker->time_lod;
+        report->lod_tri_count += worker->lod.index_count / 3;
+        report->ibo_bytes += worker_ibo_bytes(worker);
+        report->short_index_count +=
+            (worker->index_type == GL_UNSIGNED_SHORT);
+        report->range_count += worker->range_count;
+        report->cluster_count += worker->cluster_count;
+        report->nan_count += worker->nan_count;
+        for (unsigned j=0; j < 2; ++j) {
+            report->workers[i].acmr[j] = worker->acmr[j];
+            report->acmr[j] += worker->acmr[j] * worker->tri_count;
         }
     }
+    for (unsigned j=0; j < 2; ++j) {
+        report->acmr[j] = loader->tri_count
+            ? report->acmr[j] / loader->tri_count : 0.0f;
+    }
+    report->peak_rss = platform_get_peak_rss();
+    mem_get_stats(&report->mem);
+    report->time_total = platform_get_time() - loader->start_time;
+#undef STAGE_TIME
 
     /*  Mark the load as done and post an empty event, to make sure that
      *  the main loop wakes up and checks the loader */
@@ -281,105 +564,306 @@ static void* loader_run(void* loader_) {
     loader_next(loader, LOADER_DONE);
     glfwPostEmptyEvent();
 
-    /*  Release any allocated file data */
-    if (mapped) {
-        platform_munmap(mapped);
-    } else {
-        free((void*)data);
-    }
+    report_log(report);
+    report_save(report);
+}
+
+static void* loader_run(void* loader_) {
+    loader_t* loader = (loader_t*)loader_;
+
+    /*  Scratch memory for the loader thread itself */
+    arena_t* arena = arena_acquire();
+    loader_load(loader, arena);
+    arena_release(arena);
 
     return NULL;
 }
 
-void loader_allocate_vbo(loader_t* loader) {
-    glGenBuffers(1, &loader->vbo);
-    glGenBuffers(1, &loader->ibo);
-    glBindBuffer(GL_ARRAY_BUFFER, loader->vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loader->ibo);
-    loader_wait(loader, LOADER_MODEL_SIZE);
-
-    /*  Early return if there is an error in the loader;
-     *  we leave the buffer allocated so it can be cleaned
-     *  up as usual later. */
-    if (loader->state >= LOADER_ERROR) {
-        return;
+loader_state_t loader_get_state(loader_t* loader) {
+    platform_mutex_lock(loader->mutex);
+    const loader_state_t state = loader->state;
+    platform_mutex_unlock(loader->mutex);
+    return state;
+}
+
+void loader_add_progress(loader_t* loader, uint32_t tri_count) {
+    __atomic_add_fetch(&loader->dedup_done, tri_count, __ATOMIC_RELAXED);
+}
+
+float loader_get_progress(loader_t* loader) {
+    const size_t parse_total =
+        __atomic_load_n(&loader->parse_total, __ATOMIC_RELAXED);
+    const size_t parse_done =
+        __atomic_load_n(&loader->parse_done, __ATOMIC_RELAXED);
+    const uint32_t dedup_total =
+        __atomic_load_n(&loader->dedup_total, __ATOMIC_RELAXED);
+    const uint32_t dedup_done =
+        __atomic_load_n(&loader->dedup_done, __ATOMIC_RELAXED);
+
+    const float dedup = dedup_total ? (float)dedup_done / dedup_total : 0.0f;
+    if (parse_total) {
+        /*  Parsing an ASCII file takes about as long as deduplication */
+        return 0.5f * parse_done / parse_total + 0.5f * dedup;
     }
+    return dedup;
+}
 
-    /*  Allocate and map index buffer */
-    const size_t ibo_bytes = loader->tri_count * 3 * sizeof(uint32_t);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ibo_bytes, NULL, GL_STATIC_DRAW);
-    loader->index_buf = (uint32_t*)glMapBufferRange(
-            GL_ELEMENT_ARRAY_BUFFER, 0, ibo_bytes,
-            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
-                             | GL_MAP_INVALIDATE_BUFFER_BIT
-                             | GL_MAP_UNSYNCHRONIZED_BIT);
-
-    /*  Allocate and map vertex buffer */
-    const size_t vbo_bytes = loader->vert_count * 3 * sizeof(float);
-    glBufferData(GL_ARRAY_BUFFER, vbo_bytes, NULL, GL_STATIC_DRAW);
-    loader->vertex_buf = (float*)glMapBufferRange(
-            GL_ARRAY_BUFFER, 0, vbo_bytes,
-            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
-                             | GL_MAP_INVALIDATE_BUFFER_BIT
-                             | GL_MAP_UNSYNCHRONIZED_BIT);
-    loader_next(loader, LOADER_GPU_BUFFER);
-
-    log_trace("Allocated buffer");
+/*  Returns the offset of a staged chunk's vertices, which follow its
+ *  indices in the same region */
+static size_t loader_staged_vbo_offset(const worker_t* worker) {
+    return (worker_ibo_bytes(worker) + STAGING_ALIGN - 1)
+         / STAGING_ALIGN * STAGING_ALIGN;
 }
 
-void loader_finish(loader_t* loader, model_t* model, camera_t* camera) {
-    if (!loader->vbo) {
-        log_error_and_abort("Invalid loader VBO");
-    } else if (!loader->ibo) {
-        log_error_and_abort("Invalid loader IBO");
-    } else if (!model->vao) {
-        log_error_and_abort("Invalid model VAO");
+/*  Allocates GPU buffers for a chunk (in the staging ring, if possible,
+ *  or otherwise by mapping its own buffers), then hands them to a pool
+ *  task to be filled.  With a GPU memory budget (or if mapping fails),
+ *  the chunk is filled in RAM instead, and streamed to the GPU when it's
+ *  visible (see resident.h).  If the staging ring is full, the chunk is
+ *  left alone until a later call, rather than waiting for the GPU. */
+static void loader_map_chunk(loader_t* loader, worker_t* worker) {
+    const size_t ibo_bytes = worker_ibo_bytes(worker);
+    const size_t vbo_bytes = worker_vbo_bytes(worker);
+    const size_t vbo_offset = loader_staged_vbo_offset(worker);
+    if (loader->staging && !loader->options.gpu_budget) {
+        void* ptr;
+        const int region = staging_alloc(loader->staging,
+                                         vbo_offset + vbo_bytes, &ptr);
+        if (region >= 0) {
+            worker->staged = true;
+            worker->region = region;
+            worker->index_buf = ptr;
+            worker->vertex_buf = (uint8_t*)ptr + vbo_offset;
+        } else if (vbo_offset + vbo_bytes <= STAGING_SIZE) {
+            return;
+        }
+    }
+    if (!worker->staged && !loader->options.gpu_budget) {
+        glGenBuffers(1, &worker->vbo);
+        glGenBuffers(1, &worker->ibo);
+        glBindBuffer(GL_ARRAY_BUFFER, worker->vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, worker->ibo);
+
+        /*  Allocate and map index buffer */
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, ibo_bytes, NULL, GL_STATIC_DRAW);
+        worker->index_buf = glMapBufferRange(
+                GL_ELEMENT_ARRAY_BUFFER, 0, ibo_bytes,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+                                 | GL_MAP_INVALIDATE_BUFFER_BIT
+                                 | GL_MAP_UNSYNCHRONIZED_BIT);
+
+        /*  Allocate and map vertex buffer */
+        glBufferData(GL_ARRAY_BUFFER, vbo_bytes, NULL, GL_STATIC_DRAW);
+        worker->vertex_buf = glMapBufferRange(
+                GL_ARRAY_BUFFER, 0, vbo_bytes,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+                                 | GL_MAP_INVALIDATE_BUFFER_BIT
+                                 | GL_MAP_UNSYNCHRONIZED_BIT);
+
+        if (worker->index_buf && worker->vertex_buf) {
+            mem_track(MEM_GPU, ibo_bytes + vbo_bytes);
+        } else {
+            /*  Mapping fails if the GPU is out of memory (among other
+             *  things), so fall back to filling the chunk in RAM */
+            log_warn("Failed to map buffers for chunk (%.1f MB)",
+                     (ibo_bytes + vbo_bytes) / 1048576.0);
+            if (worker->index_buf) {
+                glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+            }
+            if (worker->vertex_buf) {
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            glDeleteBuffers(1, &worker->vbo);
+            glDeleteBuffers(1, &worker->ibo);
+            worker->vbo = 0;
+            worker->ibo = 0;
+        }
+    }
+    if (!worker->staged && !worker->vbo) {
+        worker->index_buf = mem_malloc(MEM_RESIDENT, ibo_bytes);
+        worker->vertex_buf = mem_malloc(MEM_RESIDENT, vbo_bytes);
     }
 
-    loader_wait(loader, LOADER_DONE);
+    loader->mapped_count++;
+    __atomic_store_n(&worker->state, WORKER_MAPPED, __ATOMIC_RELEASE);
 
-    /*  If the loader succeeded, then set up all of the
-     *  GL buffers, matrices, etc. */
-    if (loader->state == LOADER_DONE) {
-        glBindVertexArray(model->vao);
+    /*  Copy ahead of the remaining dedup tasks, so that the chunk can be
+     *  drawn (and its buffers unmapped) as soon as possible */
+    pool_submit_front(loader->group, worker_copy, worker);
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, loader->vbo);
+/*  Unmaps a chunk's buffers (or copies them out of the staging ring),
+ *  which must happen on the main thread.  Buffers in RAM are left for
+ *  the caller to hand to the model. */
+static void loader_unmap_chunk(loader_t* loader, worker_t* worker) {
+    if (worker->staged) {
+        const size_t ibo_bytes = worker_ibo_bytes(worker);
+        const size_t vbo_bytes = worker_vbo_bytes(worker);
+        glGenBuffers(1, &worker->vbo);
+        glGenBuffers(1, &worker->ibo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, worker->ibo);
+        glBufferData(GL_COPY_WRITE_BUFFER, ibo_bytes, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, worker->vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, vbo_bytes, NULL, GL_STATIC_DRAW);
+        staging_copy(loader->staging, worker->region, 0,
+                     worker->ibo, ibo_bytes);
+        staging_copy(loader->staging, worker->region,
+                     loader_staged_vbo_offset(worker),
+                     worker->vbo, vbo_bytes);
+        staging_release(loader->staging, worker->region);
+        worker->staged = false;
+    } else if (worker->vbo) {
+        glBindBuffer(GL_ARRAY_BUFFER, worker->vbo);
         glUnmapBuffer(GL_ARRAY_BUFFER);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loader->ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, worker->ibo);
         glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+        mem_track(MEM_GPU, -(int64_t)(worker_ibo_bytes(worker) +
+                                      worker_vbo_bytes(worker)));
+    }
+    worker->vertex_buf = NULL;
+    worker->index_buf = NULL;
+    loader->mapped_count--;
+}
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+bool loader_upload(loader_t* loader, model_t* model, camera_t* camera) {
+    if (loader_get_state(loader) != LOADER_CHUNKS) {
+        return false;
+    }
 
-        model->vbo = loader->vbo;
-        model->ibo = loader->ibo;
-        model->tri_count = loader->tri_count;
+    /*  Chunks are handled in order, so the model tends to fill in from
+     *  the start of the file */
+    if (!loader->staging_checked) {
+        loader->staging = loader->options.staging ? staging_new() : NULL;
+        loader->staging_checked = true;
+    }
+    bool changed = false;
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        worker_t* const worker = &loader->workers[i];
+        switch (__atomic_load_n(&worker->state, __ATOMIC_ACQUIRE)) {
+            case WORKER_READY:
+                if (loader->mapped_count < LOADER_MAX_MAPPED) {
+                    loader_map_chunk(loader, worker);
+                }
+                break;
+            case WORKER_COPIED: {
+                const bool in_ram = !worker->vbo && !worker->staged;
+                void* const vertex_data = in_ram ? worker->vertex_buf : NULL;
+                void* const index_data = in_ram ? worker->index_buf : NULL;
+                loader_unmap_chunk(loader, worker);
+                worker->chunk = model->chunk_count;
+                model_add_chunk(model, worker->vbo, worker->ibo,
+                                worker->tri_count, worker->index_type,
+                                worker->clusters, worker->cluster_count,
+                                worker->quantized, worker->lattice_min,
+                                worker->lattice_max, worker->min, worker->max);
+                if (vertex_data) {
+                    model_set_data(model, worker->chunk,
+                                   vertex_data, worker_vbo_bytes(worker),
+                                   index_data, worker_ibo_bytes(worker));
+                }
+                worker->vbo = 0;
+                worker->ibo = 0;
+                worker->state = WORKER_UPLOADED;
+                for (unsigned j=0; j < 3; ++j) {
+                    loader->min[j] = fminf(loader->min[j], worker->min[j]);
+                    loader->max[j] = fmaxf(loader->max[j], worker->max[j]);
+                }
+                changed = true;
+
+                platform_mutex_lock(loader->mutex);
+                if (loader->uploaded_count++ == 0) {
+                    loader->report.time_first_chunk =
+                        platform_get_time() - loader->start_time;
+                }
+                platform_cond_broadcast(loader->cond);
+                platform_mutex_unlock(loader->mutex);
+                break;
+            }
+            case WORKER_DEDUP:
+            case WORKER_MAPPED:
+            case WORKER_UPLOADED:
+                break;
+        }
+    }
 
-        camera_set_model(camera, (float*)&loader->center, loader->scale);
-        log_trace("Copied model from loader");
-    } else {
-        log_error("Loading failed");
+    /*  Fit the camera to the chunks loaded so far */
+    if (changed) {
+        vec3_t center;
+        float scale = 0.0f;
+        for (unsigned j=0; j < 3; ++j) {
+            center.v[j] = (loader->max[j] + loader->min[j]) / 2.0f;
+            const float d = loader->max[j] - loader->min[j];
+            if (d > scale) {
+                scale = d;
+            }
+        }
+        camera_set_model(camera, (float*)&center, scale);
     }
+    return changed;
 }
 
 void loader_delete(loader_t* loader) {
     if (platform_thread_join(loader->thread)) {
         log_error_and_abort("Failed to join loader thread");
     }
+    pool_group_delete(loader->group);
+
+    /*  Release buffers that were never handed to the model, which
+     *  happens if the load was cancelled after they were allocated */
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        worker_t* const worker = &loader->workers[i];
+        if (worker->staged) {
+            worker->vertex_buf = NULL;
+            worker->index_buf = NULL;
+        } else if (!worker->vbo) {
+            mem_free(worker->vertex_buf);
+            mem_free(worker->index_buf);
+            worker->vertex_buf = NULL;
+            worker->index_buf = NULL;
+        } else if (worker->vertex_buf) {
+            loader_unmap_chunk(loader, worker);
+        }
+        if (worker->vbo) {
+            glDeleteBuffers(1, &worker->vbo);
+            glDeleteBuffers(1, &worker->ibo);
+        }
+        edges_free(&worker->edges);
+        lod_free(&worker->lod);
+        worker_free_clusters(worker);
+    }
+    OBJECT_DELETE_MEMBER(loader, staging);
+    mem_free(loader->workers);
     platform_mutex_delete(loader->mutex);
     platform_cond_delete(loader->cond);
     platform_thread_delete(loader->thread);
+    mem_free(loader->report.workers);
+    free(loader->filename);
     free(loader);
     log_trace("Destroyed loader");
 }
 
+void loader_finish(loader_t* loader, model_t* model) {
+    if (loader_get_state(loader) != LOADER_DONE) {
+        return;
+    }
+    for (unsigned i=0; i < loader->worker_count; ++i) {
+        const worker_t* const worker = &loader->workers[i];
+        model_set_lines(model, worker->chunk, worker->edges.lines,
+                        worker->edges.line_count);
+        model_set_lods(model, worker->chunk, worker->lod.levels,
+                       worker->lod.level_count, worker->lod.tris,
+                       worker->lod.index_count);
+    }
+    const report_t* const report = &loader->report;
+    if (!report->flaw_count && report->volume != 0.0) {
+        model->orientation = (report->volume > 0.0) ? 1 : -1;
+    }
+}
+
 const char* loader_error_string(loader_t* loader) {
     switch(loader->state) {
         case LOADER_START:
-        case LOADER_MODEL_SIZE:
-        case LOADER_GPU_BUFFER:
-        case LOADER_WORKER_GPU:
+        case LOADER_CHUNKS:
             return "Invalid state";
         case LOADER_DONE:
             return NULL;
@@ -391,14 +875,29 @@ const char* loader_error_string(loader_t* loader) {
             return "Failed to parse ASCII stl";
         case LOADER_ERROR_WRONG_SIZE:
             return "File size does not match triangle count";
+        case LOADER_ERROR_CANCELLED:
+            return "Load cancelled";
     }
     log_error_and_abort("Invalid state %i", loader->state);
     return NULL;
 }
 
-void loader_increment_count(loader_t* loader) {
+const report_t* loader_get_report(loader_t* loader) {
     platform_mutex_lock(loader->mutex);
-    loader->count++;
+    const bool done = (loader->state == LOADER_DONE);
+    platform_mutex_unlock(loader->mutex);
+    return done ? &loader->report : NULL;
+}
+
+void loader_cancel(loader_t* loader) {
+    platform_mutex_lock(loader->mutex);
+    __atomic_store_n(&loader->cancelled, true, __ATOMIC_RELEASE);
     platform_cond_broadcast(loader->cond);
     platform_mutex_unlock(loader->mutex);
+
+    pool_group_cancel(loader->group);
+}
+
+void loader_set_priority(loader_t* loader, int priority) {
+    pool_group_set_priority(loader->group, priority);
 }
@@ -0,0 +1,420 @@
+#include "arena.h"
+#include "lod.h"
+#include "mem.h"
+
+/*  Vertices with more triangles than this are locked, which bounds the
+ *  work of checking their edges */
+#define LOD_MAX_VALENCE 32
+
+/*  Collapses are bucketed by the top bits of their (non-negative) cost,
+ *  which orders them by exponent and the first few bits of mantissa */
+#define LOD_SORT_SHIFT 20
+#define LOD_SORT_BUCKETS (1 << (32 - LOD_SORT_SHIFT - 1))
+
+/*  The area-weighted sum of squared distances from a point p to a set
+ *  of planes is p'Ap + 2b'p + c, where A is symmetric (so only six values
+ *  are kept).  w is the total weight, which normalizes the error. */
+typedef struct lod_quadric_ {
+    float a[6];     /* xx, xy, xz, yy, yz, zz */
+    float b[3];
+    float c;
+    float w;
+} lod_quadric_t;
+
+/*  Moving a vertex onto its neighbour, which removes the triangles that
+ *  they share */
+typedef struct lod_collapse_ {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+} lod_collapse_t;
+
+/*  Mesh being simplified, along with scratch data for each pass */
+typedef struct lod_mesh_ {
+    float (*pos)[3];            /* Normalized to the unit cube */
+    lod_quadric_t* quadrics;
+    bool* locked;
+    size_t vert_count;
+
+    uint32_t* tris;
+    size_t tri_count;
+
+    /*  Vertex v's triangles are adj[offset[v]] to adj[offset[v + 1] - 1] */
+    uint32_t* offset;
+    uint32_t* cursor;
+    uint32_t* adj;
+
+    lod_collapse_t* collapses[2];
+    uint32_t* remap;
+    bool* touched;
+
+    /*  Largest collapse cost so far, which is a mean squared distance */
+    float cost;
+} lod_mesh_t;
+
+static void lod_normal(const float a[3], const float b[3], const float c[3],
+                       float n[3])
+{
+    float u[3], v[3];
+    for (unsigned j=0; j < 3; ++j) {
+        u[j] = b[j] - a[j];
+        v[j] = c[j] - a[j];
+    }
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+static void lod_quadric_plane(lod_quadric_t* q, const float n[3], float d,
+                              float w)
+{
+    q->a[0] += w * n[0] * n[0];
+    q->a[1] += w * n[0] * n[1];
+    q->a[2] += w * n[0] * n[2];
+    q->a[3] += w * n[1] * n[1];
+    q->a[4] += w * n[1] * n[2];
+    q->a[5] += w * n[2] * n[2];
+    for (unsigned j=0; j < 3; ++j) {
+        q->b[j] += w * d * n[j];
+    }
+    q->c += w * d * d;
+    q->w += w;
+}
+
+static void lod_quadric_add(lod_quadric_t* q, const lod_quadric_t* r) {
+    for (unsigned j=0; j < 6; ++j) {
+        q->a[j] += r->a[j];
+    }
+    for (unsigned j=0; j < 3; ++j) {
+        q->b[j] += r->b[j];
+    }
+    q->c += r->c;
+    q->w += r->w;
+}
+
+/*  Evaluates the sum of two quadrics at p, as a mean squared distance */
+static float lod_quadric_error(const lod_quadric_t* q, const lod_quadric_t* r,
+                               const float p[3])
+{
+    float a[6], b[3];
+    for (unsigned j=0; j < 6; ++j) {
+        a[j] = q->a[j] + r->a[j];
+    }
+    for (unsigned j=0; j < 3; ++j) {
+        b[j] = q->b[j] + r->b[j];
+    }
+    const float x = p[0], y = p[1], z = p[2];
+    const float e = a[0]*x*x + a[3]*y*y + a[5]*z*z
+                  + 2.0f * (a[1]*x*y + a[2]*x*z + a[4]*y*z)
+                  + 2.0f * (b[0]*x + b[1]*y + b[2]*z) + q->c + r->c;
+    const float w = q->w + r->w;
+    return (w > 0.0f) ? fabsf(e) / w : 0.0f;
+}
+
+/*  Builds the list of triangles around each vertex */
+static void lod_adjacency(lod_mesh_t* mesh) {
+    const size_t index_count = 3 * mesh->tri_count;
+    memset(mesh->offset, 0, sizeof(uint32_t) * (mesh->vert_count + 1));
+    for (size_t i=0; i < index_count; ++i) {
+        mesh->offset[mesh->tris[i] + 1]++;
+    }
+    for (size_t v=1; v <= mesh->vert_count; ++v) {
+        mesh->offset[v] += mesh->offset[v - 1];
+    }
+    memcpy(mesh->cursor, mesh->offset, sizeof(uint32_t) * mesh->vert_count);
+    for (size_t i=0; i < index_count; ++i) {
+        mesh->adj[mesh->cursor[mesh->tris[i]]++] = i / 3;
+    }
+}
+
+/*  Locks vertices on any edge that isn't shared by exactly two triangles,
+ *  which includes every edge on the chunk's border */
+static void lod_lock(lod_mesh_t* mesh) {
+    uint32_t ring[2 * LOD_MAX_VALENCE];
+    for (size_t v=0; v < mesh->vert_count; ++v) {
+        const uint32_t start = mesh->offset[v];
+        const uint32_t end = mesh->offset[v + 1];
+        if (end - start > LOD_MAX_VALENCE) {
+            mesh->locked[v] = true;
+            continue;
+        }
+        unsigned n = 0;
+        for (uint32_t j=start; j < end; ++j) {
+            const uint32_t* t = &mesh->tris[3 * mesh->adj[j]];
+            for (unsigned k=0; k < 3; ++k) {
+                if (t[k] != v) {
+                    ring[n++] = t[k];
+                }
+            }
+        }
+        for (unsigned i=0; i < n && !mesh->locked[v]; ++i) {
+            unsigned count = 0;
+            for (unsigned j=0; j < n; ++j) {
+                count += (ring[j] == ring[i]);
+            }
+            mesh->locked[v] = (count != 2);
+        }
+    }
+}
+
+/*  Checks whether moving from onto to would flip any of the triangles
+ *  that remain around from */
+static bool lod_flips(const lod_mesh_t* mesh, uint32_t from, uint32_t to) {
+    for (uint32_t j=mesh->offset[from]; j < mesh->offset[from + 1]; ++j) {
+        const uint32_t* t = &mesh->tris[3 * mesh->adj[j]];
+        if (t[0] == to || t[1] == to || t[2] == to) {
+            continue;
+        }
+        const unsigned k = (t[0] == from) ? 0 : (t[1] == from) ? 1 : 2;
+        const float* b = mesh->pos[t[(k + 1) % 3]];
+        const float* c = mesh->pos[t[(k + 2) % 3]];
+        float n0[3], n1[3];
+        lod_normal(mesh->pos[from], b, c, n0);
+        lod_normal(mesh->pos[to], b, c, n1);
+        if (n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2] <= 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*  Runs one pass of edge collapses, cheapest first, stopping after goal
+ *  collapses.  Vertices around each collapse aren't touched again in the
+ *  same pass, so every collapse sees its neighbourhood as it was checked.
+ *  Returns the number of collapses. */
+static size_t lod_pass(lod_mesh_t* mesh, size_t goal) {
+    lod_adjacency(mesh);
+
+    /*  Each interior edge appears once with a < b, in whichever direction
+     *  costs less (where locked vertices can't move) */
+    size_t n = 0;
+    lod_collapse_t* const in = mesh->collapses[0];
+    for (size_t i=0; i < 3 * mesh->tri_count; ++i) {
+        const uint32_t a = mesh->tris[i];
+        const uint32_t b = mesh->tris[(i % 3 == 2) ? i - 2 : i + 1];
+        if (a > b || (mesh->locked[a] && mesh->locked[b])) {
+            continue;
+        }
+        const lod_quadric_t* qa = &mesh->quadrics[a];
+        const lod_quadric_t* qb = &mesh->quadrics[b];
+        const float ab = mesh->locked[a] ? INFINITY
+                       : lod_quadric_error(qa, qb, mesh->pos[b]);
+        const float ba = mesh->locked[b] ? INFINITY
+                       : lod_quadric_error(qa, qb, mesh->pos[a]);
+        in[n++] = (ab <= ba) ? (lod_collapse_t){a, b, ab}
+                             : (lod_collapse_t){b, a, ba};
+    }
+
+    uint32_t count[LOD_SORT_BUCKETS] = {0};
+    for (size_t i=0; i < n; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &in[i].cost, sizeof(bits));
+        count[bits >> LOD_SORT_SHIFT]++;
+    }
+    uint32_t sum = 0;
+    for (uint32_t i=0; i < LOD_SORT_BUCKETS; ++i) {
+        const uint32_t c = count[i];
+        count[i] = sum;
+        sum += c;
+    }
+    lod_collapse_t* const sorted = mesh->collapses[1];
+    for (size_t i=0; i < n; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &in[i].cost, sizeof(bits));
+        sorted[count[bits >> LOD_SORT_SHIFT]++] = in[i];
+    }
+
+    memset(mesh->touched, 0, sizeof(bool) * mesh->vert_count);
+    size_t done = 0;
+    for (size_t i=0; i < n && done < goal; ++i) {
+        const lod_collapse_t* c = &sorted[i];
+        if (mesh->touched[c->from] || mesh->touched[c->to] ||
+            lod_flips(mesh, c->from, c->to))
+        {
+            continue;
+        }
+        mesh->remap[c->from] = c->to;
+        lod_quadric_add(&mesh->quadrics[c->to], &mesh->quadrics[c->from]);
+        mesh->cost = fmaxf(mesh->cost, c->cost);
+        for (uint32_t j=mesh->offset[c->from];
+             j < mesh->offset[c->from + 1]; ++j)
+        {
+            const uint32_t* t = &mesh->tris[3 * mesh->adj[j]];
+            for (unsigned k=0; k < 3; ++k) {
+                mesh->touched[t[k]] = true;
+            }
+        }
+        done++;
+    }
+
+    /*  Apply the collapses, dropping triangles which are now degenerate.
+     *  Collapsed vertices are never used again, so remap isn't reset. */
+    size_t m = 0;
+    for (size_t t=0; t < mesh->tri_count; ++t) {
+        const uint32_t a = mesh->remap[mesh->tris[t * 3]];
+        const uint32_t b = mesh->remap[mesh->tris[t * 3 + 1]];
+        const uint32_t c = mesh->remap[mesh->tris[t * 3 + 2]];
+        if (a != b && b != c && a != c) {
+            mesh->tris[m * 3] = a;
+            mesh->tris[m * 3 + 1] = b;
+            mesh->tris[m * 3 + 2] = c;
+            m++;
+        }
+    }
+    mesh->tri_count = m;
+    return done;
+}
+
+void lod_build(lod_t* lod, arena_t* arena,
+               const uint32_t* tris, size_t tri_count,
+               const float (*verts)[3], size_t vert_count)
+{
+    memset(lod, 0, sizeof(*lod));
+    if (tri_count / LOD_RATIO < LOD_MIN_TRIS) {
+        return;
+    }
+
+    /*  Work in the unit cube, so that costs are comparable between chunks
+     *  and well within float precision */
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t v=0; v < vert_count; ++v) {
+        for (unsigned j=0; j < 3; ++j) {
+            if (!isfinite(verts[v][j])) {
+                return;
+            }
+            lo[j] = fminf(lo[j], verts[v][j]);
+            hi[j] = fmaxf(hi[j], verts[v][j]);
+        }
+    }
+    float extent = 0.0f;
+    for (unsigned j=0; j < 3; ++j) {
+        extent = fmaxf(extent, hi[j] - lo[j]);
+    }
+    if (!(extent > 0.0f) || !isfinite(extent)) {
+        return;
+    }
+
+    lod_mesh_t mesh = {0};
+    mesh.vert_count = vert_count;
+    mesh.pos = (float(*)[3])arena_alloc(
+            arena, MEM_WORKER, sizeof(float) * 3 * vert_count);
+    for (size_t v=0; v < vert_count; ++v) {
+        for (unsigned j=0; j < 3; ++j) {
+            mesh.pos[v][j] = (verts[v][j] - lo[j]) / extent;
+        }
+    }
+
+    /*  Degenerate triangles are invisible, so they're dropped up front */
+    mesh.tris = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * tri_count);
+    for (size_t t=0; t < tri_count; ++t) {
+        const uint32_t* s = &tris[t * 3];
+        if (s[0] != s[1] && s[1] != s[2] && s[0] != s[2]) {
+            memcpy(&mesh.tris[mesh.tri_count++ * 3], s,
+                   sizeof(uint32_t) * 3);
+        }
+    }
+
+    mesh.offset = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    mesh.cursor = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * vert_count);
+    mesh.adj = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * tri_count);
+    for (unsigned i=0; i < 2; ++i) {
+        mesh.collapses[i] = (lod_collapse_t*)arena_alloc(
+                arena, MEM_WORKER, sizeof(lod_collapse_t) * 3 * tri_count);
+    }
+    mesh.remap = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * vert_count);
+    for (size_t v=0; v < vert_count; ++v) {
+        mesh.remap[v] = v;
+    }
+    mesh.touched = (bool*)arena_alloc(
+            arena, MEM_WORKER, sizeof(bool) * vert_count);
+    mesh.locked = (bool*)arena_calloc(
+            arena, MEM_WORKER, sizeof(bool) * vert_count);
+    lod_adjacency(&mesh);
+    lod_lock(&mesh);
+
+    /*  If most vertices are locked (e.g. in a chunk whose triangles are
+     *  scattered through the model), even the first level can't reach
+     *  its target, so don't bother */
+    size_t locked_count = 0;
+    for (size_t v=0; v < vert_count; ++v) {
+        locked_count += mesh.locked[v];
+    }
+    if (2 * locked_count > vert_count) {
+        return;
+    }
+
+    /*  Every vertex starts with the planes of its own triangles, weighted
+     *  by their areas */
+    mesh.quadrics = (lod_quadric_t*)arena_calloc(
+            arena, MEM_WORKER, sizeof(lod_quadric_t) * vert_count);
+    for (size_t t=0; t < mesh.tri_count; ++t) {
+        const uint32_t* s = &mesh.tris[t * 3];
+        float n[3];
+        lod_normal(mesh.pos[s[0]], mesh.pos[s[1]], mesh.pos[s[2]], n);
+        const float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (!(len > 0.0f) || !isfinite(len)) {
+            continue;
+        }
+        for (unsigned j=0; j < 3; ++j) {
+            n[j] /= len;
+        }
+        const float* p = mesh.pos[s[0]];
+        const float d = -(n[0]*p[0] + n[1]*p[1] + n[2]*p[2]);
+        for (unsigned k=0; k < 3; ++k) {
+            lod_quadric_plane(&mesh.quadrics[s[k]], n, d, len / 2.0f);
+        }
+    }
+
+    /*  Each level continues simplifying the previous one, so errors only
+     *  grow from level to level.  Levels are collected in the arena, then
+     *  copied out once their total size is known. */
+    size_t out_size = 3 * tri_count / 2;
+    uint32_t* out = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * out_size);
+    size_t prev = mesh.tri_count;
+    while (lod->level_count < MODEL_MAX_LODS) {
+        const size_t target = prev / LOD_RATIO;
+        if (target < LOD_MIN_TRIS) {
+            break;
+        }
+        while (mesh.tri_count > target &&
+               lod_pass(&mesh, (mesh.tri_count - target) / 2 + 1));
+
+        /*  Stop once simplification stalls (e.g. on locked vertices) */
+        if (mesh.tri_count * 4 > prev * 3) {
+            break;
+        }
+        const size_t count = 3 * mesh.tri_count;
+        if (lod->index_count + count > out_size) {
+            out = (uint32_t*)arena_grow(
+                    arena, MEM_WORKER, out, sizeof(uint32_t) * out_size,
+                    sizeof(uint32_t) * 2 * (lod->index_count + count));
+            out_size = 2 * (lod->index_count + count);
+        }
+        memcpy(&out[lod->index_count], mesh.tris, sizeof(uint32_t) * count);
+        lod->levels[lod->level_count++] = (model_lod_t){
+            .first = lod->index_count, .count = count,
+            .error = sqrtf(mesh.cost) * extent};
+        lod->index_count += count;
+        prev = mesh.tri_count;
+    }
+
+    if (lod->index_count) {
+        lod->tris = (uint32_t*)mem_malloc(
+                MEM_LOD, sizeof(uint32_t) * lod->index_count);
+        memcpy(lod->tris, out, sizeof(uint32_t) * lod->index_count);
+    }
+}
+
+void lod_free(lod_t* lod) {
+    mem_free(lod->tris);
+    lod->tris = NULL;
+    lod->index_count = 0;
+    lod->level_count = 0;
+}
@@ -1,12 +1,19 @@
 #include "app.h"
+#include "arena.h"
 #include "instance.h"
 #include "theme.h"
 #include "log.h"
+#include "options.h"
 #include "platform.h"
+#include "pool.h"
+#include "scheduler.h"
+#include "simd.h"
 #include "window.h"
 
 int main(int argc, char** argv) {
     log_init();
+    arena_init();
+    simd_init();
     log_info("Startup!");
     app_t app = {
         .instances=NULL,
@@ -16,8 +23,15 @@ int main(int argc, char** argv) {
         .draw_mode=DRAW_SHADED,
         .deferred_count=0,
         .deferred_files=NULL,
+        .pool=NULL,
+        .open_count=0,
+        .scheduler=NULL,
+        .animating=false,
     };
+    options_read(&app.options);
     app.theme = theme_new_solarized();
+    app.pool = pool_new(platform_get_cpu_count());
+    app.scheduler = scheduler_new();
 
     if (argc != 2) {
         log_info("No input file");
@@ -30,8 +44,10 @@ int main(int argc, char** argv) {
     platform_init(&app, argc, argv);
 
     while (app_run(&app)) {
-        glfwWaitEvents();
+        app_wait(&app);
     }
+    pool_delete(app.pool);
+    scheduler_delete(app.scheduler);
 
     log_deinit();
     return 0;
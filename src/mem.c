@@ -0,0 +1,106 @@
+#include "mem.h"
+
+/*  Every tracked allocation is preceded by a header recording its size
+ *  and subsystem, so that mem_free doesn't need to be told either.
+ *  The header is padded to preserve malloc's alignment guarantees. */
+typedef union mem_header_ {
+    struct {
+        size_t size;
+        mem_subsystem_t subsystem;
+    } h;
+    long double align_ld;
+    int64_t align_i;
+    void* align_p;
+} mem_header_t;
+
+static size_t mem_current[MEM_SUBSYSTEM_COUNT];
+static size_t mem_peak[MEM_SUBSYSTEM_COUNT];
+static size_t mem_total;
+static size_t mem_total_peak;
+
+/*  Atomically raises *peak to at least v */
+static void mem_update_peak(size_t* peak, size_t v) {
+    size_t prev = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (v > prev && !__atomic_compare_exchange_n(
+                peak, &prev, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void mem_track(mem_subsystem_t s, int64_t delta) {
+    const size_t c = __atomic_add_fetch(&mem_current[s], (size_t)delta,
+                                        __ATOMIC_RELAXED);
+    const size_t t = __atomic_add_fetch(&mem_total, (size_t)delta,
+                                        __ATOMIC_RELAXED);
+    if (delta > 0) {
+        mem_update_peak(&mem_peak[s], c);
+        mem_update_peak(&mem_total_peak, t);
+    }
+}
+
+void* mem_malloc(mem_subsystem_t s, size_t bytes) {
+    mem_header_t* h = (mem_header_t*)malloc(sizeof(mem_header_t) + bytes);
+    if (!h) {
+        return NULL;
+    }
+    h->h.size = bytes;
+    h->h.subsystem = s;
+    mem_track(s, bytes);
+    return h + 1;
+}
+
+void* mem_calloc(mem_subsystem_t s, size_t count, size_t size) {
+    const size_t bytes = count * size;
+    mem_header_t* h = (mem_header_t*)calloc(1, sizeof(mem_header_t) + bytes);
+    if (!h) {
+        return NULL;
+    }
+    h->h.size = bytes;
+    h->h.subsystem = s;
+    mem_track(s, bytes);
+    return h + 1;
+}
+
+void* mem_realloc(void* ptr, size_t bytes) {
+    mem_header_t* h = (mem_header_t*)ptr - 1;
+    const size_t prev = h->h.size;
+    h = (mem_header_t*)realloc(h, sizeof(mem_header_t) + bytes);
+    if (!h) {
+        return NULL;
+    }
+    h->h.size = bytes;
+    mem_track(h->h.subsystem, (int64_t)bytes - (int64_t)prev);
+    return h + 1;
+}
+
+void mem_free(void* ptr) {
+    if (ptr) {
+        mem_header_t* h = (mem_header_t*)ptr - 1;
+        mem_track(h->h.subsystem, -(int64_t)h->h.size);
+        free(h);
+    }
+}
+
+void mem_get_stats(mem_stats_t* stats) {
+    for (unsigned i=0; i < MEM_SUBSYSTEM_COUNT; ++i) {
+        stats->current[i] = __atomic_load_n(&mem_current[i], __ATOMIC_RELAXED);
+        stats->peak[i] = __atomic_load_n(&mem_peak[i], __ATOMIC_RELAXED);
+    }
+    stats->total = __atomic_load_n(&mem_total, __ATOMIC_RELAXED);
+    stats->total_peak = __atomic_load_n(&mem_total_peak, __ATOMIC_RELAXED);
+}
+
+const char* mem_subsystem_name(mem_subsystem_t s) {
+    switch (s) {
+        case MEM_LOADER:    return "loader";
+        case MEM_WORKER:    return "worker";
+        case MEM_VSET:      return "vset";
+        case MEM_EDGES:     return "edges";
+        case MEM_LOD:       return "lod";
+        case MEM_RESIDENT:  return "resident";
+        case MEM_ICOSPHERE: return "icosphere";
+        case MEM_FILE:      return "file";
+        case MEM_GPU:       return "gpu";
+        case MEM_ARENA:     return "arena";
+        case MEM_SUBSYSTEM_COUNT: break;
+    }
+    return "unknown";
+}
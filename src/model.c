@@ -1,22 +1,337 @@
 #include "camera.h"
 #include "log.h"
+#include "mem.h"
 #include "model.h"
 #include "object.h"
 #include "theme.h"
 
-model_t* model_new() {
+model_t* model_new(const options_t* options) {
     OBJECT_ALLOC(model);
+    model->options = *options;
     model->tri_count = 0;
-    model->vbo = 0;
-    model->ibo = 0;
-    glGenVertexArrays(1, &model->vao);
+    model->orientation = 0;
+    model->chunks = NULL;
+    model->chunk_count = 0;
+    model->chunks_size = 0;
+    model->streamed_count = 0;
+    model->resident_bytes = 0;
+    model->budget = 0;
+    model->budget_time = 0;
+    model->frame = 0;
+    model->lru_head = MODEL_NO_CHUNK;
+    model->lru_tail = MODEL_NO_CHUNK;
     log_trace("Initialized model");
     return model;
 }
 
 void model_delete(model_t* model) {
-    glDeleteBuffers(1, &model->vbo);
-    glDeleteBuffers(1, &model->ibo);
-    glDeleteVertexArrays(1, &model->vbo);
+    for (unsigned i=0; i < model->chunk_count; ++i) {
+        model_chunk_t* chunk = &model->chunks[i];
+        glDeleteBuffers(1, &chunk->vbo);
+        glDeleteBuffers(1, &chunk->ibo);
+        glDeleteVertexArrays(1, &chunk->vao);
+        glDeleteTextures(1, &chunk->vert_tex);
+        glDeleteTextures(1, &chunk->tri_tex);
+        glDeleteBuffers(1, &chunk->lbo);
+        glDeleteVertexArrays(1, &chunk->line_vao);
+        glDeleteBuffers(1, &chunk->cluster_buf);
+        glDeleteBuffers(1, &chunk->command_buf);
+        glDeleteBuffers(1, &chunk->lod_ibo);
+        glDeleteVertexArrays(1, &chunk->lod_vao);
+        mem_free(chunk->vertex_data);
+        mem_free(chunk->index_data);
+        free(chunk->clusters);
+    }
+    free(model->chunks);
     free(model);
 }
+
+/*  Sets up vertex attribute 0 to read the chunk's positions, with the
+ *  chunk's vbo bound */
+static void model_chunk_attrib(const model_chunk_t* chunk) {
+    glEnableVertexAttribArray(0);
+    if (chunk->quantized) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                              3 * sizeof(uint16_t), 0);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    }
+}
+
+/*  Builds the vao and buffer textures over a chunk's vbo and ibo, and
+ *  points its line and LOD vaos (if present) at the vbo */
+static void model_chunk_bind(model_chunk_t* chunk) {
+    glGenVertexArrays(1, &chunk->vao);
+    glBindVertexArray(chunk->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->ibo);
+    model_chunk_attrib(chunk);
+    glBindVertexArray(0);
+
+    /*  Three-channel buffer textures need OpenGL 4.0, so positions are
+     *  viewed as individual values (which are normalized to [0, 1] when
+     *  quantized, matching the vertex attribute) */
+    glGenTextures(1, &chunk->vert_tex);
+    glBindTexture(GL_TEXTURE_BUFFER, chunk->vert_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, chunk->quantized ? GL_R16 : GL_R32F,
+                chunk->vbo);
+    glGenTextures(1, &chunk->tri_tex);
+    glBindTexture(GL_TEXTURE_BUFFER, chunk->tri_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER,
+                chunk->index_type == GL_UNSIGNED_SHORT ? GL_R16UI : GL_R32UI,
+                chunk->ibo);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    const GLuint vaos[2] = {chunk->line_vao, chunk->lod_vao};
+    for (unsigned i=0; i < 2; ++i) {
+        if (vaos[i]) {
+            glBindVertexArray(vaos[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+            model_chunk_attrib(chunk);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void model_add_chunk(model_t* model, GLuint vbo, GLuint ibo,
+                     uint32_t tri_count, GLenum index_type,
+                     const model_cluster_t* clusters, unsigned cluster_count,
+                     bool quantized, const float lattice_min[3],
+                     const float lattice_max[3],
+                     const float min[3], const float max[3])
+{
+    if (model->chunk_count == model->chunks_size) {
+        if (model->chunks_size) {
+            model->chunks_size *= 2;
+        } else {
+            model->chunks_size = 1;
+        }
+        model->chunks = (model_chunk_t*)realloc(
+                model->chunks, sizeof(model_chunk_t) * model->chunks_size);
+    }
+    model_chunk_t* chunk = &model->chunks[model->chunk_count++];
+    chunk->tri_count = tri_count;
+    chunk->vbo = vbo;
+    chunk->ibo = ibo;
+    chunk->index_type = index_type;
+    chunk->clusters = (model_cluster_t*)malloc(
+            sizeof(model_cluster_t) * cluster_count);
+    memcpy(chunk->clusters, clusters,
+           sizeof(model_cluster_t) * cluster_count);
+    chunk->cluster_count = cluster_count;
+    chunk->cluster_buf = 0;
+    chunk->command_buf = 0;
+    chunk->line_count = 0;
+    chunk->line_vao = 0;
+    chunk->lbo = 0;
+    chunk->lod_count = 0;
+    chunk->lod_type = GL_UNSIGNED_INT;
+    chunk->lod_vao = 0;
+    chunk->lod_ibo = 0;
+    chunk->lod_bytes = 0;
+    chunk->quantized = quantized;
+    for (unsigned j=0; j < 3; ++j) {
+        chunk->offset[j] = quantized ? lattice_min[j] : 0.0f;
+        chunk->scale[j] = quantized ? (lattice_max[j] - lattice_min[j])
+                                    : 1.0f;
+    }
+
+    /*  Empty chunks (or those with non-finite bounds) are never culled */
+    float r2 = 0.0f;
+    for (unsigned j=0; j < 3; ++j) {
+        chunk->center[j] = (min[j] + max[j]) / 2.0f;
+        r2 += (max[j] - min[j]) * (max[j] - min[j]) / 4.0f;
+    }
+    chunk->radius = sqrtf(r2);
+    if (!isfinite(chunk->radius) || !isfinite(chunk->center[0]) ||
+        !isfinite(chunk->center[1]) || !isfinite(chunk->center[2]))
+    {
+        memset(chunk->center, 0, sizeof(chunk->center));
+        chunk->radius = INFINITY;
+    }
+
+    chunk->vao = 0;
+    chunk->vert_tex = 0;
+    chunk->tri_tex = 0;
+    chunk->vertex_data = NULL;
+    chunk->index_data = NULL;
+    chunk->vbo_bytes = 0;
+    chunk->ibo_bytes = 0;
+    chunk->used = 0;
+    chunk->lru_prev = MODEL_NO_CHUNK;
+    chunk->lru_next = MODEL_NO_CHUNK;
+    if (vbo) {
+        GLint size;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+        chunk->vbo_bytes = size;
+        glBindBuffer(GL_ARRAY_BUFFER, ibo);
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+        chunk->ibo_bytes = size;
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        model->resident_bytes += chunk->vbo_bytes + chunk->ibo_bytes;
+        model_chunk_bind(chunk);
+    }
+
+    model->tri_count += tri_count;
+}
+
+void model_set_lines(model_t* model, unsigned chunk_index,
+                     const uint32_t* lines, uint32_t line_count)
+{
+    model_chunk_t* chunk = &model->chunks[chunk_index];
+    if (!chunk->line_vao) {
+        glGenVertexArrays(1, &chunk->line_vao);
+        glGenBuffers(1, &chunk->lbo);
+    }
+    model->resident_bytes -= sizeof(uint32_t) * 2 * chunk->line_count;
+    model->resident_bytes += sizeof(uint32_t) * 2 * line_count;
+    chunk->line_count = line_count;
+
+    glBindVertexArray(chunk->line_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->lbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(uint32_t) * 2 * line_count, lines, GL_STATIC_DRAW);
+    if (chunk->vbo) {
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+        model_chunk_attrib(chunk);
+    }
+    glBindVertexArray(0);
+}
+
+void model_set_lods(model_t* model, unsigned chunk_index,
+                    const model_lod_t* lods, unsigned lod_count,
+                    const uint32_t* indices, uint32_t index_count)
+{
+    model_chunk_t* chunk = &model->chunks[chunk_index];
+    if (!lod_count) {
+        return;
+    }
+    if (!chunk->lod_vao) {
+        glGenVertexArrays(1, &chunk->lod_vao);
+        glGenBuffers(1, &chunk->lod_ibo);
+    }
+    memcpy(chunk->lods, lods, sizeof(model_lod_t) * lod_count);
+    chunk->lod_count = lod_count;
+
+    uint32_t max = 0;
+    for (uint32_t i=0; i < index_count; ++i) {
+        max = (indices[i] > max) ? indices[i] : max;
+    }
+    glBindVertexArray(chunk->lod_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->lod_ibo);
+    if (max <= UINT16_MAX) {
+        uint16_t* packed = (uint16_t*)malloc(sizeof(uint16_t) * index_count);
+        for (uint32_t i=0; i < index_count; ++i) {
+            packed[i] = indices[i];
+        }
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * index_count,
+                     packed, GL_STATIC_DRAW);
+        free(packed);
+        chunk->lod_type = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * index_count,
+                     indices, GL_STATIC_DRAW);
+        chunk->lod_type = GL_UNSIGNED_INT;
+    }
+    model->resident_bytes -= chunk->lod_bytes;
+    chunk->lod_bytes = index_count * ((chunk->lod_type == GL_UNSIGNED_SHORT)
+        ? sizeof(uint16_t) : sizeof(uint32_t));
+    model->resident_bytes += chunk->lod_bytes;
+    if (chunk->vbo) {
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+        model_chunk_attrib(chunk);
+    }
+    glBindVertexArray(0);
+}
+
+void model_set_data(model_t* model, unsigned chunk_index,
+                    void* vertex_data, size_t vbo_bytes,
+                    void* index_data, size_t ibo_bytes)
+{
+    model_chunk_t* chunk = &model->chunks[chunk_index];
+    chunk->vertex_data = vertex_data;
+    chunk->index_data = index_data;
+    chunk->vbo_bytes = vbo_bytes;
+    chunk->ibo_bytes = ibo_bytes;
+    model->streamed_count++;
+}
+
+bool model_upload_chunk(model_t* model, unsigned chunk_index) {
+    model_chunk_t* chunk = &model->chunks[chunk_index];
+
+    /*  Clear any errors left over from earlier calls, so that an out of
+     *  memory error below is known to come from this upload */
+    while (glGetError() != GL_NO_ERROR);
+
+    glGenBuffers(1, &chunk->vbo);
+    glGenBuffers(1, &chunk->ibo);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glBufferData(GL_ARRAY_BUFFER, chunk->vbo_bytes, chunk->vertex_data,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, chunk->ibo_bytes,
+                 chunk->index_data, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    bool oom = false;
+    GLenum err;
+    while ((err = glGetError()) != GL_NO_ERROR) {
+        oom |= (err == GL_OUT_OF_MEMORY);
+    }
+    if (oom) {
+        glDeleteBuffers(1, &chunk->vbo);
+        glDeleteBuffers(1, &chunk->ibo);
+        chunk->vbo = 0;
+        chunk->ibo = 0;
+        return false;
+    }
+    model_chunk_bind(chunk);
+    model->resident_bytes += chunk->vbo_bytes + chunk->ibo_bytes;
+    return true;
+}
+
+void model_evict_chunk(model_t* model, unsigned chunk_index) {
+    model_chunk_t* chunk = &model->chunks[chunk_index];
+
+    /*  Buffers stay alive while a vao refers to them, so detach the vbo
+     *  from the line and LOD vaos before deleting it */
+    const GLuint vaos[2] = {chunk->line_vao, chunk->lod_vao};
+    for (unsigned i=0; i < 2; ++i) {
+        if (vaos[i]) {
+            glBindVertexArray(vaos[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+            glDisableVertexAttribArray(0);
+        }
+    }
+    glBindVertexArray(0);
+
+    glDeleteTextures(1, &chunk->vert_tex);
+    glDeleteTextures(1, &chunk->tri_tex);
+    glDeleteVertexArrays(1, &chunk->vao);
+    glDeleteBuffers(1, &chunk->vbo);
+    glDeleteBuffers(1, &chunk->ibo);
+    chunk->vert_tex = 0;
+    chunk->tri_tex = 0;
+    chunk->vao = 0;
+    chunk->vbo = 0;
+    chunk->ibo = 0;
+    model->resident_bytes -= chunk->vbo_bytes + chunk->ibo_bytes;
+}
+
+void model_upload_clusters(model_t* model, unsigned chunk_index) {
+    model_chunk_t* chunk = &model->chunks[chunk_index];
+    glGenBuffers(1, &chunk->cluster_buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunk->cluster_buf);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 sizeof(model_cluster_t) * chunk->cluster_count,
+                 chunk->clusters, GL_STATIC_DRAW);
+    glGenBuffers(1, &chunk->command_buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunk->command_buf);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 sizeof(model_command_t) * chunk->cluster_count,
+                 NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    model->resident_bytes += chunk->cluster_count *
+        (sizeof(model_cluster_t) + sizeof(model_command_t));
+}
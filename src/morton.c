@@ -0,0 +1,105 @@
+#include "arena.h"
+#include "mem.h"
+#include "morton.h"
+
+/*  Spreads 10 bits so that there are two zero bits between each of them */
+static uint32_t morton_spread(uint32_t v) {
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8))  & 0x0300F00F;
+    v = (v | (v << 4))  & 0x030C30C3;
+    v = (v | (v << 2))  & 0x09249249;
+    return v;
+}
+
+uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z) {
+    return morton_spread(x) | (morton_spread(y) << 1)
+                            | (morton_spread(z) << 2);
+}
+
+/*  Maps a coordinate to [0, 2^MORTON_BITS), sending NaN to zero */
+static uint32_t morton_quantize(float f, float min, float scale) {
+    const float q = (f - min) * scale;
+    if (!(q >= 0.0f)) {
+        return 0;
+    } else if (q >= (1 << MORTON_BITS) - 1) {
+        return (1 << MORTON_BITS) - 1;
+    }
+    return (uint32_t)q;
+}
+
+/*  Codes are sorted with an LSD radix sort, one axis bit-width per pass */
+#define MORTON_RADIX_BITS MORTON_BITS
+#define MORTON_PASSES 3
+
+void morton_sort(arena_t* arena, uint32_t* tris, size_t tri_count,
+                 const float (*verts)[3],
+                 const float min[3], const float max[3])
+{
+    if (tri_count < 2) {
+        return;
+    }
+
+    /*  Every axis uses the same scale (from the largest extent), so that
+     *  runs of the curve are compact in space rather than stretched along
+     *  the chunk's thinnest axes */
+    float extent = 0.0f;
+    for (unsigned j=0; j < 3; ++j) {
+        extent = fmaxf(extent, max[j] - min[j]);
+    }
+    const float s = (extent > 0.0f && isfinite(extent))
+        ? ((1 << MORTON_BITS) - 1) / extent : 0.0f;
+    const float scale[3] = {s, s, s};
+
+    uint32_t* keys[2];
+    uint32_t* order[2];
+    for (unsigned i=0; i < 2; ++i) {
+        keys[i] = (uint32_t*)arena_alloc(
+                arena, MEM_WORKER, sizeof(uint32_t) * tri_count);
+        order[i] = (uint32_t*)arena_alloc(
+                arena, MEM_WORKER, sizeof(uint32_t) * tri_count);
+    }
+    for (size_t t=0; t < tri_count; ++t) {
+        uint32_t q[3];
+        for (unsigned j=0; j < 3; ++j) {
+            const float c = (verts[tris[t*3]][j] + verts[tris[t*3 + 1]][j]
+                           + verts[tris[t*3 + 2]][j]) / 3.0f;
+            q[j] = morton_quantize(c, min[j], scale[j]);
+        }
+        keys[0][t] = morton_encode(q[0], q[1], q[2]);
+        order[0][t] = t;
+    }
+
+    uint32_t* count = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) << MORTON_RADIX_BITS);
+    const uint32_t mask = (1 << MORTON_RADIX_BITS) - 1;
+    for (unsigned pass=0; pass < MORTON_PASSES; ++pass) {
+        const unsigned shift = pass * MORTON_RADIX_BITS;
+        const uint32_t* const k = keys[pass & 1];
+        const uint32_t* const o = order[pass & 1];
+        memset(count, 0, sizeof(uint32_t) << MORTON_RADIX_BITS);
+        for (size_t t=0; t < tri_count; ++t) {
+            count[(k[t] >> shift) & mask]++;
+        }
+        uint32_t sum = 0;
+        for (uint32_t d=0; d <= mask; ++d) {
+            const uint32_t c = count[d];
+            count[d] = sum;
+            sum += c;
+        }
+        for (size_t t=0; t < tri_count; ++t) {
+            const uint32_t dst = count[(k[t] >> shift) & mask]++;
+            keys[!(pass & 1)][dst] = k[t];
+            order[!(pass & 1)][dst] = o[t];
+        }
+    }
+
+    /*  Gather triangles in sorted order */
+    const uint32_t* const sorted = order[MORTON_PASSES & 1];
+    uint32_t* out = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * tri_count);
+    for (size_t t=0; t < tri_count; ++t) {
+        memcpy(&out[t * 3], &tris[sorted[t] * 3], sizeof(uint32_t) * 3);
+    }
+    memcpy(tris, out, sizeof(uint32_t) * 3 * tri_count);
+}
@@ -0,0 +1,29 @@
+#include "log.h"
+#include "options.h"
+
+static bool options_flag(const char* name) {
+    const char* v = getenv(name);
+    return !v || strcmp(v, "0");
+}
+
+void options_read(options_t* options) {
+    options->vcache = options_flag("ERIZO_VCACHE");
+    options->morton = options_flag("ERIZO_MORTON");
+    options->quantize = options_flag("ERIZO_QUANTIZE");
+    options->cull = options_flag("ERIZO_CULL");
+    options->cull_gpu = options_flag("ERIZO_CULL_GPU");
+    options->lod = options_flag("ERIZO_LOD");
+    options->staging = options_flag("ERIZO_STAGING");
+
+    options->gpu_budget = 0;
+    const char* v = getenv("ERIZO_GPU_BUDGET");
+    if (v) {
+        char* end;
+        const unsigned long long mb = strtoull(v, &end, 10);
+        if (*v && !*end) {
+            options->gpu_budget = (size_t)mb << 20;
+        } else {
+            log_warn("Invalid ERIZO_GPU_BUDGET=%s, using no budget", v);
+        }
+    }
+}
@@ -0,0 +1,239 @@
+#include "log.h"
+#include "object.h"
+#include "platform.h"
+#include "pool.h"
+
+typedef struct pool_task_ {
+    void (*fn)(void*);
+    void* data;
+    pool_group_t* group;
+    struct pool_task_* next;
+} pool_task_t;
+
+struct pool_group_ {
+    pool_t* pool;
+    int priority;
+    bool cancelled;
+    unsigned pending;   /* Queued and running tasks */
+
+    /*  Singly-linked queue of this group's tasks, in submission order
+     *  (except for tasks from pool_submit_front) */
+    pool_task_t* head;
+    pool_task_t* tail;
+
+    /*  Doubly-linked list of every group in the pool, oldest first */
+    struct pool_group_* prev;
+    struct pool_group_* next;
+};
+
+struct pool_ {
+    platform_thread_t** threads;
+    unsigned thread_count;
+
+    /*  Everything below is protected by the mutex */
+    platform_mutex_t* mutex;
+    platform_cond_t* work;      /* Signalled when a task is queued */
+    platform_cond_t* done;      /* Signalled when a group's tasks finish */
+
+    /*  Every group, each with its own queue of tasks */
+    pool_group_t* groups;
+    pool_group_t* last_group;
+
+    bool quit;
+};
+
+/*  Removes and returns the first queued task from the highest-priority
+ *  group (or the oldest such group, if there's a tie), or NULL if no
+ *  tasks are queued.  Must be called with the mutex held.  A load queues
+ *  a task per chunk, so there may be thousands of tasks, but only one
+ *  group per open load, so only the groups are scanned. */
+static pool_task_t* pool_pop(pool_t* pool) {
+    pool_group_t* best = NULL;
+    for (pool_group_t* g = pool->groups; g; g = g->next) {
+        if (g->head && (!best || g->priority > best->priority)) {
+            best = g;
+        }
+    }
+    if (!best) {
+        return NULL;
+    }
+    pool_task_t* task = best->head;
+    best->head = task->next;
+    if (!best->head) {
+        best->tail = NULL;
+    }
+    return task;
+}
+
+static void* pool_run(void* pool_) {
+    pool_t* const pool = (pool_t*)pool_;
+
+    platform_mutex_lock(pool->mutex);
+    while (1) {
+        pool_task_t* task = NULL;
+        while (!pool->quit && !(task = pool_pop(pool))) {
+            platform_cond_wait(pool->work, pool->mutex);
+        }
+        if (!task) {
+            break;
+        }
+
+        platform_mutex_unlock(pool->mutex);
+        task->fn(task->data);
+        platform_mutex_lock(pool->mutex);
+
+        task->group->pending--;
+        platform_cond_broadcast(pool->done);
+        free(task);
+    }
+    platform_mutex_unlock(pool->mutex);
+    return NULL;
+}
+
+pool_t* pool_new(unsigned thread_count) {
+    OBJECT_ALLOC(pool);
+    pool->mutex = platform_mutex_new();
+    pool->work = platform_cond_new();
+    pool->done = platform_cond_new();
+
+    pool->thread_count = thread_count ? thread_count : 1;
+    pool->threads = (platform_thread_t**)calloc(
+            pool->thread_count, sizeof(platform_thread_t*));
+    for (unsigned i=0; i < pool->thread_count; ++i) {
+        pool->threads[i] = platform_thread_new(pool_run, pool);
+    }
+    log_trace("Started thread pool with %u threads", pool->thread_count);
+    return pool;
+}
+
+void pool_delete(pool_t* pool) {
+    platform_mutex_lock(pool->mutex);
+    for (pool_group_t* g = pool->groups; g; g = g->next) {
+        if (g->head) {
+            log_error_and_abort("Deleting thread pool with queued tasks");
+        }
+    }
+    pool->quit = true;
+    platform_cond_broadcast(pool->work);
+    platform_mutex_unlock(pool->mutex);
+
+    for (unsigned i=0; i < pool->thread_count; ++i) {
+        if (platform_thread_join(pool->threads[i])) {
+            log_error_and_abort("Failed to join thread pool thread");
+        }
+        platform_thread_delete(pool->threads[i]);
+    }
+    free(pool->threads);
+    platform_cond_delete(pool->work);
+    platform_cond_delete(pool->done);
+    platform_mutex_delete(pool->mutex);
+    free(pool);
+}
+
+unsigned pool_thread_count(pool_t* pool) {
+    return pool->thread_count;
+}
+
+pool_group_t* pool_group_new(pool_t* pool) {
+    OBJECT_ALLOC(pool_group);
+    pool_group->pool = pool;
+
+    platform_mutex_lock(pool->mutex);
+    pool_group->prev = pool->last_group;
+    if (pool->last_group) {
+        pool->last_group->next = pool_group;
+    } else {
+        pool->groups = pool_group;
+    }
+    pool->last_group = pool_group;
+    platform_mutex_unlock(pool->mutex);
+    return pool_group;
+}
+
+void pool_group_delete(pool_group_t* group) {
+    if (group->pending) {
+        log_error_and_abort("Deleting thread pool group with pending tasks");
+    }
+    pool_t* const pool = group->pool;
+    platform_mutex_lock(pool->mutex);
+    if (group->prev) {
+        group->prev->next = group->next;
+    } else {
+        pool->groups = group->next;
+    }
+    if (group->next) {
+        group->next->prev = group->prev;
+    } else {
+        pool->last_group = group->prev;
+    }
+    platform_mutex_unlock(pool->mutex);
+    free(group);
+}
+
+void pool_group_set_priority(pool_group_t* group, int priority) {
+    platform_mutex_lock(group->pool->mutex);
+    group->priority = priority;
+    platform_mutex_unlock(group->pool->mutex);
+}
+
+static void pool_push(pool_group_t* group, void (*fn)(void*), void* data,
+                      bool front)
+{
+    pool_t* const pool = group->pool;
+    platform_mutex_lock(pool->mutex);
+    if (!group->cancelled) {
+        OBJECT_ALLOC(pool_task);
+        pool_task->fn = fn;
+        pool_task->data = data;
+        pool_task->group = group;
+        if (front) {
+            pool_task->next = group->head;
+            group->head = pool_task;
+            if (!group->tail) {
+                group->tail = pool_task;
+            }
+        } else if (group->tail) {
+            group->tail->next = pool_task;
+            group->tail = pool_task;
+        } else {
+            group->head = pool_task;
+            group->tail = pool_task;
+        }
+        group->pending++;
+        platform_cond_broadcast(pool->work);
+    }
+    platform_mutex_unlock(pool->mutex);
+}
+
+void pool_submit(pool_group_t* group, void (*fn)(void*), void* data) {
+    pool_push(group, fn, data, false);
+}
+
+void pool_submit_front(pool_group_t* group, void (*fn)(void*), void* data) {
+    pool_push(group, fn, data, true);
+}
+
+void pool_group_wait(pool_group_t* group) {
+    pool_t* const pool = group->pool;
+    platform_mutex_lock(pool->mutex);
+    while (group->pending) {
+        platform_cond_wait(pool->done, pool->mutex);
+    }
+    platform_mutex_unlock(pool->mutex);
+}
+
+void pool_group_cancel(pool_group_t* group) {
+    pool_t* const pool = group->pool;
+    platform_mutex_lock(pool->mutex);
+    group->cancelled = true;
+
+    while (group->head) {
+        pool_task_t* dropped = group->head;
+        group->head = dropped->next;
+        group->pending--;
+        free(dropped);
+    }
+    group->tail = NULL;
+    platform_cond_broadcast(pool->done);
+    platform_mutex_unlock(pool->mutex);
+}
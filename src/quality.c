@@ -0,0 +1,353 @@
+#include "backdrop.h"
+#include "log.h"
+#include "object.h"
+#include "platform.h"
+#include "quality.h"
+#include "shader.h"
+
+static const GLchar* QUALITY_VS_SRC = GLSL(330,
+layout(location=0) in vec2 pos;
+
+uniform vec2 uv_scale;
+
+out vec2 uv;
+
+void main() {
+    uv = (pos * 0.5f + 0.5f) * uv_scale;
+    gl_Position = vec4(pos, 0.0f, 1.0f);
+}
+);
+
+/*  Samples are clamped to uv_max, the center of the last texel which was
+ *  drawn, since the rest of the texture is left over from other frames */
+static const GLchar* QUALITY_FS_SRC = GLSL(330,
+in vec2 uv;
+
+uniform sampler2D tex;
+uniform vec2 uv_max;
+
+out vec4 out_color;
+
+void main() {
+    out_color = texture(tex, min(uv, uv_max));
+}
+);
+
+/*  Post-process anti-aliasing, based on the FXAA algorithm by Timothy
+ *  Lottes (in its compact form).  Luma at the corners of each pixel gives
+ *  the direction of an edge, which is then blurred along that direction,
+ *  falling back to a shorter blur if the longer one crosses another edge.
+ *  Pixels with low local contrast are passed through unchanged.
+ *  Steps are in texels of the source, so this also works when upscaling. */
+static const GLchar* QUALITY_FXAA_FS_SRC = GLSL(330,
+in vec2 uv;
+
+uniform sampler2D tex;
+uniform vec2 uv_max;
+
+out vec4 out_color;
+
+const float SPAN_MAX = 8.0f;
+const float REDUCE_MUL = 1.0f / 8.0f;
+const float REDUCE_MIN = 1.0f / 128.0f;
+const float EDGE_MIN = 1.0f / 32.0f;
+const float EDGE_SCALE = 1.0f / 8.0f;
+
+vec3 fetch(vec2 p) {
+    return texture(tex, min(p, uv_max)).rgb;
+}
+
+float luma(vec3 c) {
+    return dot(c, vec3(0.299f, 0.587f, 0.114f));
+}
+
+/*  Unfiltered lookups are much cheaper on software renderers */
+float corner(ivec2 p, ivec2 d, ivec2 top) {
+    return luma(texelFetch(tex, clamp(p + d, ivec2(0), top), 0).rgb);
+}
+
+void main() {
+    vec2 size = vec2(textureSize(tex, 0));
+    vec2 texel = 1.0f / size;
+    ivec2 top = ivec2(uv_max * size);
+    ivec2 p = min(ivec2(uv * size), top);
+
+    vec3 m = fetch(uv);
+    float nw = corner(p, ivec2(-1, -1), top);
+    float ne = corner(p, ivec2( 1, -1), top);
+    float sw = corner(p, ivec2(-1,  1), top);
+    float se = corner(p, ivec2( 1,  1), top);
+    float lm = luma(m);
+    float lo = min(lm, min(min(nw, ne), min(sw, se)));
+    float hi = max(lm, max(max(nw, ne), max(sw, se)));
+    if (hi - lo < max(EDGE_MIN, hi * EDGE_SCALE)) {
+        out_color = vec4(m, 1.0f);
+        return;
+    }
+
+    vec2 dir = vec2(-((nw + ne) - (sw + se)), (nw + sw) - (ne + se));
+    float reduce = max((nw + ne + sw + se) * 0.25f * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0f / (min(abs(dir.x), abs(dir.y)) + reduce);
+    dir = clamp(dir * scale, -SPAN_MAX, SPAN_MAX) * texel;
+
+    vec3 a = 0.5f * (fetch(uv + dir * (1.0f / 3.0f - 0.5f)) +
+                     fetch(uv + dir * (2.0f / 3.0f - 0.5f)));
+    vec3 b = 0.5f * a + 0.25f * (fetch(uv - dir * 0.5f) +
+                                 fetch(uv + dir * 0.5f));
+    float lb = luma(b);
+    out_color = vec4((lb < lo || lb > hi) ? a : b, 1.0f);
+}
+);
+
+/*  Range of the resolution scale, and the scale to start from */
+#define QUALITY_MIN_SCALE   0.25f
+#define QUALITY_MAX_SCALE   1.0f
+#define QUALITY_START_SCALE 0.5f
+
+/*  Time after the last input before drawing a full-quality frame */
+#define QUALITY_SETTLE_US   150000
+
+/*  Timing results are read back this many frames after they're drawn
+ *  (see timing.c), which is used to match them to their frames */
+#define QUALITY_RESULT_LAG  2
+
+struct quality_ {
+    quality_aa_t aa;
+    float scale;
+    int64_t last_input;
+
+    /*  Bitmask of recent frames which were drawn at reduced resolution,
+     *  with the latest frame in the lowest bit */
+    unsigned history;
+
+    /*  Reduced frames to skip before adjusting the scale again, so that
+     *  measurements reflect the current scale */
+    unsigned wait;
+
+    /*  GPU time of the most recent full-quality frame, or negative */
+    float full_ms;
+    float target_ms;
+
+    /*  Offscreen framebuffer, sized to the full viewport */
+    GLuint fbo;
+    GLuint color;
+    GLuint depth;
+    GLint fbo_width;
+    GLint fbo_height;
+
+    /*  Framebuffer, viewport and scaled viewport for the frame being drawn,
+     *  so that the original target can be restored in quality_end */
+    bool offscreen;
+    GLint target;
+    GLint viewport[4];
+    GLint scaled[2];
+
+    shader_t shader;
+    GLint u_tex;
+    GLint u_uv_scale;
+    GLint u_uv_max;
+};
+
+/******************************************************************************/
+
+const char* quality_aa_name(quality_aa_t aa) {
+    switch (aa) {
+        case QUALITY_AA_MSAA8:  return "msaa8";
+        case QUALITY_AA_MSAA4:  return "msaa4";
+        case QUALITY_AA_FXAA:   return "fxaa";
+        case QUALITY_AA_NONE:   return "none";
+        case QUALITY_AA_COUNT:  break;
+    }
+    return "unknown";
+}
+
+int quality_aa_samples(quality_aa_t aa) {
+    switch (aa) {
+        case QUALITY_AA_MSAA8:  return 8;
+        case QUALITY_AA_MSAA4:  return 4;
+        case QUALITY_AA_FXAA:
+        case QUALITY_AA_NONE:
+        case QUALITY_AA_COUNT:  break;
+    }
+    return 0;
+}
+
+quality_aa_t quality_aa_get() {
+    /*  Only parsed once, since every window checks it */
+    static quality_aa_t aa = QUALITY_AA_COUNT;
+    if (aa != QUALITY_AA_COUNT) {
+        return aa;
+    }
+
+    aa = QUALITY_AA_MSAA8;
+    const char* requested = getenv("ERIZO_AA");
+    if (requested) {
+        unsigned i;
+        for (i=0; i < QUALITY_AA_COUNT; ++i) {
+            if (!strcmp(requested, quality_aa_name(i))) {
+                aa = i;
+                break;
+            }
+        }
+        if (i == QUALITY_AA_COUNT) {
+            log_warn("Unknown ERIZO_AA=%s, using %s", requested,
+                     quality_aa_name(aa));
+        }
+    }
+    log_trace("Using %s anti-aliasing", quality_aa_name(aa));
+    return aa;
+}
+
+/******************************************************************************/
+
+quality_t* quality_new(quality_aa_t aa) {
+    OBJECT_ALLOC(quality);
+    quality->aa = aa;
+    quality->scale = QUALITY_START_SCALE;
+    quality->full_ms = -1.0f;
+
+    quality->shader = shader_new(
+            QUALITY_VS_SRC, NULL,
+            (aa == QUALITY_AA_FXAA) ? QUALITY_FXAA_FS_SRC : QUALITY_FS_SRC);
+    {   // Make a temporary struct to unpack uniforms
+        GLint prog = quality->shader.prog;
+        struct { GLint tex; GLint uv_scale; GLint uv_max; } u;
+        SHADER_GET_UNIFORM(tex);
+        SHADER_GET_UNIFORM(uv_scale);
+        SHADER_GET_UNIFORM(uv_max);
+        quality->u_tex = u.tex;
+        quality->u_uv_scale = u.uv_scale;
+        quality->u_uv_max = u.uv_max;
+    }
+
+    glGenFramebuffers(1, &quality->fbo);
+    glGenTextures(1, &quality->color);
+    glGenRenderbuffers(1, &quality->depth);
+    log_trace("Initialized quality controller (%s)", quality_aa_name(aa));
+    return quality;
+}
+
+void quality_delete(quality_t* quality) {
+    glDeleteFramebuffers(1, &quality->fbo);
+    glDeleteTextures(1, &quality->color);
+    glDeleteRenderbuffers(1, &quality->depth);
+    shader_deinit(quality->shader);
+    free(quality);
+}
+
+void quality_interact(quality_t* quality) {
+    quality->last_input = platform_get_time();
+}
+
+void quality_update(quality_t* quality, float frame_ms, float target_ms) {
+    quality->target_ms = target_ms;
+    if (frame_ms < 0.0f) {
+        return;
+    }
+
+    /*  Full-quality frames decide whether to reduce quality at all */
+    if (!(quality->history & (1 << (QUALITY_RESULT_LAG - 1)))) {
+        quality->full_ms = frame_ms;
+        return;
+    } else if (quality->wait) {
+        quality->wait--;
+        return;
+    }
+
+    /*  Otherwise, adjust the scale to approach the target */
+    const float old = quality->scale;
+    if (frame_ms > target_ms) {
+        quality->scale = fmaxf(QUALITY_MIN_SCALE, quality->scale * 0.85f);
+    } else if (frame_ms < target_ms * 0.5f) {
+        quality->scale = fminf(QUALITY_MAX_SCALE, quality->scale * 1.1f);
+    }
+    if (quality->scale != old) {
+        log_trace("Render scale %.2f (%.2f ms, target %.2f ms)",
+                  quality->scale, frame_ms, target_ms);
+        quality->wait = QUALITY_RESULT_LAG;
+    }
+}
+
+/*  Resizes the offscreen framebuffer to match the viewport */
+static void quality_resize(quality_t* quality, GLint width, GLint height) {
+    glBindTexture(GL_TEXTURE_2D, quality->color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, quality->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                          width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, quality->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, quality->color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, quality->depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        log_error("Offscreen framebuffer is incomplete");
+    }
+    quality->fbo_width = width;
+    quality->fbo_height = height;
+}
+
+bool quality_begin(quality_t* quality, bool moving) {
+    const bool recent = platform_get_time() - quality->last_input
+                      < QUALITY_SETTLE_US;
+    const bool reduce = (moving || recent) &&
+                        quality->full_ms > quality->target_ms;
+    quality->history = (quality->history << 1) | reduce;
+
+    /*  Post-process AA always draws offscreen, at full resolution unless
+     *  the frame is reduced */
+    quality->offscreen = reduce || quality->aa == QUALITY_AA_FXAA;
+    if (!quality->offscreen) {
+        return false;
+    }
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &quality->target);
+    glGetIntegerv(GL_VIEWPORT, quality->viewport);
+    const GLint width = quality->viewport[2];
+    const GLint height = quality->viewport[3];
+    if (width != quality->fbo_width || height != quality->fbo_height) {
+        quality_resize(quality, width, height);
+    }
+
+    /*  Draw into the corner of the offscreen framebuffer */
+    const float scale = reduce ? quality->scale : 1.0f;
+    quality->scaled[0] = (GLint)ceilf(width * scale);
+    quality->scaled[1] = (GLint)ceilf(height * scale);
+    glBindFramebuffer(GL_FRAMEBUFFER, quality->fbo);
+    glViewport(0, 0, quality->scaled[0], quality->scaled[1]);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    return reduce;
+}
+
+void quality_end(quality_t* quality, backdrop_t* backdrop) {
+    if (!quality->offscreen) {
+        return;
+    }
+
+    /*  Stretch the offscreen frame over the original framebuffer,
+     *  applying post-process AA if enabled */
+    glBindFramebuffer(GL_FRAMEBUFFER, quality->target);
+    glViewport(quality->viewport[0], quality->viewport[1],
+               quality->viewport[2], quality->viewport[3]);
+    glDisable(GL_DEPTH_TEST);
+
+    glUseProgram(quality->shader.prog);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, quality->color);
+    glUniform1i(quality->u_tex, 0);
+    glUniform2f(quality->u_uv_scale,
+                (float)quality->scaled[0] / quality->fbo_width,
+                (float)quality->scaled[1] / quality->fbo_height);
+    glUniform2f(quality->u_uv_max,
+                (quality->scaled[0] - 0.5f) / quality->fbo_width,
+                (quality->scaled[1] - 0.5f) / quality->fbo_height);
+    backdrop_draw_quad(backdrop);
+    log_gl_error();
+}
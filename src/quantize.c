@@ -0,0 +1,48 @@
+#include "quantize.h"
+
+bool quantize_check(const float min[3], const float max[3], float edge) {
+    /*  Find the longest distance that rounding can move a vertex */
+    float err = 0.0f;
+    for (unsigned j=0; j < 3; ++j) {
+        if (!isfinite(min[j]) || !isfinite(max[j]) ||
+            !isfinite(max[j] - min[j]))
+        {
+            return false;
+        }
+        const float half_step = (max[j] - min[j]) / (2.0f * QUANTIZE_MAX);
+        err += half_step * half_step;
+    }
+    return sqrtf(err) * QUANTIZE_EDGE_PIXELS <= edge;
+}
+
+void quantize_encode(const float (*verts)[3], size_t count,
+                     const float min[3], const float max[3],
+                     uint16_t (*out)[3])
+{
+    float scale[3];
+    for (unsigned j=0; j < 3; ++j) {
+        const float extent = max[j] - min[j];
+        scale[j] = (extent > 0.0f) ? QUANTIZE_MAX / extent : 0.0f;
+    }
+    for (size_t i=0; i < count; ++i) {
+        for (unsigned j=0; j < 3; ++j) {
+            const float q = (verts[i][j] - min[j]) * scale[j] + 0.5f;
+            out[i][j] = (q >= QUANTIZE_MAX) ? QUANTIZE_MAX
+                      : (q > 0.0f) ? (uint16_t)q : 0;
+        }
+    }
+}
+
+void quantize_round(const float (*verts)[3], size_t count,
+                    const float min[3], const float max[3],
+                    float (*out)[3])
+{
+    for (size_t i=0; i < count; ++i) {
+        uint16_t q[3];
+        quantize_encode(&verts[i], 1, min, max, &q);
+        for (unsigned j=0; j < 3; ++j) {
+            out[i][j] = min[j] + (max[j] - min[j])
+                               * (q[j] / (float)QUANTIZE_MAX);
+        }
+    }
+}
@@ -0,0 +1,247 @@
+#include "log.h"
+#include "platform.h"
+#include "report.h"
+
+#define MB(b) ((b) / (1024.0 * 1024.0))
+
+void report_sample(report_t* report, const char* stage, int64_t time) {
+    if (report->sample_count == REPORT_MAX_SAMPLES) {
+        return;
+    }
+    mem_stats_t mem;
+    mem_get_stats(&mem);
+
+    report_sample_t* s = &report->samples[report->sample_count++];
+    s->stage = stage;
+    s->time = time;
+    s->rss = platform_get_rss();
+    s->tracked = mem.total;
+}
+
+float report_dedup_ratio(const report_t* report) {
+    return report->vert_count
+        ? (3.0f * report->tri_count) / report->vert_count
+        : 0.0f;
+}
+
+int64_t report_vcache_time(const report_t* report) {
+    int64_t t = 0;
+    for (unsigned i=0; i < report->worker_count; ++i) {
+        t += report->workers[i].time_vcache;
+    }
+    return t;
+}
+
+int64_t report_lod_time(const report_t* report) {
+    int64_t t = 0;
+    for (unsigned i=0; i < report->worker_count; ++i) {
+        t += report->workers[i].time_lod;
+    }
+    return t;
+}
+
+const char* report_format_string(report_format_t format) {
+    switch (format) {
+        case REPORT_FORMAT_BINARY:  return "binary";
+        case REPORT_FORMAT_ASCII:   return "ascii";
+        case REPORT_FORMAT_BUILTIN: return "builtin";
+    }
+    return "unknown";
+}
+
+void report_log(const report_t* report) {
+    log_info("Loaded %s (%s, %u bytes)", report->filename,
+             report_format_string(report->format),
+             (unsigned)report->file_size);
+    log_info("  %u triangles, %u vertices (dedup ratio %.2f), %s kernels",
+             report->tri_count, report->vert_count,
+             report_dedup_ratio(report), report->simd);
+    if (report->nan_count) {
+        log_warn("  %u vertices contain NaN/inf values", report->nan_count);
+    }
+    log_info("  %u feature edges", report->line_count);
+    if (report->flaw_count) {
+        log_info("  Open or inconsistently wound (%u edges)",
+                 report->flaw_count);
+    } else {
+        log_info("  Closed, with volume %g", report->volume);
+    }
+    log_info("  %.1f MB of vertices, %u of %u chunks quantized",
+             MB(report->vbo_bytes), report->quantized_count,
+             report->worker_count);
+    log_info("  %.1f MB of indices, %u of %u chunks with 16-bit indices "
+             "(%u ranges, %u clusters)", MB(report->ibo_bytes),
+             report->short_index_count, report->worker_count,
+             report->range_count, report->cluster_count);
+    if (report->lod) {
+        log_info("  %u triangles in levels of detail (%.3f ms across "
+                 "workers)", report->lod_tri_count,
+                 report_lod_time(report) / 1000.0);
+    }
+    if (report->morton || report->vcache) {
+        log_info("  ACMR %.3f in file order, %.3f reordered (%s%s%s, "
+                 "%.3f ms across workers)", report->acmr[0],
+                 report->acmr[1], report->morton ? "morton" : "",
+                 (report->morton && report->vcache) ? " + " : "",
+                 report->vcache ? "tipsify" : "",
+                 report_vcache_time(report) / 1000.0);
+    } else {
+        log_info("  ACMR %.3f in file order (reordering disabled)",
+                 report->acmr[0]);
+    }
+    /*  There's a worker per chunk, so summarize them rather than
+     *  printing every one (they're all included in the JSON output) */
+    unsigned max_chain = 0;
+    float mean_chain = 0.0f;
+    unsigned rehash_count = 0;
+    for (unsigned i=0; i < report->worker_count; ++i) {
+        const report_worker_t* w = &report->workers[i];
+        if (w->vset.max_chain > max_chain) {
+            max_chain = w->vset.max_chain;
+        }
+        if (w->vset.mean_chain > mean_chain) {
+            mean_chain = w->vset.mean_chain;
+        }
+        rehash_count += w->vset.rehash_count;
+    }
+    log_info("  %u chunks: chain max %u / worst mean %.2f, %u rehashes",
+             report->worker_count, max_chain, mean_chain, rehash_count);
+    log_info("  peak RSS %.1f MB, peak tracked %.1f MB",
+             MB(report->peak_rss), MB(report->mem.total_peak));
+    for (unsigned i=0; i < MEM_SUBSYSTEM_COUNT; ++i) {
+        if (report->mem.peak[i]) {
+            log_info("    %-10s peak %8.1f MB, now %8.1f MB",
+                     mem_subsystem_name(i), MB(report->mem.peak[i]),
+                     MB(report->mem.current[i]));
+        }
+    }
+    for (unsigned i=0; i < report->sample_count; ++i) {
+        const report_sample_t* s = &report->samples[i];
+        log_info("    at %-10s (%8.3f ms) RSS %8.1f MB, tracked %8.1f MB",
+                 s->stage, s->time / 1000.0, MB(s->rss), MB(s->tracked));
+    }
+    log_info("  open %.3f  parse %.3f  dedup %.3f  copy %.3f  edges %.3f  "
+             "total %.3f ms (first chunk at %.3f ms)",
+             report->time_open / 1000.0, report->time_parse / 1000.0,
+             report->time_dedup / 1000.0, report->time_copy / 1000.0,
+             report->time_edges / 1000.0, report->time_total / 1000.0,
+             report->time_first_chunk / 1000.0);
+}
+
+void report_write_string(const char* s, FILE* out) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', out);
+            fputc(*s, out);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(out, "\\u%04x", *s);
+        } else {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+void report_write_json(const report_t* report, FILE* out) {
+    fprintf(out, "{\"filename\": ");
+    report_write_string(report->filename, out);
+    fprintf(out, ", \"format\": \"%s\", \"file_size\": %lu",
+            report_format_string(report->format),
+            (unsigned long)report->file_size);
+    fprintf(out, ", \"tri_count\": %u, \"vert_count\": %u"
+                 ", \"dedup_ratio\": %f, \"nan_count\": %u"
+                 ", \"line_count\": %u, \"flaw_count\": %u"
+                 ", \"volume\": %f",
+            report->tri_count, report->vert_count,
+            report_dedup_ratio(report), report->nan_count,
+            report->line_count, report->flaw_count, report->volume);
+    fprintf(out, ", \"vbo_bytes\": %lu, \"quantized_count\": %u"
+                 ", \"ibo_bytes\": %lu, \"short_index_count\": %u"
+                 ", \"range_count\": %u, \"cluster_count\": %u",
+            (unsigned long)report->vbo_bytes, report->quantized_count,
+            (unsigned long)report->ibo_bytes, report->short_index_count,
+            report->range_count, report->cluster_count);
+    fprintf(out, ", \"morton\": %s, \"vcache\": %s, \"acmr_file\": %f"
+                 ", \"acmr\": %f, \"time_vcache_us\": %li",
+            report->morton ? "true" : "false",
+            report->vcache ? "true" : "false", report->acmr[0],
+            report->acmr[1], (long)report_vcache_time(report));
+    fprintf(out, ", \"lod\": %s, \"lod_tri_count\": %u"
+                 ", \"time_lod_us\": %li",
+            report->lod ? "true" : "false", report->lod_tri_count,
+            (long)report_lod_time(report));
+
+    fprintf(out, ", \"simd\": \"%s\"", report->simd);
+    fprintf(out, ", \"workers\": [");
+    for (unsigned i=0; i < report->worker_count; ++i) {
+        const report_worker_t* w = &report->workers[i];
+        fprintf(out, "%s{\"tri_count\": %u, \"vert_count\": %u"
+                     ", \"nan_count\": %u, \"buckets\": %u"
+                     ", \"occupied_buckets\": %u, \"max_chain\": %u"
+                     ", \"mean_chain\": %f, \"rehash_count\": %u"
+                     ", \"acmr_file\": %f, \"acmr\": %f"
+                     ", \"quantized\": %s, \"index_size\": %u"
+                     ", \"range_count\": %u, \"cluster_count\": %u"
+                     ", \"lod_count\": %u}",
+                i ? ", " : "", w->tri_count, w->vert_count, w->nan_count,
+                w->vset.num_buckets, w->vset.occupied_buckets,
+                w->vset.max_chain, w->vset.mean_chain,
+                w->vset.rehash_count, w->acmr[0], w->acmr[1],
+                w->quantized ? "true" : "false", w->index_size,
+                w->range_count, w->cluster_count, w->lod_count);
+    }
+    fprintf(out, "]");
+
+    fprintf(out, ", \"peak_rss\": %lu", (unsigned long)report->peak_rss);
+    fprintf(out, ", \"mem\": ");
+    report_write_mem_json(&report->mem, out);
+    fprintf(out, ", \"samples\": [");
+    for (unsigned i=0; i < report->sample_count; ++i) {
+        const report_sample_t* s = &report->samples[i];
+        fprintf(out, "%s{\"stage\": \"%s\", \"time_us\": %li"
+                     ", \"rss\": %lu, \"tracked\": %lu}",
+                i ? ", " : "", s->stage, (long)s->time,
+                (unsigned long)s->rss, (unsigned long)s->tracked);
+    }
+    fprintf(out, "]");
+    fprintf(out, ", \"time_us\": {\"open\": %li, \"parse\": %li"
+                 ", \"dedup\": %li, \"copy\": %li, \"edges\": %li"
+                 ", \"total\": %li, \"first_chunk\": %li}}\n",
+            (long)report->time_open, (long)report->time_parse,
+            (long)report->time_dedup, (long)report->time_copy,
+            (long)report->time_edges, (long)report->time_total,
+            (long)report->time_first_chunk);
+}
+
+void report_write_mem_json(const mem_stats_t* mem, FILE* out) {
+    fprintf(out, "{\"total\": %lu, \"total_peak\": %lu",
+            (unsigned long)mem->total, (unsigned long)mem->total_peak);
+    for (unsigned i=0; i < MEM_SUBSYSTEM_COUNT; ++i) {
+        fprintf(out, ", \"%s\": {\"current\": %lu, \"peak\": %lu}",
+                mem_subsystem_name(i), (unsigned long)mem->current[i],
+                (unsigned long)mem->peak[i]);
+    }
+    fprintf(out, "}");
+}
+
+FILE* report_open(void) {
+    const char* path = getenv("ERIZO_REPORT");
+    if (!path || !*path) {
+        return NULL;
+    }
+    FILE* out = fopen(path, "a");
+    if (!out) {
+        log_error("Could not open report file %s", path);
+    }
+    return out;
+}
+
+void report_save(const report_t* report) {
+    FILE* out = report_open();
+    if (out) {
+        report_write_json(report, out);
+        fclose(out);
+        log_trace("Wrote load report");
+    }
+}
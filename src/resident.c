@@ -0,0 +1,128 @@
+#include "camera.h"
+#include "cull.h"
+#include "log.h"
+#include "model.h"
+#include "platform.h"
+#include "resident.h"
+
+/*  Returns the model's budget, which may have been shrunk below the one
+ *  in its options if the GPU ran out of memory (zero means unlimited).
+ *  A shrunk budget is raised again every RESIDENT_RETRY_US, until it's
+ *  restored or the GPU runs out of memory again. */
+static size_t resident_limit(model_t* model) {
+    const size_t budget = model->options.gpu_budget;
+    if (model->budget) {
+        const int64_t now = platform_get_time();
+        if (now - model->budget_time >= RESIDENT_RETRY_US) {
+            model->budget += RESIDENT_UPLOAD_BYTES;
+            model->budget_time = now;
+            if (budget && model->budget >= budget) {
+                model->budget = 0;
+            }
+        }
+    }
+    if (model->budget && (!budget || model->budget < budget)) {
+        return model->budget;
+    }
+    return budget;
+}
+
+/*  Unlinks a chunk from the model's list of resident streamed chunks */
+static void resident_unlink(model_t* model, unsigned i) {
+    model_chunk_t* chunk = &model->chunks[i];
+    if (chunk->lru_prev != MODEL_NO_CHUNK) {
+        model->chunks[chunk->lru_prev].lru_next = chunk->lru_next;
+    } else {
+        model->lru_head = chunk->lru_next;
+    }
+    if (chunk->lru_next != MODEL_NO_CHUNK) {
+        model->chunks[chunk->lru_next].lru_prev = chunk->lru_prev;
+    } else {
+        model->lru_tail = chunk->lru_prev;
+    }
+    chunk->lru_prev = MODEL_NO_CHUNK;
+    chunk->lru_next = MODEL_NO_CHUNK;
+}
+
+/*  Links a chunk at the head of the list, as the most recently visible */
+static void resident_link(model_t* model, unsigned i) {
+    model_chunk_t* chunk = &model->chunks[i];
+    chunk->lru_next = model->lru_head;
+    if (model->lru_head != MODEL_NO_CHUNK) {
+        model->chunks[model->lru_head].lru_prev = i;
+    } else {
+        model->lru_tail = i;
+    }
+    model->lru_head = i;
+}
+
+/*  Evicts the least recently visible chunks (from the tail of the list)
+ *  until there's room for the given number of bytes, returning false if
+ *  that would mean evicting a chunk which is visible in this frame */
+static bool resident_evict(model_t* model, size_t limit, size_t bytes) {
+    while (limit && model->resident_bytes + bytes > limit) {
+        const unsigned lru = model->lru_tail;
+        if (lru == MODEL_NO_CHUNK || model->chunks[lru].used == model->frame) {
+            return false;
+        }
+        resident_unlink(model, lru);
+        model_evict_chunk(model, lru);
+    }
+    return true;
+}
+
+bool resident_update(model_t* model, const camera_t* camera) {
+    if (!model->streamed_count) {
+        return false;
+    }
+
+    float planes[6][4];
+    float eye[4];
+    camera_get_cull(camera, planes, eye);
+    model->frame++;
+
+    size_t uploaded = 0;
+    bool pending = false;
+    for (unsigned i=0; i < model->chunk_count; ++i) {
+        model_chunk_t* chunk = &model->chunks[i];
+        if (model->options.cull &&
+            cull_outside((const float(*)[4])planes,
+                         chunk->center, chunk->radius))
+        {
+            continue;
+        }
+        chunk->used = model->frame;
+        if (!chunk->vertex_data) {
+            continue;
+        } else if (chunk->vbo) {
+            /*  Move the chunk to the head of the list, so that the list
+             *  stays sorted by when chunks were last visible */
+            resident_unlink(model, i);
+            resident_link(model, i);
+            continue;
+        }
+
+        /*  Always upload at least one chunk per frame, however large */
+        const size_t bytes = chunk->vbo_bytes + chunk->ibo_bytes;
+        if (uploaded && uploaded + bytes > RESIDENT_UPLOAD_BYTES) {
+            pending = true;
+        } else if (!resident_evict(model, resident_limit(model), bytes)) {
+            /*  Every resident chunk is visible, so this one stays in RAM
+             *  until the view changes (or the budget is raised) */
+        } else if (!model_upload_chunk(model, i)) {
+            /*  Shrink the budget to what fits, then try again next frame
+             *  (after evicting chunks which aren't visible) */
+            log_warn("Out of GPU memory with %.1f MB of buffers resident",
+                     model->resident_bytes / 1048576.0);
+            model->budget = model->resident_bytes ? model->resident_bytes
+                                                  : RESIDENT_UPLOAD_BYTES;
+            model->budget_time = platform_get_time();
+            pending = true;
+            break;
+        } else {
+            resident_link(model, i);
+            uploaded += bytes;
+        }
+    }
+    return pending;
+}
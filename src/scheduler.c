@@ -0,0 +1,117 @@
+#include "log.h"
+#include "object.h"
+#include "platform.h"
+#include "report.h"
+#include "scheduler.h"
+
+/*  Used if the monitor doesn't report a refresh rate */
+#define SCHEDULER_DEFAULT_RATE 60
+
+struct scheduler_ {
+    unsigned cap;           /* Frames per second, or 0 if uncapped */
+    int64_t interval;       /* Microseconds, or 0 until the first frame */
+
+    int64_t start;          /* When scheduler_wait last returned */
+    int64_t last_frame;     /* Start time of the last frame drawn */
+    bool animating;         /* Whether another frame was expected */
+
+    uint64_t frames;
+    uint64_t animated;      /* Frames which were part of an animation */
+    uint64_t missed;
+};
+
+scheduler_t* scheduler_new() {
+    OBJECT_ALLOC(scheduler);
+
+    const char* cap = getenv("ERIZO_FRAME_CAP");
+    if (cap && *cap) {
+        char* end = NULL;
+        const long c = strtol(cap, &end, 10);
+        if (*end || c <= 0) {
+            log_warn("Ignoring invalid ERIZO_FRAME_CAP=%s", cap);
+        } else {
+            scheduler->cap = c;
+        }
+    }
+    return scheduler;
+}
+
+/*  Picks a frame interval based on the primary monitor's refresh rate,
+ *  which is only available once GLFW has been initialized */
+static int64_t scheduler_interval(scheduler_t* scheduler) {
+    int rate = SCHEDULER_DEFAULT_RATE;
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    if (monitor) {
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        if (mode && mode->refreshRate > 0) {
+            rate = mode->refreshRate;
+        }
+    }
+    if (scheduler->cap && scheduler->cap < (unsigned)rate) {
+        rate = scheduler->cap;
+    }
+    log_trace("Scheduling frames at %i Hz", rate);
+    return 1000000 / rate;
+}
+
+void scheduler_wait(scheduler_t* scheduler, bool animating) {
+    scheduler->animating = animating;
+    if (!animating) {
+        glfwWaitEvents();
+    }
+
+    /*  Keep handling events (e.g. updating the mouse position) until the
+     *  next frame is due, so that they're all drawn in a single frame */
+    const int64_t due = scheduler->last_frame + scheduler->interval;
+    int64_t now;
+    while ((now = platform_get_time()) < due) {
+        glfwWaitEventsTimeout((due - now) / 1e6);
+    }
+    scheduler->start = now;
+}
+
+float scheduler_get_interval_ms(const scheduler_t* scheduler) {
+    if (!scheduler->interval) {
+        return 1000.0f / SCHEDULER_DEFAULT_RATE;
+    }
+    return scheduler->interval / 1000.0f;
+}
+
+void scheduler_frame(scheduler_t* scheduler) {
+    if (!scheduler->interval) {
+        scheduler->interval = scheduler_interval(scheduler);
+    }
+
+    if (scheduler->animating && scheduler->frames) {
+        /*  Count the refresh intervals which passed without a new frame,
+         *  allowing a quarter of an interval for timer jitter */
+        const int64_t dt = scheduler->start - scheduler->last_frame;
+        const int64_t skipped = (dt - scheduler->interval / 4)
+                              / scheduler->interval;
+        if (skipped > 0) {
+            scheduler->missed += skipped;
+        }
+        scheduler->animated++;
+    }
+    scheduler->last_frame = scheduler->start;
+    scheduler->frames++;
+}
+
+void scheduler_delete(scheduler_t* scheduler) {
+    log_info("Drew %lu frames (%lu animated), missed %lu",
+             (unsigned long)scheduler->frames,
+             (unsigned long)scheduler->animated,
+             (unsigned long)scheduler->missed);
+
+    FILE* out = report_open();
+    if (out) {
+        fprintf(out, "{\"scheduler\": {\"frames\": %lu, \"animated\": %lu"
+                     ", \"missed\": %lu, \"interval_us\": %li}}\n",
+                (unsigned long)scheduler->frames,
+                (unsigned long)scheduler->animated,
+                (unsigned long)scheduler->missed,
+                (long)scheduler->interval);
+        fclose(out);
+    }
+    free(scheduler);
+}
@@ -5,8 +5,7 @@
 static const GLchar* SHADED_VS_SRC = GLSL(330,
 layout(location=0) in vec3 pos;
 
-uniform mat4 proj;
-uniform mat4 view;
+layout(std140) uniform camera { mat4 proj; mat4 view; };
 uniform mat4 model;
 
 out vec3 ec_pos;
@@ -20,11 +19,8 @@ void main() {
 static const GLchar* SHADED_FS_SRC = GLSL(330,
 in vec3 ec_pos;
 
-uniform mat4 proj;
-
-uniform vec3 key;
-uniform vec3 fill;
-uniform vec3 base;
+layout(std140) uniform camera { mat4 proj; mat4 view; };
+layout(std140) uniform theme { vec3 key; vec3 fill; vec3 base; };
 
 out vec4 out_color;
 
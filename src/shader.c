@@ -21,10 +21,79 @@ static GLuint shader_build(const GLchar* src, GLenum type) {
     return shader;
 }
 
+static void shader_link(shader_t shader) {
+    glLinkProgram(shader.prog);
+    GLint status;
+    glGetProgramiv(shader.prog, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint len = 0;
+        glGetProgramiv(shader.prog, GL_INFO_LOG_LENGTH, &len);
+
+        GLchar* buf = (GLchar*)malloc(len + 1);
+        glGetProgramInfoLog(shader.prog, len, NULL, buf);
+        log_error_and_abort("Failed to link program: %s", buf);
+    }
+}
+
+/*  Every window's context shares objects (see window.c), so programs are
+ *  built once per process and reference-counted, keyed by their sources */
+typedef struct shader_entry_ {
+    const char* src[4];     /* Vertex, geometry, fragment, and compute */
+    shader_t shader;
+    unsigned refs;
+} shader_entry_t;
+
+static shader_entry_t* shader_registry = NULL;
+static unsigned shader_registry_count = 0;
+static unsigned shader_registry_size = 0;
+
+static bool shader_same_src(const char* a, const char* b) {
+    return a == b || (a && b && !strcmp(a, b));
+}
+
+/*  Looks up an existing program with the given sources, adding a
+ *  reference to it.  Returns false if there isn't one. */
+static bool shader_find(const char* src[4], shader_t* out) {
+    for (unsigned i=0; i < shader_registry_count; ++i) {
+        shader_entry_t* e = &shader_registry[i];
+        bool same = true;
+        for (unsigned j=0; j < 4; ++j) {
+            same &= shader_same_src(e->src[j], src[j]);
+        }
+        if (same) {
+            e->refs++;
+            *out = e->shader;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void shader_register(const char* src[4], shader_t shader) {
+    if (shader_registry_count == shader_registry_size) {
+        if (shader_registry_size) {
+            shader_registry_size *= 2;
+        } else {
+            shader_registry_size = 8;
+        }
+        shader_registry = (shader_entry_t*)realloc(
+                shader_registry, sizeof(shader_entry_t) * shader_registry_size);
+    }
+    shader_entry_t* e = &shader_registry[shader_registry_count++];
+    memcpy(e->src, src, sizeof(e->src));
+    e->shader = shader;
+    e->refs = 1;
+}
+
 shader_t shader_new(const char* vs, const char* gs, const char* fs) {
+    const char* src[4] = {vs, gs, fs, NULL};
     shader_t shader;
+    if (shader_find(src, &shader)) {
+        return shader;
+    }
 
     shader.prog = glCreateProgram();
+    shader.cs = 0;
 
     shader.vs = shader_build(vs, GL_VERTEX_SHADER);
     glAttachShader(shader.prog, shader.vs);
@@ -32,28 +101,56 @@ shader_t shader_new(const char* vs, const char* gs, const char* fs) {
     shader.fs = shader_build(fs, GL_FRAGMENT_SHADER);
     glAttachShader(shader.prog, shader.fs);
 
+    shader.gs = 0;
     if (gs) {
         shader.gs = shader_build(gs, GL_GEOMETRY_SHADER);
         glAttachShader(shader.prog, shader.gs);
     }
 
-    glLinkProgram(shader.prog);
-    GLint status;
-    glGetProgramiv(shader.prog, GL_LINK_STATUS, &status);
-    if (status != GL_TRUE) {
-        GLint len = 0;
-        glGetProgramiv(shader.prog, GL_INFO_LOG_LENGTH, &len);
+    shader_link(shader);
+    shader_register(src, shader);
+    log_trace("Built program");
+    return shader;
+}
 
-        GLchar* buf = (GLchar*)malloc(len + 1);
-        glGetProgramInfoLog(shader.prog, len, NULL, buf);
-        log_error_and_abort("Failed to link program: %s", buf);
+shader_t shader_new_compute(const char* cs) {
+    const char* src[4] = {NULL, NULL, NULL, cs};
+    shader_t shader = {0};
+    if (shader_find(src, &shader)) {
+        return shader;
     }
+    shader.prog = glCreateProgram();
+    shader.cs = shader_build(cs, GL_COMPUTE_SHADER);
+    glAttachShader(shader.prog, shader.cs);
+    shader_link(shader);
+    shader_register(src, shader);
+    log_trace("Built compute program");
     return shader;
 }
 
+void shader_set_block(GLuint prog, const char* name, GLuint binding) {
+    const GLuint index = glGetUniformBlockIndex(prog, name);
+    if (index == GL_INVALID_INDEX) {
+        log_error("Failed to get uniform block %s", name);
+    } else {
+        glUniformBlockBinding(prog, index, binding);
+    }
+}
+
 void shader_deinit(shader_t shader) {
+    for (unsigned i=0; i < shader_registry_count; ++i) {
+        shader_entry_t* e = &shader_registry[i];
+        if (e->shader.prog == shader.prog) {
+            if (--e->refs) {
+                return;
+            }
+            *e = shader_registry[--shader_registry_count];
+            break;
+        }
+    }
     glDeleteShader(shader.vs);
     glDeleteShader(shader.gs);
     glDeleteShader(shader.fs);
+    glDeleteShader(shader.cs);
     glDeleteProgram(shader.prog);
 }
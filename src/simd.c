@@ -0,0 +1,124 @@
+#include "log.h"
+#include "simd.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash/xxhash.h"
+
+/*  Scalar reference implementations, used on CPUs without a faster
+ *  option and to check the other instruction sets. */
+static void simd_scalar_destride(const char (*stl)[50], size_t tri_count,
+                                 float* out)
+{
+    for (size_t i=0; i < tri_count; ++i) {
+        memcpy(&out[i * 9], stl[i], 9 * sizeof(float));
+    }
+}
+
+static void simd_scalar_hash(const float (*verts)[3], size_t count,
+                             uint32_t* out)
+{
+    for (size_t i=0; i < count; ++i) {
+        out[i] = XXH32(verts[i], 12, 0);
+    }
+}
+
+static uint32_t simd_scalar_bounds(const float (*verts)[3], size_t count,
+                                   float min[3], float max[3])
+{
+    uint32_t nan_count = 0;
+    for (size_t i=0; i < count; ++i) {
+        bool has_nan = false;
+        for (unsigned j=0; j < 3; ++j) {
+            const float v = verts[i][j];
+            /* Skip NaN / inf when calculating bounds */
+            if (isnan(v) || isinf(v)) {
+                has_nan = true;
+            } else {
+                if (v < min[j]) {
+                    min[j] = v;
+                }
+                if (v > max[j]) {
+                    max[j] = v;
+                }
+            }
+        }
+        nan_count += has_nan;
+    }
+    return nan_count;
+}
+
+static const char* simd_scalar_find_vertex(const char* data,
+                                           const char* end)
+{
+    const char VERTEX_STR[] = "vertex ";
+    const size_t len = strlen(VERTEX_STR);
+    for (; data + len <= end; ++data) {
+        if (*data == 'v' && !memcmp(data, VERTEX_STR, len)) {
+            return data;
+        }
+    }
+    return NULL;
+}
+
+static const simd_kernels_t SIMD_SCALAR_KERNELS = {
+    .level = SIMD_SCALAR,
+    .destride = simd_scalar_destride,
+    .hash = simd_scalar_hash,
+    .bounds = simd_scalar_bounds,
+    .find_vertex = simd_scalar_find_vertex,
+};
+
+/******************************************************************************/
+
+static const simd_kernels_t* simd_active = NULL;
+
+const char* simd_level_name(simd_level_t level) {
+    switch (level) {
+        case SIMD_SCALAR:       return "scalar";
+        case SIMD_SSE2:         return "sse2";
+        case SIMD_AVX2:         return "avx2";
+        case SIMD_AVX512:       return "avx512";
+        case SIMD_NEON:         return "neon";
+        case SIMD_LEVEL_COUNT:  break;
+    }
+    return "unknown";
+}
+
+const simd_kernels_t* simd_get_level(simd_level_t level) {
+    switch (level) {
+        case SIMD_SCALAR:       return &SIMD_SCALAR_KERNELS;
+        case SIMD_SSE2:
+        case SIMD_AVX2:
+        case SIMD_AVX512:       return simd_x86_kernels(level);
+        case SIMD_NEON:         return simd_neon_kernels();
+        case SIMD_LEVEL_COUNT:  break;
+    }
+    return NULL;
+}
+
+void simd_init() {
+    assert(simd_active == NULL);
+
+    /*  Pick the most preferred level, or stop at the requested level */
+    const char* requested = getenv("ERIZO_SIMD");
+    simd_active = &SIMD_SCALAR_KERNELS;
+    for (unsigned i=0; i < SIMD_LEVEL_COUNT; ++i) {
+        const simd_kernels_t* k = simd_get_level(i);
+        if (k) {
+            simd_active = k;
+        }
+        if (requested && !strcmp(requested, simd_level_name(i))) {
+            if (!k) {
+                log_warn("ERIZO_SIMD=%s is not supported on this CPU",
+                         requested);
+            }
+            break;
+        }
+    }
+    log_trace("Using %s kernels", simd_level_name(simd_active->level));
+}
+
+const simd_kernels_t* simd_get() {
+    assert(simd_active != NULL);
+    return simd_active;
+}
@@ -0,0 +1,133 @@
+#include "simd.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+/*  XXH32 constants, for inputs of exactly 12 bytes with a seed of 0 */
+#define XXH_P2 0x85EBCA77U
+#define XXH_P3 0xC2B2AE3DU
+#define XXH_P4 0x27D4EB2FU
+#define XXH_P5 0x165667B1U
+#define XXH_INIT (XXH_P5 + 12)
+
+static void simd_neon_destride(const char (*stl)[50], size_t tri_count,
+                               float* out)
+{
+    for (size_t i=0; i < tri_count; ++i) {
+        const uint8x16_t a = vld1q_u8((const uint8_t*)stl[i]);
+        const uint8x16_t b = vld1q_u8((const uint8_t*)stl[i] + 16);
+        vst1q_u8((uint8_t*)&out[i * 9], a);
+        vst1q_u8((uint8_t*)&out[i * 9 + 4], b);
+        memcpy(&out[i * 9 + 8], stl[i] + 32, sizeof(float));
+    }
+}
+
+static inline uint32x4_t simd_neon_round(uint32x4_t h, uint32x4_t w) {
+    h = vmlaq_u32(h, w, vdupq_n_u32(XXH_P3));
+    h = vorrq_u32(vshlq_n_u32(h, 17), vshrq_n_u32(h, 15));
+    return vmulq_u32(h, vdupq_n_u32(XXH_P4));
+}
+
+static void simd_neon_hash(const float (*verts)[3], size_t count,
+                           uint32_t* out)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        /*  De-interleaving load, giving one vector per axis */
+        const uint32x4x3_t v = vld3q_u32((const uint32_t*)&verts[i][0]);
+
+        uint32x4_t h = vdupq_n_u32(XXH_INIT);
+        h = simd_neon_round(h, v.val[0]);
+        h = simd_neon_round(h, v.val[1]);
+        h = simd_neon_round(h, v.val[2]);
+
+        h = veorq_u32(h, vshrq_n_u32(h, 15));
+        h = vmulq_u32(h, vdupq_n_u32(XXH_P2));
+        h = veorq_u32(h, vshrq_n_u32(h, 13));
+        h = vmulq_u32(h, vdupq_n_u32(XXH_P3));
+        h = veorq_u32(h, vshrq_n_u32(h, 16));
+        vst1q_u32(&out[i], h);
+    }
+    simd_get_level(SIMD_SCALAR)->hash(&verts[i], count - i, &out[i]);
+}
+
+static uint32_t simd_neon_bounds(const float (*verts)[3], size_t count,
+                                 float min[3], float max[3])
+{
+    const float32x4_t inf = vdupq_n_f32(INFINITY);
+    const float32x4_t neg_inf = vdupq_n_f32(-INFINITY);
+    float32x4_t mn[3] = {inf, inf, inf};
+    float32x4_t mx[3] = {neg_inf, neg_inf, neg_inf};
+    uint32x4_t bad = vdupq_n_u32(0);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4x3_t v = vld3q_f32(&verts[i][0]);
+        uint32x4_t finite = vdupq_n_u32(~0U);
+        for (unsigned j=0; j < 3; ++j) {
+            /*  NaN and inf are the only values where v - v != 0 */
+            const uint32x4_t f = vceqq_f32(vsubq_f32(v.val[j], v.val[j]),
+                                           vdupq_n_f32(0.0f));
+            mn[j] = vminq_f32(mn[j], vbslq_f32(f, v.val[j], inf));
+            mx[j] = vmaxq_f32(mx[j], vbslq_f32(f, v.val[j], neg_inf));
+            finite = vandq_u32(finite, f);
+        }
+        /*  Count vertices with any non-finite coordinate, per lane */
+        bad = vaddq_u32(bad, vshrq_n_u32(vmvnq_u32(finite), 31));
+    }
+
+    for (unsigned j=0; j < 3; ++j) {
+        const float a = vminvq_f32(mn[j]);
+        const float b = vmaxvq_f32(mx[j]);
+        if (a < min[j]) {
+            min[j] = a;
+        }
+        if (b > max[j]) {
+            max[j] = b;
+        }
+    }
+    return vaddvq_u32(bad) + simd_get_level(SIMD_SCALAR)->bounds(
+            &verts[i], count - i, min, max);
+}
+
+static const char* simd_neon_find_vertex(const char* data, const char* end)
+{
+    /*  Compare the first and last characters of "vertex " at every offset,
+     *  then check the remaining characters of each candidate */
+    const uint8x16_t first = vdupq_n_u8('v');
+    const uint8x16_t last = vdupq_n_u8(' ');
+    for (; data + 6 + 16 <= end; data += 16) {
+        const uint8x16_t a = vld1q_u8((const uint8_t*)data);
+        const uint8x16_t b = vld1q_u8((const uint8_t*)data + 6);
+        const uint8x16_t m = vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last));
+        if (vmaxvq_u8(m)) {
+            for (unsigned j=0; j < 16; ++j) {
+                if (data[j] == 'v' && !memcmp(data + j + 1, "ertex ", 6)) {
+                    return data + j;
+                }
+            }
+        }
+    }
+    return simd_get_level(SIMD_SCALAR)->find_vertex(data, end);
+}
+
+static const simd_kernels_t SIMD_NEON_KERNELS = {
+    .level = SIMD_NEON,
+    .destride = simd_neon_destride,
+    .hash = simd_neon_hash,
+    .bounds = simd_neon_bounds,
+    .find_vertex = simd_neon_find_vertex,
+};
+
+/*  NEON is part of the baseline for AArch64, so no detection is needed */
+const simd_kernels_t* simd_neon_kernels() {
+    return &SIMD_NEON_KERNELS;
+}
+
+#else
+
+const simd_kernels_t* simd_neon_kernels() {
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,487 @@
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/*  Each kernel is compiled for its own instruction set, so the rest of the
+ *  binary still runs on CPUs without AVX2 or AVX-512. */
+#define SIMD_TARGET(t) __attribute__((target(t)))
+
+/*  XXH32 constants, for inputs of exactly 12 bytes with a seed of 0 */
+#define XXH_P2 0x85EBCA77U
+#define XXH_P3 0xC2B2AE3DU
+#define XXH_P4 0x27D4EB2FU
+#define XXH_P5 0x165667B1U
+#define XXH_INIT (XXH_P5 + 12)
+
+/*  Mask of the lowest bit of each vertex in a bitmask of coordinates */
+#define VERT_BITS_4  0x249U
+#define VERT_BITS_8  0x249249U
+#define VERT_BITS_16 0x249249249249ULL
+
+/*  Combines per-lane minimum and maximum values, where lane n holds
+ *  coordinates on axis n % 3 */
+static void simd_x86_reduce(const float* mn, const float* mx, unsigned n,
+                            float min[3], float max[3])
+{
+    for (unsigned i=0; i < n; ++i) {
+        if (mn[i] < min[i % 3]) {
+            min[i % 3] = mn[i];
+        }
+        if (mx[i] > max[i % 3]) {
+            max[i % 3] = mx[i];
+        }
+    }
+}
+
+/*  Counts vertices with at least one bit set in a mask of coordinates */
+static uint32_t simd_x86_count_verts(uint64_t bad, uint64_t vert_bits) {
+    return __builtin_popcountll((bad | (bad >> 1) | (bad >> 2)) & vert_bits);
+}
+
+/******************************************************************************/
+/*  SSE2                                                                      */
+
+SIMD_TARGET("sse2")
+static void simd_sse2_destride(const char (*stl)[50], size_t tri_count,
+                               float* out)
+{
+    for (size_t i=0; i < tri_count; ++i) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)stl[i]);
+        const __m128i b = _mm_loadu_si128((const __m128i*)(stl[i] + 16));
+        _mm_storeu_si128((__m128i*)&out[i * 9], a);
+        _mm_storeu_si128((__m128i*)&out[i * 9 + 4], b);
+        memcpy(&out[i * 9 + 8], stl[i] + 32, sizeof(float));
+    }
+}
+
+/*  SSE2 has no 32-bit low multiply, so build one from 32x32 -> 64 */
+SIMD_TARGET("sse2")
+static inline __m128i simd_sse2_mullo(__m128i a, __m128i b) {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+                                      _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(
+            _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+SIMD_TARGET("sse2")
+static inline __m128i simd_sse2_round(__m128i h, __m128i w) {
+    h = _mm_add_epi32(h, simd_sse2_mullo(w, _mm_set1_epi32(XXH_P3)));
+    h = _mm_or_si128(_mm_slli_epi32(h, 17), _mm_srli_epi32(h, 15));
+    return simd_sse2_mullo(h, _mm_set1_epi32(XXH_P4));
+}
+
+SIMD_TARGET("sse2")
+static void simd_sse2_hash(const float (*verts)[3], size_t count,
+                           uint32_t* out)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        /*  Load four vertices as [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3],
+         *  then transpose into one vector per axis */
+        const __m128 a = _mm_loadu_ps(&verts[i][0]);
+        const __m128 b = _mm_loadu_ps(&verts[i][0] + 4);
+        const __m128 c = _mm_loadu_ps(&verts[i][0] + 8);
+        const __m128 x = _mm_shuffle_ps(
+                _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)),
+                _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+                _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 y = _mm_shuffle_ps(
+                _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 z = _mm_shuffle_ps(
+                _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                _MM_SHUFFLE(2, 0, 2, 0));
+
+        __m128i h = _mm_set1_epi32(XXH_INIT);
+        h = simd_sse2_round(h, _mm_castps_si128(x));
+        h = simd_sse2_round(h, _mm_castps_si128(y));
+        h = simd_sse2_round(h, _mm_castps_si128(z));
+
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+        h = simd_sse2_mullo(h, _mm_set1_epi32(XXH_P2));
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+        h = simd_sse2_mullo(h, _mm_set1_epi32(XXH_P3));
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+        _mm_storeu_si128((__m128i*)&out[i], h);
+    }
+    simd_get_level(SIMD_SCALAR)->hash(&verts[i], count - i, &out[i]);
+}
+
+SIMD_TARGET("sse2")
+static uint32_t simd_sse2_bounds(const float (*verts)[3], size_t count,
+                                 float min[3], float max[3])
+{
+    /*  Each group of four vertices is loaded as three vectors, and each
+     *  lane always holds the same axis, so there's no need to shuffle. */
+    const __m128 inf = _mm_set1_ps(INFINITY);
+    const __m128 neg_inf = _mm_set1_ps(-INFINITY);
+    __m128 mn[3] = {inf, inf, inf};
+    __m128 mx[3] = {neg_inf, neg_inf, neg_inf};
+    uint32_t nan_count = 0;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        unsigned finite = 0;
+        for (unsigned j=0; j < 3; ++j) {
+            /*  NaN and inf are the only values where v - v != 0.  They're
+             *  replaced with values that don't change the bounds. */
+            const __m128 v = _mm_loadu_ps(&verts[i][0] + 4 * j);
+            const __m128 f = _mm_cmpeq_ps(_mm_sub_ps(v, v),
+                                          _mm_setzero_ps());
+            const __m128 fv = _mm_and_ps(f, v);
+            mn[j] = _mm_min_ps(mn[j],
+                               _mm_or_ps(fv, _mm_andnot_ps(f, inf)));
+            mx[j] = _mm_max_ps(mx[j],
+                               _mm_or_ps(fv, _mm_andnot_ps(f, neg_inf)));
+            finite |= _mm_movemask_ps(f) << (4 * j);
+        }
+        nan_count += simd_x86_count_verts(~finite & 0xFFF, VERT_BITS_4);
+    }
+
+    float mn_out[12], mx_out[12];
+    for (unsigned j=0; j < 3; ++j) {
+        _mm_storeu_ps(&mn_out[4 * j], mn[j]);
+        _mm_storeu_ps(&mx_out[4 * j], mx[j]);
+    }
+    simd_x86_reduce(mn_out, mx_out, 12, min, max);
+    return nan_count + simd_get_level(SIMD_SCALAR)->bounds(
+            &verts[i], count - i, min, max);
+}
+
+SIMD_TARGET("sse2")
+static const char* simd_sse2_find_vertex(const char* data, const char* end)
+{
+    /*  Compare the first and last characters of "vertex " at every offset,
+     *  then check the remaining characters of each candidate */
+    const __m128i first = _mm_set1_epi8('v');
+    const __m128i last = _mm_set1_epi8(' ');
+    for (; data + 6 + 16 <= end; data += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)data);
+        const __m128i b = _mm_loadu_si128((const __m128i*)(data + 6));
+        unsigned mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, first),
+                              _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            const unsigned j = __builtin_ctz(mask);
+            if (!memcmp(data + j + 1, "ertex", 5)) {
+                return data + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return simd_get_level(SIMD_SCALAR)->find_vertex(data, end);
+}
+
+static const simd_kernels_t SIMD_SSE2_KERNELS = {
+    .level = SIMD_SSE2,
+    .destride = simd_sse2_destride,
+    .hash = simd_sse2_hash,
+    .bounds = simd_sse2_bounds,
+    .find_vertex = simd_sse2_find_vertex,
+};
+
+/******************************************************************************/
+/*  AVX2                                                                      */
+
+SIMD_TARGET("avx2")
+static void simd_avx2_destride(const char (*stl)[50], size_t tri_count,
+                               float* out)
+{
+    for (size_t i=0; i < tri_count; ++i) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)stl[i]);
+        _mm256_storeu_si256((__m256i*)&out[i * 9], a);
+        memcpy(&out[i * 9 + 8], stl[i] + 32, sizeof(float));
+    }
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i simd_avx2_round(__m256i h, __m256i w) {
+    h = _mm256_add_epi32(h, _mm256_mullo_epi32(w,
+                                               _mm256_set1_epi32(XXH_P3)));
+    h = _mm256_or_si256(_mm256_slli_epi32(h, 17), _mm256_srli_epi32(h, 15));
+    return _mm256_mullo_epi32(h, _mm256_set1_epi32(XXH_P4));
+}
+
+/*  Picks one axis from eight vertices loaded as three vectors a, b, c.
+ *  Each input is permuted so that its values land in the right lanes,
+ *  then they're blended together (mb and mc must be constants). */
+#define SIMD_AVX2_AXIS(a, b, c, ia, ib, ic, mb, mc)                 \
+    _mm256_blend_epi32(                                             \
+        _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, ia),      \
+                           _mm256_permutevar8x32_epi32(b, ib), mb), \
+        _mm256_permutevar8x32_epi32(c, ic), mc)
+
+SIMD_TARGET("avx2")
+static void simd_avx2_hash(const float (*verts)[3], size_t count,
+                           uint32_t* out)
+{
+    /*  Lane indices for the x, y, and z coordinates of eight vertices,
+     *  which are spread across three vectors of eight floats */
+    const __m256i xa = _mm256_setr_epi32(0, 3, 6, 0, 0, 0, 0, 0);
+    const __m256i xb = _mm256_setr_epi32(0, 0, 0, 1, 4, 7, 0, 0);
+    const __m256i xc = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 2, 5);
+    const __m256i ya = _mm256_setr_epi32(1, 4, 7, 0, 0, 0, 0, 0);
+    const __m256i yb = _mm256_setr_epi32(0, 0, 0, 2, 5, 0, 0, 0);
+    const __m256i yc = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 3, 6);
+    const __m256i za = _mm256_setr_epi32(2, 5, 0, 0, 0, 0, 0, 0);
+    const __m256i zb = _mm256_setr_epi32(0, 0, 0, 3, 6, 0, 0, 0);
+    const __m256i zc = _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 4, 7);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int* p = (const int*)&verts[i][0];
+        const __m256i a = _mm256_loadu_si256((const __m256i*)p);
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(p + 8));
+        const __m256i c = _mm256_loadu_si256((const __m256i*)(p + 16));
+
+        __m256i h = _mm256_set1_epi32(XXH_INIT);
+        h = simd_avx2_round(h, SIMD_AVX2_AXIS(a, b, c, xa, xb, xc,
+                                              0x38, 0xC0));
+        h = simd_avx2_round(h, SIMD_AVX2_AXIS(a, b, c, ya, yb, yc,
+                                              0x18, 0xE0));
+        h = simd_avx2_round(h, SIMD_AVX2_AXIS(a, b, c, za, zb, zc,
+                                              0x1C, 0xE0));
+
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(XXH_P2));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(XXH_P3));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        _mm256_storeu_si256((__m256i*)&out[i], h);
+    }
+    simd_get_level(SIMD_SCALAR)->hash(&verts[i], count - i, &out[i]);
+}
+
+SIMD_TARGET("avx2")
+static uint32_t simd_avx2_bounds(const float (*verts)[3], size_t count,
+                                 float min[3], float max[3])
+{
+    const __m256 inf = _mm256_set1_ps(INFINITY);
+    const __m256 neg_inf = _mm256_set1_ps(-INFINITY);
+    __m256 mn[3] = {inf, inf, inf};
+    __m256 mx[3] = {neg_inf, neg_inf, neg_inf};
+    uint32_t nan_count = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32_t finite = 0;
+        for (unsigned j=0; j < 3; ++j) {
+            const __m256 v = _mm256_loadu_ps(&verts[i][0] + 8 * j);
+            const __m256 f = _mm256_cmp_ps(_mm256_sub_ps(v, v),
+                                           _mm256_setzero_ps(), _CMP_EQ_OQ);
+            mn[j] = _mm256_min_ps(mn[j], _mm256_blendv_ps(inf, v, f));
+            mx[j] = _mm256_max_ps(mx[j], _mm256_blendv_ps(neg_inf, v, f));
+            finite |= (uint32_t)_mm256_movemask_ps(f) << (8 * j);
+        }
+        nan_count += simd_x86_count_verts(~finite & 0xFFFFFF, VERT_BITS_8);
+    }
+
+    float mn_out[24], mx_out[24];
+    for (unsigned j=0; j < 3; ++j) {
+        _mm256_storeu_ps(&mn_out[8 * j], mn[j]);
+        _mm256_storeu_ps(&mx_out[8 * j], mx[j]);
+    }
+    simd_x86_reduce(mn_out, mx_out, 24, min, max);
+    return nan_count + simd_get_level(SIMD_SCALAR)->bounds(
+            &verts[i], count - i, min, max);
+}
+
+SIMD_TARGET("avx2")
+static const char* simd_avx2_find_vertex(const char* data, const char* end)
+{
+    const __m256i first = _mm256_set1_epi8('v');
+    const __m256i last = _mm256_set1_epi8(' ');
+    for (; data + 6 + 32 <= end; data += 32) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)data);
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(data + 6));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                 _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            const unsigned j = __builtin_ctz(mask);
+            if (!memcmp(data + j + 1, "ertex", 5)) {
+                return data + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return simd_sse2_find_vertex(data, end);
+}
+
+static const simd_kernels_t SIMD_AVX2_KERNELS = {
+    .level = SIMD_AVX2,
+    .destride = simd_avx2_destride,
+    .hash = simd_avx2_hash,
+    .bounds = simd_avx2_bounds,
+    .find_vertex = simd_avx2_find_vertex,
+};
+
+/******************************************************************************/
+/*  AVX-512 (F + BW)                                                          */
+
+#define SIMD_AVX512_TARGET "avx512f,avx512bw"
+
+SIMD_TARGET(SIMD_AVX512_TARGET)
+static void simd_avx512_destride(const char (*stl)[50], size_t tri_count,
+                                 float* out)
+{
+    /*  Masked loads and stores move all nine floats at once */
+    for (size_t i=0; i < tri_count; ++i) {
+        const __m512i a = _mm512_maskz_loadu_epi32(0x1FF, stl[i]);
+        _mm512_mask_storeu_epi32(&out[i * 9], 0x1FF, a);
+    }
+}
+
+SIMD_TARGET(SIMD_AVX512_TARGET)
+static inline __m512i simd_avx512_round(__m512i h, __m512i w) {
+    h = _mm512_add_epi32(h, _mm512_mullo_epi32(w,
+                                               _mm512_set1_epi32(XXH_P3)));
+    return _mm512_mullo_epi32(_mm512_rol_epi32(h, 17),
+                              _mm512_set1_epi32(XXH_P4));
+}
+
+SIMD_TARGET(SIMD_AVX512_TARGET)
+static void simd_avx512_hash(const float (*verts)[3], size_t count,
+                             uint32_t* out)
+{
+    /*  Sixteen vertices span three vectors a, b, c.  For each axis, the
+     *  first two-thirds come from a two-vector permute of (a, b), and the
+     *  remainder are merged in from c. */
+    int ab[3][16], cs[3][16];
+    __mmask16 cm[3] = {0, 0, 0};
+    for (unsigned k=0; k < 3; ++k) {
+        for (unsigned n=0; n < 16; ++n) {
+            const unsigned g = 3 * n + k;
+            ab[k][n] = (g < 32) ? g : 0;
+            cs[k][n] = (g < 32) ? 0 : g - 32;
+            cm[k] |= (g < 32) ? 0 : (1 << n);
+        }
+    }
+    __m512i iab[3], ic[3];
+    for (unsigned k=0; k < 3; ++k) {
+        iab[k] = _mm512_loadu_si512(ab[k]);
+        ic[k] = _mm512_loadu_si512(cs[k]);
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const int* p = (const int*)&verts[i][0];
+        const __m512i a = _mm512_loadu_si512(p);
+        const __m512i b = _mm512_loadu_si512(p + 16);
+        const __m512i c = _mm512_loadu_si512(p + 32);
+
+        __m512i h = _mm512_set1_epi32(XXH_INIT);
+        for (unsigned k=0; k < 3; ++k) {
+            const __m512i w = _mm512_mask_permutexvar_epi32(
+                    _mm512_permutex2var_epi32(a, iab[k], b),
+                    cm[k], ic[k], c);
+            h = simd_avx512_round(h, w);
+        }
+
+        h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 15));
+        h = _mm512_mullo_epi32(h, _mm512_set1_epi32(XXH_P2));
+        h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 13));
+        h = _mm512_mullo_epi32(h, _mm512_set1_epi32(XXH_P3));
+        h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+        _mm512_storeu_si512(&out[i], h);
+    }
+    simd_avx2_hash(&verts[i], count - i, &out[i]);
+}
+
+SIMD_TARGET(SIMD_AVX512_TARGET)
+static uint32_t simd_avx512_bounds(const float (*verts)[3], size_t count,
+                                   float min[3], float max[3])
+{
+    const __m512 inf = _mm512_set1_ps(INFINITY);
+    const __m512 neg_inf = _mm512_set1_ps(-INFINITY);
+    __m512 mn[3] = {inf, inf, inf};
+    __m512 mx[3] = {neg_inf, neg_inf, neg_inf};
+    uint32_t nan_count = 0;
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint64_t finite = 0;
+        for (unsigned j=0; j < 3; ++j) {
+            const __m512 v = _mm512_loadu_ps(&verts[i][0] + 16 * j);
+            const __mmask16 f = _mm512_cmp_ps_mask(
+                    _mm512_sub_ps(v, v), _mm512_setzero_ps(), _CMP_EQ_OQ);
+            mn[j] = _mm512_mask_min_ps(mn[j], f, mn[j], v);
+            mx[j] = _mm512_mask_max_ps(mx[j], f, mx[j], v);
+            finite |= (uint64_t)f << (16 * j);
+        }
+        nan_count += simd_x86_count_verts(~finite & 0xFFFFFFFFFFFFULL,
+                                          VERT_BITS_16);
+    }
+
+    float mn_out[48], mx_out[48];
+    for (unsigned j=0; j < 3; ++j) {
+        _mm512_storeu_ps(&mn_out[16 * j], mn[j]);
+        _mm512_storeu_ps(&mx_out[16 * j], mx[j]);
+    }
+    simd_x86_reduce(mn_out, mx_out, 48, min, max);
+    return nan_count + simd_avx2_bounds(&verts[i], count - i, min, max);
+}
+
+SIMD_TARGET(SIMD_AVX512_TARGET)
+static const char* simd_avx512_find_vertex(const char* data,
+                                           const char* end)
+{
+    const __m512i first = _mm512_set1_epi8('v');
+    const __m512i last = _mm512_set1_epi8(' ');
+    for (; data + 6 + 64 <= end; data += 64) {
+        const __m512i a = _mm512_loadu_si512(data);
+        const __m512i b = _mm512_loadu_si512(data + 6);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(a, first) &
+                        _mm512_cmpeq_epi8_mask(b, last);
+        while (mask) {
+            const unsigned j = __builtin_ctzll(mask);
+            if (!memcmp(data + j + 1, "ertex", 5)) {
+                return data + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return simd_avx2_find_vertex(data, end);
+}
+
+static const simd_kernels_t SIMD_AVX512_KERNELS = {
+    .level = SIMD_AVX512,
+    .destride = simd_avx512_destride,
+    .hash = simd_avx512_hash,
+    .bounds = simd_avx512_bounds,
+    .find_vertex = simd_avx512_find_vertex,
+};
+
+/******************************************************************************/
+
+const simd_kernels_t* simd_x86_kernels(simd_level_t level) {
+    __builtin_cpu_init();
+    switch (level) {
+        case SIMD_SSE2:
+            return __builtin_cpu_supports("sse2")
+                ? &SIMD_SSE2_KERNELS : NULL;
+        case SIMD_AVX2:
+            return __builtin_cpu_supports("avx2")
+                ? &SIMD_AVX2_KERNELS : NULL;
+        case SIMD_AVX512:
+            return (__builtin_cpu_supports("avx512f") &&
+                    __builtin_cpu_supports("avx512bw"))
+                ? &SIMD_AVX512_KERNELS : NULL;
+        default:
+            return NULL;
+    }
+}
+
+#else
+
+const simd_kernels_t* simd_x86_kernels(simd_level_t level) {
+    (void)level;
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "log.h"
+#include "mem.h"
+#include "object.h"
+#include "staging.h"
+
+staging_t* staging_new() {
+    if (!(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) || !glBufferStorage) {
+        return NULL;
+    }
+
+    /*  Coherent mapping means that workers' writes are visible to the GPU
+     *  without explicit flushes, as long as they happen before the copy
+     *  is issued (which the worker state's release / acquire ensures) */
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+                                              | GL_MAP_COHERENT_BIT;
+    GLuint buf;
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_COPY_READ_BUFFER, buf);
+    glBufferStorage(GL_COPY_READ_BUFFER, STAGING_SIZE, NULL, flags);
+    void* ptr = glMapBufferRange(GL_COPY_READ_BUFFER, 0, STAGING_SIZE, flags);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    if (!ptr) {
+        log_warn("Failed to map staging buffer");
+        glDeleteBuffers(1, &buf);
+        return NULL;
+    }
+    mem_track(MEM_GPU, STAGING_SIZE);
+
+    OBJECT_ALLOC(staging);
+    staging->buf = buf;
+    staging->ptr = (uint8_t*)ptr;
+    staging->head = 0;
+    staging->tail = 0;
+    staging->first = 0;
+    staging->count = 0;
+    log_trace("Created staging ring");
+    return staging;
+}
+
+void staging_delete(staging_t* staging) {
+    for (unsigned i=0; i < staging->count; ++i) {
+        const staging_region_t* r =
+            &staging->regions[(staging->first + i) % STAGING_MAX_REGIONS];
+        if (r->fence) {
+            glDeleteSync(r->fence);
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, staging->buf);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glDeleteBuffers(1, &staging->buf);
+    mem_track(MEM_GPU, -(int64_t)STAGING_SIZE);
+    free(staging);
+}
+
+/*  Reclaims released regions from the tail whose copies have finished,
+ *  without waiting for any others (but flushing their fences, so that
+ *  they'll eventually signal) */
+static void staging_retire(staging_t* staging) {
+    while (staging->count) {
+        staging_region_t* r = &staging->regions[staging->first];
+        if (!r->fence) {
+            break;
+        }
+        const GLenum status = glClientWaitSync(
+                r->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED &&
+            status != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        glDeleteSync(r->fence);
+        r->fence = 0;
+        staging->tail = (r->offset + r->bytes) % STAGING_SIZE;
+        staging->first = (staging->first + 1) % STAGING_MAX_REGIONS;
+        staging->count--;
+    }
+    if (!staging->count) {
+        staging->head = 0;
+        staging->tail = 0;
+    }
+}
+
+int staging_alloc(staging_t* staging, size_t bytes, void** ptr) {
+    staging_retire(staging);
+    bytes = (bytes + STAGING_ALIGN - 1) / STAGING_ALIGN * STAGING_ALIGN;
+    if (!bytes) {
+        bytes = STAGING_ALIGN;
+    }
+    if (staging->count == STAGING_MAX_REGIONS || bytes > STAGING_SIZE) {
+        return -1;
+    }
+
+    /*  While the occupied space doesn't wrap around, the free space is
+     *  [head, end) and [0, tail); otherwise, it's [head, tail).  Regions
+     *  never fill the ring exactly, so that head == tail means empty. */
+    size_t offset;
+    if (!staging->count) {
+        offset = 0;
+    } else if (staging->head >= staging->tail) {
+        if (staging->head + bytes <= STAGING_SIZE) {
+            offset = staging->head;
+        } else if (bytes < staging->tail) {
+            /*  Skip the end of the ring, charging it to the last region */
+            staging->regions[(staging->first + staging->count - 1)
+                             % STAGING_MAX_REGIONS].bytes +=
+                STAGING_SIZE - staging->head;
+            offset = 0;
+        } else {
+            return -1;
+        }
+    } else if (staging->head + bytes < staging->tail) {
+        offset = staging->head;
+    } else {
+        return -1;
+    }
+
+    const int index = (staging->first + staging->count) % STAGING_MAX_REGIONS;
+    staging_region_t* r = &staging->regions[index];
+    r->offset = offset;
+    r->bytes = bytes;
+    r->fence = 0;
+    staging->count++;
+    staging->head = offset + bytes;
+    *ptr = staging->ptr + offset;
+    return index;
+}
+
+void staging_copy(staging_t* staging, int region, size_t offset,
+                  GLuint buffer, size_t bytes)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, staging->buf);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        staging->regions[region].offset + offset, 0, bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void staging_release(staging_t* staging, int region) {
+    staging->regions[region].fence =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
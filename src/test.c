@@ -1,12 +1,328 @@
+#include "arena.h"
+#include "backdrop.h"
+#include "camera.h"
+#include "draw.h"
+#include "loader.h"
+#include "log.h"
 #include "vset.h"
+#include "mem.h"
+#include "model.h"
+#include "options.h"
 #include "platform.h"
+#include "pool.h"
+#include "quality.h"
+#include "report.h"
+#include "resident.h"
+#include "shaded.h"
+#include "simd.h"
+#include "theme.h"
+#include "wireframe.h"
+
+#define SIMD_ITERATION_COUNT 10
+
+/*  Time per call of each kernel, in seconds */
+typedef struct simd_result_ {
+    bool tested;
+    bool matches;   /* Output is identical to the scalar kernels */
+    double destride;
+    double hash;
+    double bounds;
+    double find_vertex;
+} simd_result_t;
+
+/*  Runs every set of kernels supported by this CPU over the whole model,
+ *  checking the results against the scalar reference implementations */
+static void test_simd(const char* data, size_t size, uint32_t tri_count,
+                      simd_result_t* results)
+{
+    const char (*stl)[50] = (const char (*)[50])&data[84 + 12];
+    const size_t vert_count = tri_count * 3;
+
+    float (*ref_verts)[3] = malloc(sizeof(float) * 3 * vert_count);
+    uint32_t* ref_hashes = malloc(sizeof(uint32_t) * vert_count);
+    float ref_min[3] = {INFINITY, INFINITY, INFINITY};
+    float ref_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    const simd_kernels_t* ref = simd_get_level(SIMD_SCALAR);
+    ref->destride(stl, tri_count, &ref_verts[0][0]);
+    ref->hash((const float(*)[3])ref_verts, vert_count, ref_hashes);
+    const uint32_t ref_nan = ref->bounds((const float(*)[3])ref_verts,
+                                         vert_count, ref_min, ref_max);
+    unsigned ref_found = 0;
+    for (const char* p=data; (p = ref->find_vertex(p, data + size)); ++p) {
+        ref_found++;
+    }
+
+    float (*verts)[3] = malloc(sizeof(float) * 3 * vert_count);
+    uint32_t* hashes = malloc(sizeof(uint32_t) * vert_count);
+
+    for (unsigned level=0; level < SIMD_LEVEL_COUNT; ++level) {
+        const simd_kernels_t* k = simd_get_level(level);
+        simd_result_t* r = &results[level];
+        if (!k) {
+            continue;
+        }
+        r->tested = true;
+        r->matches = true;
+
+        float min[3], max[3];
+        uint32_t nan_count = 0;
+        unsigned found = 0;
+        for (unsigned i=0; i < SIMD_ITERATION_COUNT; ++i) {
+            memset(verts, 0, sizeof(float) * 3 * vert_count);
+            int64_t t = platform_get_time();
+            k->destride(stl, tri_count, &verts[0][0]);
+            r->destride += platform_get_time() - t;
+
+            t = platform_get_time();
+            k->hash((const float(*)[3])verts, vert_count, hashes);
+            r->hash += platform_get_time() - t;
+
+            for (unsigned j=0; j < 3; ++j) {
+                min[j] = INFINITY;
+                max[j] = -INFINITY;
+            }
+            t = platform_get_time();
+            nan_count = k->bounds((const float(*)[3])verts, vert_count,
+                                  min, max);
+            r->bounds += platform_get_time() - t;
+
+            found = 0;
+            t = platform_get_time();
+            for (const char* p=data; (p = k->find_vertex(p, data + size));
+                 ++p)
+            {
+                found++;
+            }
+            r->find_vertex += platform_get_time() - t;
+        }
+        r->destride /= SIMD_ITERATION_COUNT * 1e6;
+        r->hash /= SIMD_ITERATION_COUNT * 1e6;
+        r->bounds /= SIMD_ITERATION_COUNT * 1e6;
+        r->find_vertex /= SIMD_ITERATION_COUNT * 1e6;
+
+        r->matches =
+            !memcmp(verts, ref_verts, sizeof(float) * 3 * vert_count) &&
+            !memcmp(hashes, ref_hashes, sizeof(uint32_t) * vert_count) &&
+            nan_count == ref_nan && found == ref_found;
+        for (unsigned j=0; j < 3; ++j) {
+            r->matches &= (min[j] == ref_min[j]) && (max[j] == ref_max[j]);
+        }
+    }
+
+    free(ref_verts);
+    free(ref_hashes);
+    free(verts);
+    free(hashes);
+}
+
+#define RENDER_WIDTH 1280
+#define RENDER_HEIGHT 960
+#define RENDER_WARM_UP 5
+#define RENDER_FRAME_COUNT 40
+
+/*  Camera zoom for timing frames with most of the model off-screen */
+#define RENDER_ZOOM -300.0f
+
+/*  Zoomed-in runs:  with default culling (on the GPU if possible), with
+ *  culling on the CPU, and without culling */
+#define RENDER_ZOOM_COUNT 3
+static const char* RENDER_ZOOM_NAMES[RENDER_ZOOM_COUNT] = {
+    "zoom", "zoom, cpu", "zoom, all"};
+static const char* RENDER_ZOOM_KEYS[RENDER_ZOOM_COUNT] = {
+    "zoomed", "zoomed_cpu_cull", "zoomed_no_cull"};
+
+/*  Camera zoom for timing frames with the model far away, drawn with and
+ *  without levels of detail */
+#define RENDER_FAR 300.0f
+#define RENDER_FAR_COUNT 2
+static const char* RENDER_FAR_NAMES[RENDER_FAR_COUNT] = {
+    "far", "far, full"};
+static const char* RENDER_FAR_KEYS[RENDER_FAR_COUNT] = {
+    "far", "far_no_lod"};
+
+/*  Time per frame for each anti-aliasing mode, in seconds, along with
+ *  the vertex cache miss ratio of the model as it was uploaded */
+typedef struct render_result_ {
+    bool tested;
+    double shaded;
+    double wireframe;
+    float acmr;
+} render_result_t;
+
+/*  Draws frames in each view mode, returning the mean time per frame
+ *  (waiting for the GPU to finish each one) */
+static void test_render_frames(GLFWwindow* window, backdrop_t* backdrop,
+                               quality_t* quality, draw_t* shaded,
+                               wireframe_t* wireframe, model_t* model,
+                               camera_t* camera, theme_t* theme,
+                               render_result_t* result)
+{
+    for (unsigned mode=0; mode < 2; ++mode) {
+        double total = 0.0;
+        for (unsigned i=0; i < RENDER_WARM_UP + RENDER_FRAME_COUNT; ++i) {
+            const int64_t start_time = platform_get_time();
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+            quality_begin(quality, false);
+            backdrop_draw(backdrop, theme);
+            resident_update(model, camera);
+            if (mode) {
+                wireframe_draw(wireframe, model, camera, theme);
+            } else {
+                draw(shaded, model, camera, theme);
+            }
+            quality_end(quality, backdrop);
+            glfwSwapBuffers(window);
+            glFinish();
+            if (i >= RENDER_WARM_UP) {
+                total += platform_get_time() - start_time;
+            }
+        }
+        total /= RENDER_FRAME_COUNT * 1e6;
+        if (mode) {
+            result->wireframe = total;
+        } else {
+            result->shaded = total;
+        }
+    }
+}
+
+/*  Loads the model into a hidden window, then times frames with the
+ *  given anti-aliasing mode and camera zoom.  The result is left untested
+ *  if the window can't be created, e.g. when there's no display or the
+ *  mode isn't supported. */
+static void test_render_mode(const char* filename,
+                             const options_t* options, pool_t* pool,
+                             quality_aa_t aa, float zoom,
+                             render_result_t* result)
+{
+    glfwWindowHint(GLFW_SAMPLES, quality_aa_samples(aa));
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow* const window = glfwCreateWindow(
+            RENDER_WIDTH, RENDER_HEIGHT, "erizo-test", NULL, NULL);
+    if (!window) {
+        return;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (glewInit() != GLEW_OK) {
+        glfwDestroyWindow(window);
+        return;
+    }
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    glViewport(0, 0, width, height);
+
+    backdrop_t* backdrop = backdrop_new();
+    camera_t* camera = camera_new(width, height, CAMERA_PROJ_PERSPECTIVE);
+    model_t* model = model_new(options);
+    draw_t* shaded = shaded_new();
+    wireframe_t* wireframe = wireframe_new();
+    theme_t* theme = theme_new_solarized();
+    quality_t* quality = quality_new(aa);
+
+    loader_t* loader = loader_new(filename, options, pool);
+    loader_state_t state;
+    do {
+        glfwWaitEventsTimeout(0.001);
+        loader_upload(loader, model, camera);
+        state = loader_get_state(loader);
+    } while (state != LOADER_DONE && state < LOADER_ERROR);
+    const report_t* report = loader_get_report(loader);
+    if (report) {
+        result->acmr = report->acmr[1];
+    }
+    loader_finish(loader, model);
+    loader_delete(loader);
+    while (camera_check_anim(camera));
+    camera_zoom(camera, zoom);
+
+    test_render_frames(window, backdrop, quality, shaded, wireframe,
+                       model, camera, theme, result);
+    result->tested = true;
+
+    quality_delete(quality);
+    theme_delete(theme);
+    wireframe_delete(wireframe);
+    draw_delete(shaded);
+    model_delete(model);
+    camera_delete(camera);
+    backdrop_delete(backdrop);
+    glfwDestroyWindow(window);
+}
+
+/*  Compares frame times with each anti-aliasing mode, then without
+ *  anti-aliasing and with triangles left in file order (to show the
+ *  effect of spatial and vertex cache reordering), then zoomed in with
+ *  each kind of culling (see RENDER_ZOOM_NAMES), then zoomed out with and
+ *  without levels of detail */
+static void test_render(const char* filename, const options_t* options,
+                        render_result_t* results,
+                        render_result_t* file_order,
+                        render_result_t* zoomed, render_result_t* far)
+{
+    if (!glfwInit()) {
+        return;
+    }
+    pool_t* pool = pool_new(platform_get_cpu_count());
+    for (unsigned i=0; i < QUALITY_AA_COUNT; ++i) {
+        printf("\rRendering with %s ", quality_aa_name(i));
+        fflush(stdout);
+        test_render_mode(filename, options, pool, i, 0.0f, &results[i]);
+    }
+    if (results[QUALITY_AA_NONE].tested &&
+        (options->morton || options->vcache))
+    {
+        printf("\rRendering in file order ");
+        fflush(stdout);
+        options_t o = *options;
+        o.morton = false;
+        o.vcache = false;
+        test_render_mode(filename, &o, pool, QUALITY_AA_NONE, 0.0f,
+                         file_order);
+    }
+    for (unsigned i=0; i < RENDER_ZOOM_COUNT &&
+                       results[QUALITY_AA_NONE].tested; ++i)
+    {
+        printf("\rRendering %s ", RENDER_ZOOM_NAMES[i]);
+        fflush(stdout);
+        options_t o = *options;
+        o.cull = options->cull && i < 2;
+        o.cull_gpu = options->cull_gpu && i == 0;
+        test_render_mode(filename, &o, pool, QUALITY_AA_NONE, RENDER_ZOOM,
+                         &zoomed[i]);
+    }
+    for (unsigned i=0; i < RENDER_FAR_COUNT &&
+                       results[QUALITY_AA_NONE].tested && options->lod; ++i)
+    {
+        printf("\rRendering %s ", RENDER_FAR_NAMES[i]);
+        fflush(stdout);
+        options_t o = *options;
+        o.lod = (i == 0);
+        test_render_mode(filename, &o, pool, QUALITY_AA_NONE, RENDER_FAR,
+                         &far[i]);
+    }
+    printf("\r");
+    pool_delete(pool);
+    glfwTerminate();
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage:  erizo-test model.stl\n");
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage:  erizo-test model.stl [results.json]\n");
         return 1;
     }
 
+    log_init();
+    arena_init();
+    simd_init();
+    options_t options;
+    options_read(&options);
     platform_mmap_t* map = platform_mmap(argv[1]);
     const char* data = platform_mmap_data(map);
 
@@ -57,5 +373,148 @@ int main(int argc, char** argv) {
 
     printf("    Time per iteration: %f ± %f s\n", mean, std);
 
+    mem_stats_t mem;
+    mem_get_stats(&mem);
+    printf("    Peak vset memory:   %.1f MB\n",
+           mem.peak[MEM_VSET] / (1024.0 * 1024.0));
+    printf("    Peak RSS:           %.1f MB\n",
+           platform_get_peak_rss() / (1024.0 * 1024.0));
+
+    simd_result_t simd[SIMD_LEVEL_COUNT] = {{0}};
+    test_simd(data, platform_mmap_size(map), tri_count, simd);
+    platform_set_terminal_color(stdout, TERM_COLOR_WHITE);
+    printf("SIMD kernels (time per call, in ms):\n");
+    platform_clear_terminal_color(stdout);
+    printf("    %-8s %10s %10s %10s %10s\n", "",
+           "destride", "hash", "bounds", "find");
+    bool simd_ok = true;
+    for (unsigned i=0; i < SIMD_LEVEL_COUNT; ++i) {
+        if (simd[i].tested) {
+            printf("    %-8s %10.3f %10.3f %10.3f %10.3f%s\n",
+                   simd_level_name(i), simd[i].destride * 1000,
+                   simd[i].hash * 1000, simd[i].bounds * 1000,
+                   simd[i].find_vertex * 1000,
+                   simd[i].matches ? "" : "  (MISMATCH)");
+            simd_ok &= simd[i].matches;
+        }
+    }
+
+    render_result_t render[QUALITY_AA_COUNT] = {{0}};
+    render_result_t file_order = {0};
+    render_result_t zoomed[RENDER_ZOOM_COUNT] = {{0}};
+    render_result_t far[RENDER_FAR_COUNT] = {{0}};
+    test_render(argv[1], &options, render, &file_order, zoomed, far);
+    platform_set_terminal_color(stdout, TERM_COLOR_WHITE);
+    printf("Rendering at %ux%u (time per frame, in ms):\n",
+           RENDER_WIDTH, RENDER_HEIGHT);
+    platform_clear_terminal_color(stdout);
+    bool render_tested = false;
+    for (unsigned i=0; i < QUALITY_AA_COUNT; ++i) {
+        render_tested |= render[i].tested;
+    }
+    if (!render_tested) {
+        printf("    Skipped (could not create a window)\n");
+    } else {
+        printf("    %-10s %10s %10s %8s\n", "", "shaded", "wireframe",
+               "ACMR");
+        for (unsigned i=0; i < QUALITY_AA_COUNT; ++i) {
+            if (render[i].tested) {
+                printf("    %-10s %10.3f %10.3f %8.3f\n", quality_aa_name(i),
+                       render[i].shaded * 1000, render[i].wireframe * 1000,
+                       render[i].acmr);
+            } else {
+                printf("    %-10s %10s\n", quality_aa_name(i), "skipped");
+            }
+        }
+    }
+    if (file_order.tested) {
+        printf("    %-10s %10.3f %10.3f %8.3f\n", "file order",
+               file_order.shaded * 1000, file_order.wireframe * 1000,
+               file_order.acmr);
+    }
+    for (unsigned i=0; i < RENDER_ZOOM_COUNT; ++i) {
+        if (zoomed[i].tested) {
+            printf("    %-10s %10.3f %10.3f %8.3f\n", RENDER_ZOOM_NAMES[i],
+                   zoomed[i].shaded * 1000, zoomed[i].wireframe * 1000,
+                   zoomed[i].acmr);
+        }
+    }
+    for (unsigned i=0; i < RENDER_FAR_COUNT; ++i) {
+        if (far[i].tested) {
+            printf("    %-10s %10.3f %10.3f %8.3f\n", RENDER_FAR_NAMES[i],
+                   far[i].shaded * 1000, far[i].wireframe * 1000,
+                   far[i].acmr);
+        }
+    }
+
+    if (argc == 3) {
+        FILE* out = fopen(argv[2], "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s\n", argv[2]);
+            return 1;
+        }
+        fprintf(out, "{\"triangles\": %u, \"unique_vertices\": %u"
+                     ", \"mean_s\": %f, \"std_s\": %f, \"peak_rss\": %lu"
+                     ", \"mem\": ",
+                tri_count, vert_count, mean, std,
+                (unsigned long)platform_get_peak_rss());
+        report_write_mem_json(&mem, out);
+        fprintf(out, ", \"simd\": {");
+        bool first = true;
+        for (unsigned i=0; i < SIMD_LEVEL_COUNT; ++i) {
+            if (simd[i].tested) {
+                fprintf(out, "%s\"%s\": {\"matches\": %s"
+                             ", \"destride_s\": %f, \"hash_s\": %f"
+                             ", \"bounds_s\": %f, \"find_vertex_s\": %f}",
+                        first ? "" : ", ", simd_level_name(i),
+                        simd[i].matches ? "true" : "false",
+                        simd[i].destride, simd[i].hash,
+                        simd[i].bounds, simd[i].find_vertex);
+                first = false;
+            }
+        }
+        fprintf(out, "}, \"render\": {");
+        first = true;
+        for (unsigned i=0; i < QUALITY_AA_COUNT; ++i) {
+            if (render[i].tested) {
+                fprintf(out, "%s\"%s\": {\"shaded_s\": %f"
+                             ", \"wireframe_s\": %f, \"acmr\": %f}",
+                        first ? "" : ", ", quality_aa_name(i),
+                        render[i].shaded, render[i].wireframe,
+                        render[i].acmr);
+                first = false;
+            }
+        }
+        if (file_order.tested) {
+            fprintf(out, "%s\"file_order\": {\"shaded_s\": %f"
+                         ", \"wireframe_s\": %f, \"acmr\": %f}",
+                    first ? "" : ", ", file_order.shaded,
+                    file_order.wireframe, file_order.acmr);
+            first = false;
+        }
+        for (unsigned i=0; i < RENDER_ZOOM_COUNT; ++i) {
+            if (zoomed[i].tested) {
+                fprintf(out, "%s\"%s\": {\"shaded_s\": %f"
+                             ", \"wireframe_s\": %f, \"acmr\": %f}",
+                        first ? "" : ", ", RENDER_ZOOM_KEYS[i],
+                        zoomed[i].shaded, zoomed[i].wireframe,
+                        zoomed[i].acmr);
+                first = false;
+            }
+        }
+        for (unsigned i=0; i < RENDER_FAR_COUNT; ++i) {
+            if (far[i].tested) {
+                fprintf(out, "%s\"%s\": {\"shaded_s\": %f"
+                             ", \"wireframe_s\": %f, \"acmr\": %f}",
+                        first ? "" : ", ", RENDER_FAR_KEYS[i],
+                        far[i].shaded, far[i].wireframe, far[i].acmr);
+                first = false;
+            }
+        }
+        fprintf(out, "}}\n");
+        fclose(out);
+    }
+
     platform_munmap(map);
+    return simd_ok ? 0 : 1;
 }
@@ -80,16 +80,28 @@ theme_t* theme_new_gruvbox() {
     return theme;
 }
 
-theme_uniforms_t theme_get_uniforms(GLuint prog) {
-    theme_uniforms_t u;
-    SHADER_GET_UNIFORM(key);
-    SHADER_GET_UNIFORM(fill);
-    SHADER_GET_UNIFORM(base);
-    return u;
+void theme_delete(theme_t* theme) {
+    if (theme->ubo) {
+        glDeleteBuffers(1, &theme->ubo);
+    }
+    free(theme);
+}
+
+void theme_get_uniforms(GLuint prog) {
+    shader_set_block(prog, "theme", THEME_BINDING);
 }
 
-void theme_bind(theme_t* theme, theme_uniforms_t u) {
-    glUniform3fv(u.key,  1, theme->key);
-    glUniform3fv(u.fill, 1, theme->fill);
-    glUniform3fv(u.base, 1, theme->base);
+void theme_bind(theme_t* theme) {
+    if (!theme->ubo) {
+        /*  std140 pads each vec3 to the size of a vec4 */
+        float data[3][4] = {{0.0f}};
+        memcpy(data[0], theme->key, sizeof(theme->key));
+        memcpy(data[1], theme->fill, sizeof(theme->fill));
+        memcpy(data[2], theme->base, sizeof(theme->base));
+        glGenBuffers(1, &theme->ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, theme->ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(data), data, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, THEME_BINDING, theme->ubo);
 }
@@ -0,0 +1,247 @@
+#include "log.h"
+#include "object.h"
+#include "platform.h"
+#include "report.h"
+#include "timing.h"
+
+/*  Queries are double-buffered:  results for a frame are read back two
+ *  frames later, by which point the GPU has usually finished with them. */
+#define TIMING_BUFFERS 2
+
+struct timing_ {
+    char* name;
+
+    GLuint queries[TIMING_BUFFERS][TIMING_STAGE_COUNT];
+    unsigned issued[TIMING_BUFFERS];    /* Bitmask of stages */
+    int active;                         /* Running stage, or -1 */
+
+    uint64_t frame;         /* Index of the frame being drawn */
+    int64_t frame_start;
+    int64_t swap_start;
+
+    /*  Ring buffers of recent frames, indexed by frame % TIMING_HISTORY */
+    float cpu[TIMING_HISTORY];
+    float swap[TIMING_HISTORY];
+    float gpu[TIMING_HISTORY][TIMING_STAGE_COUNT];
+    bool valid[TIMING_HISTORY];
+
+    uint64_t collected;     /* One past the last frame with GPU results */
+    unsigned dropped;       /* Frames whose results weren't ready in time */
+    unsigned since_trace;
+};
+
+timing_t* timing_new(const char* name) {
+    OBJECT_ALLOC(timing);
+    timing->name = (char*)calloc(1, strlen(name) + 1);
+    strcpy(timing->name, name);
+    glGenQueries(TIMING_BUFFERS * TIMING_STAGE_COUNT, &timing->queries[0][0]);
+    timing->active = -1;
+    return timing;
+}
+
+void timing_delete(timing_t* timing) {
+    glDeleteQueries(TIMING_BUFFERS * TIMING_STAGE_COUNT,
+                    &timing->queries[0][0]);
+    free(timing->name);
+    free(timing);
+}
+
+const char* timing_stage_name(timing_stage_t stage) {
+    switch (stage) {
+        case TIMING_BACKDROP:       return "backdrop";
+        case TIMING_MODEL:          return "model";
+        case TIMING_HUD:            return "hud";
+        case TIMING_STAGE_COUNT:    break;
+    }
+    return "unknown";
+}
+
+static void timing_trace(const timing_t* timing) {
+    timing_stats_t stats;
+    timing_get_stats(timing, &stats);
+    log_trace("Frame timing (%s, %u frames, %u dropped): "
+              "cpu %.3f / %.3f ms, swap %.3f / %.3f ms, "
+              "gpu %.3f / %.3f ms (mean / max)",
+              timing->name, stats.frames, timing->dropped,
+              stats.cpu_mean, stats.cpu_max,
+              stats.swap_mean, stats.swap_max,
+              stats.gpu_total_mean, stats.gpu_total_max);
+    for (unsigned i=0; i < TIMING_STAGE_COUNT; ++i) {
+        log_trace("  %-8s %.3f / %.3f ms", timing_stage_name(i),
+                  stats.gpu_mean[i], stats.gpu_max[i]);
+    }
+}
+
+/*  Reads back results for the frame which last used the given buffer,
+ *  if they're available.  Otherwise, drops that frame's results. */
+static void timing_collect(timing_t* timing, unsigned buf) {
+    const uint64_t frame = timing->frame - TIMING_BUFFERS;
+    const unsigned slot = frame % TIMING_HISTORY;
+
+    for (unsigned i=0; i < TIMING_STAGE_COUNT; ++i) {
+        if (timing->issued[buf] & (1 << i)) {
+            GLint available = 0;
+            glGetQueryObjectiv(timing->queries[buf][i],
+                               GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                timing->dropped++;
+                return;
+            }
+        }
+    }
+
+    for (unsigned i=0; i < TIMING_STAGE_COUNT; ++i) {
+        GLuint64 ns = 0;
+        if (timing->issued[buf] & (1 << i)) {
+            glGetQueryObjectui64v(timing->queries[buf][i],
+                                  GL_QUERY_RESULT, &ns);
+        }
+        timing->gpu[slot][i] = ns / 1e6f;
+    }
+    timing->valid[slot] = true;
+    timing->collected = frame + 1;
+
+    if (++timing->since_trace == TIMING_HISTORY) {
+        timing_trace(timing);
+        timing->since_trace = 0;
+    }
+}
+
+void timing_frame_begin(timing_t* timing) {
+    const unsigned buf = timing->frame % TIMING_BUFFERS;
+    if (timing->issued[buf]) {
+        timing_collect(timing, buf);
+        timing->issued[buf] = 0;
+    }
+    timing->valid[timing->frame % TIMING_HISTORY] = false;
+    timing->swap[timing->frame % TIMING_HISTORY] = 0.0f;
+    timing->frame_start = platform_get_time();
+}
+
+void timing_frame_end(timing_t* timing) {
+    assert(timing->active == -1);
+    timing->cpu[timing->frame % TIMING_HISTORY] =
+        (platform_get_time() - timing->frame_start) / 1000.0f;
+    timing->frame++;
+}
+
+void timing_begin(timing_t* timing, timing_stage_t stage) {
+    assert(timing->active == -1);
+    const unsigned buf = timing->frame % TIMING_BUFFERS;
+    glBeginQuery(GL_TIME_ELAPSED, timing->queries[buf][stage]);
+    timing->issued[buf] |= (1 << stage);
+    timing->active = stage;
+}
+
+void timing_end(timing_t* timing) {
+    assert(timing->active != -1);
+    glEndQuery(GL_TIME_ELAPSED);
+    timing->active = -1;
+}
+
+void timing_swap_begin(timing_t* timing) {
+    timing->swap_start = platform_get_time();
+}
+
+void timing_swap_end(timing_t* timing) {
+    timing->swap[timing->frame % TIMING_HISTORY] =
+        (platform_get_time() - timing->swap_start) / 1000.0f;
+}
+
+float timing_get_gpu(const timing_t* timing, unsigned age,
+                     timing_stage_t stage)
+{
+    if (age >= TIMING_HISTORY || age >= timing->collected) {
+        return -1.0f;
+    }
+    const unsigned slot = (timing->collected - 1 - age) % TIMING_HISTORY;
+    return timing->valid[slot] ? timing->gpu[slot][stage] : -1.0f;
+}
+
+float timing_get_cpu(const timing_t* timing, unsigned age) {
+    if (age >= TIMING_HISTORY || age >= timing->frame) {
+        return -1.0f;
+    }
+    return timing->cpu[(timing->frame - 1 - age) % TIMING_HISTORY];
+}
+
+float timing_get_swap(const timing_t* timing, unsigned age) {
+    if (age >= TIMING_HISTORY || age >= timing->frame) {
+        return -1.0f;
+    }
+    return timing->swap[(timing->frame - 1 - age) % TIMING_HISTORY];
+}
+
+void timing_get_stats(const timing_t* timing, timing_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    unsigned cpu_frames = 0;
+    for (unsigned i=0; i < TIMING_HISTORY; ++i) {
+        const float cpu = timing_get_cpu(timing, i);
+        if (cpu >= 0.0f) {
+            stats->cpu_mean += cpu;
+            stats->cpu_max = fmaxf(stats->cpu_max, cpu);
+            const float swap = timing_get_swap(timing, i);
+            stats->swap_mean += swap;
+            stats->swap_max = fmaxf(stats->swap_max, swap);
+            cpu_frames++;
+        }
+
+        if (timing_get_gpu(timing, i, 0) < 0.0f) {
+            continue;
+        }
+        float total = 0.0f;
+        for (unsigned j=0; j < TIMING_STAGE_COUNT; ++j) {
+            const float gpu = timing_get_gpu(timing, i, j);
+            stats->gpu_mean[j] += gpu;
+            stats->gpu_max[j] = fmaxf(stats->gpu_max[j], gpu);
+            total += gpu;
+        }
+        stats->gpu_total_mean += total;
+        stats->gpu_total_max = fmaxf(stats->gpu_total_max, total);
+        stats->frames++;
+    }
+
+    if (cpu_frames) {
+        stats->cpu_mean /= cpu_frames;
+        stats->swap_mean /= cpu_frames;
+    }
+    if (stats->frames) {
+        for (unsigned j=0; j < TIMING_STAGE_COUNT; ++j) {
+            stats->gpu_mean[j] /= stats->frames;
+        }
+        stats->gpu_total_mean /= stats->frames;
+    }
+}
+
+void timing_write_json(const timing_t* timing, FILE* out) {
+    timing_stats_t stats;
+    timing_get_stats(timing, &stats);
+
+    fprintf(out, "{\"frame_timing\": {\"name\": ");
+    report_write_string(timing->name, out);
+    fprintf(out, ", \"frames\": %lu, \"sampled\": %u, \"dropped\": %u"
+                 ", \"cpu_ms\": {\"mean\": %f, \"max\": %f}"
+                 ", \"swap_ms\": {\"mean\": %f, \"max\": %f}"
+                 ", \"gpu_ms\": {\"total\": {\"mean\": %f, \"max\": %f}",
+            (unsigned long)timing->frame, stats.frames, timing->dropped,
+            stats.cpu_mean, stats.cpu_max,
+            stats.swap_mean, stats.swap_max,
+            stats.gpu_total_mean, stats.gpu_total_max);
+    for (unsigned i=0; i < TIMING_STAGE_COUNT; ++i) {
+        fprintf(out, ", \"%s\": {\"mean\": %f, \"max\": %f}",
+                timing_stage_name(i), stats.gpu_mean[i], stats.gpu_max[i]);
+    }
+    fprintf(out, "}}}\n");
+}
+
+void timing_save(const timing_t* timing) {
+    if (!timing->frame) {
+        return;
+    }
+    FILE* out = report_open();
+    if (out) {
+        timing_write_json(timing, out);
+        fclose(out);
+    }
+}
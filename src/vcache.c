@@ -0,0 +1,246 @@
+#include "arena.h"
+#include "mem.h"
+#include "vcache.h"
+
+/*  Vertices record the time at which they entered the cache, where time
+ *  counts cache misses.  With FIFO replacement, a vertex is still cached
+ *  if fewer than VCACHE_SIZE vertices have entered since then.  Time
+ *  starts past VCACHE_SIZE so that a zeroed stamp is always a miss. */
+#define VCACHE_START (VCACHE_SIZE + 1)
+
+static inline bool vcache_cached(const uint32_t* stamp, uint32_t v,
+                                 uint32_t time)
+{
+    return time - stamp[v] <= VCACHE_SIZE;
+}
+
+float vcache_acmr(arena_t* arena, const uint32_t* tris,
+                  size_t tri_count, size_t vert_count)
+{
+    if (!tri_count) {
+        return 0.0f;
+    }
+    uint32_t* stamp = (uint32_t*)arena_calloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    uint32_t time = VCACHE_START;
+    for (size_t i=0; i < 3 * tri_count; ++i) {
+        if (!vcache_cached(stamp, tris[i], time)) {
+            stamp[tris[i]] = time++;
+        }
+    }
+    return (time - VCACHE_START) / (float)tri_count;
+}
+
+/*  Scratch arrays for Tipsify, sized for one run of triangles (and their
+ *  vertices), so that they can be reused between runs */
+typedef struct vcache_scratch_ {
+    uint32_t* offset;
+    uint32_t* live;
+    uint32_t* adj;
+    uint32_t* stamp;
+    bool* emitted;
+    uint32_t* out;
+    uint32_t* stack;
+} vcache_scratch_t;
+
+static void vcache_scratch_init(vcache_scratch_t* s, arena_t* arena,
+                                size_t tri_count, size_t vert_count)
+{
+    s->offset = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 2));
+    s->live = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    s->adj = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * tri_count);
+    s->stamp = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    s->emitted = (bool*)arena_alloc(
+            arena, MEM_WORKER, sizeof(bool) * tri_count);
+    s->out = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * tri_count);
+    s->stack = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * tri_count);
+}
+
+/*  Runs Tipsify on triangles which use 1-based indices up to vert_count,
+ *  with scratch arrays that are at least that large.  The caller fills in
+ *  the cache stamps and time, which carry over from the previous run, so
+ *  that this run starts from the vertices which are still cached. */
+static void vcache_tipsify(vcache_scratch_t* s, uint32_t* tris,
+                           size_t tri_count, size_t vert_count,
+                           uint32_t* time_)
+{
+    if (!tri_count) {
+        return;
+    }
+
+    /*  Build a list of triangles for each vertex, where vertex v's
+     *  triangles are adj[offset[v]] through adj[offset[v + 1] - 1] */
+    uint32_t* const offset = s->offset;
+    uint32_t* const live = s->live;
+    uint32_t* const adj = s->adj;
+    memset(offset, 0, sizeof(uint32_t) * (vert_count + 2));
+    for (size_t i=0; i < 3 * tri_count; ++i) {
+        offset[tris[i] + 1]++;
+    }
+    for (size_t v=1; v <= vert_count + 1; ++v) {
+        offset[v] += offset[v - 1];
+    }
+    memcpy(live, offset, sizeof(uint32_t) * (vert_count + 1));
+    for (size_t i=0; i < 3 * tri_count; ++i) {
+        adj[live[tris[i]]++] = i / 3;
+    }
+
+    /*  live[v] then counts the triangles using v which haven't been
+     *  emitted yet */
+    for (size_t v=0; v <= vert_count; ++v) {
+        live[v] = offset[v + 1] - offset[v];
+    }
+
+    uint32_t* const stamp = s->stamp;
+    bool* const emitted = s->emitted;
+    uint32_t* const out = s->out;
+    memset(emitted, 0, sizeof(bool) * tri_count);
+
+    /*  Every vertex of every emitted triangle is pushed onto the dead-end
+     *  stack, which is used to find a nearby vertex when the cache runs
+     *  out of candidates.  The entries pushed by the latest fan are also
+     *  the candidates for the next fan. */
+    uint32_t* const stack = s->stack;
+    size_t top = 0;
+
+    /*  Start from the most recently cached vertex, if any */
+    uint32_t time = *time_;
+    uint32_t fan = 1;
+    for (uint32_t v=1; v <= vert_count; ++v) {
+        if (vcache_cached(stamp, v, time) && stamp[v] > stamp[fan]) {
+            fan = v;
+        }
+    }
+
+    size_t n = 0;
+    uint32_t cursor = 1;
+    while (fan) {
+        /*  Emit every remaining triangle around the fanning vertex */
+        const size_t start = top;
+        for (uint32_t j=offset[fan]; j < offset[fan + 1]; ++j) {
+            const uint32_t t = adj[j];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+            for (unsigned k=0; k < 3; ++k) {
+                const uint32_t v = tris[t * 3 + k];
+                out[n++] = v;
+                stack[top++] = v;
+                live[v]--;
+                if (!vcache_cached(stamp, v, time)) {
+                    stamp[v] = time++;
+                }
+            }
+        }
+
+        /*  Pick the next fanning vertex from the ones just emitted,
+         *  preferring the oldest vertex which will still be cached once
+         *  its remaining triangles have been emitted */
+        fan = 0;
+        int64_t best = -1;
+        for (size_t j=start; j < top; ++j) {
+            const uint32_t v = stack[j];
+            if (!live[v]) {
+                continue;
+            }
+            const uint32_t age = time - stamp[v];
+            const int64_t priority =
+                (age + 2 * live[v] <= VCACHE_SIZE) ? age : 0;
+            if (priority > best) {
+                best = priority;
+                fan = v;
+            }
+        }
+
+        /*  Otherwise, fall back to recently used vertices, then to the
+         *  next vertex in index order that has triangles left */
+        while (!fan && top) {
+            const uint32_t v = stack[--top];
+            if (live[v]) {
+                fan = v;
+            }
+        }
+        while (!fan && cursor <= vert_count) {
+            if (live[cursor]) {
+                fan = cursor;
+            }
+            cursor++;
+        }
+    }
+    assert(n == 3 * tri_count);
+    memcpy(tris, out, sizeof(uint32_t) * 3 * tri_count);
+    *time_ = time;
+}
+
+void vcache_optimize(arena_t* arena, uint32_t* tris, size_t tri_count,
+                     size_t vert_count, size_t run_tris)
+{
+    /*  Each run's vertices are numbered locally (in order of first use),
+     *  so that the scratch arrays only need to be as large as one run */
+    const size_t run_verts = 3 * run_tris;
+    vcache_scratch_t s;
+    vcache_scratch_init(&s, arena, run_tris, run_verts);
+    uint32_t* local = (uint32_t*)arena_calloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    uint32_t* global = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (run_verts + 1));
+    uint32_t* stamp = (uint32_t*)arena_calloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    uint32_t time = VCACHE_START;
+
+    for (size_t start=0; start < tri_count; start += run_tris) {
+        const size_t n = (tri_count - start < run_tris)
+            ? (tri_count - start) : run_tris;
+        uint32_t* const run = &tris[3 * start];
+        uint32_t m = 0;
+        for (size_t i=0; i < 3 * n; ++i) {
+            uint32_t* const r = &local[run[i]];
+            if (!*r) {
+                *r = ++m;
+                global[m] = run[i];
+            }
+            run[i] = *r;
+        }
+        for (uint32_t v=1; v <= m; ++v) {
+            s.stamp[v] = stamp[global[v]];
+        }
+        vcache_tipsify(&s, run, n, m, &time);
+        for (size_t i=0; i < 3 * n; ++i) {
+            run[i] = global[run[i]];
+        }
+        for (uint32_t v=1; v <= m; ++v) {
+            stamp[global[v]] = s.stamp[v];
+            local[global[v]] = 0;
+        }
+    }
+}
+
+void vcache_reorder(arena_t* arena, uint32_t* tris, size_t tri_count,
+                    float (*verts)[3], size_t vert_count)
+{
+    uint32_t* remap = (uint32_t*)arena_calloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * (vert_count + 1));
+    uint32_t next = 1;
+    for (size_t i=0; i < 3 * tri_count; ++i) {
+        uint32_t* const r = &remap[tris[i]];
+        if (!*r) {
+            *r = next++;
+        }
+        tris[i] = *r;
+    }
+    assert(next == vert_count + 1);
+
+    float (*tmp)[3] = (float(*)[3])arena_alloc(
+            arena, MEM_WORKER, sizeof(float) * 3 * (vert_count + 1));
+    for (size_t v=1; v <= vert_count; ++v) {
+        memcpy(tmp[remap[v]], verts[v], sizeof(float) * 3);
+    }
+    memcpy(&verts[1], &tmp[1], sizeof(float) * 3 * vert_count);
+}
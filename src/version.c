@@ -0,0 +1 @@
+const char* GIT_REV="5dc0d83+"; const char* GIT_TAG=""; const char* GIT_BRANCH="master";
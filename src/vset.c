@@ -1,37 +1,38 @@
-#include "log.h"
+#include "mem.h"
 #include "vset.h"
 
 #define XXH_INLINE_ALL
 #include "xxhash/xxhash.h"
 
 vset_t* vset_new() {
-    vset_t* v = (vset_t*)calloc(1, sizeof(vset_t));
+    vset_t* v = (vset_t*)mem_calloc(MEM_VSET, 1, sizeof(vset_t));
 
     //  Allocate bucket data
     v->num_buckets = 128;
-    v->buckets = calloc(v->num_buckets, sizeof(*v->buckets));
+    v->buckets = mem_calloc(MEM_VSET, v->num_buckets, sizeof(*v->buckets));
 
     //  Allocate node data
     v->data_size = 128;
-    v->vert = calloc(v->data_size, sizeof(*v->vert));
-    v->data = calloc(v->data_size, sizeof(*v->data));
+    v->vert = mem_calloc(MEM_VSET, v->data_size, sizeof(*v->vert));
+    v->data = mem_calloc(MEM_VSET, v->data_size, sizeof(*v->data));
 
     return v;
 }
 
 void vset_delete(vset_t* v) {
-    free(v->vert);
-    free(v->data);
-    free(v->buckets);
-    free(v);
+    mem_free(v->buckets);
+    mem_free(v->vert);
+    mem_free(v->data);
+    mem_free(v);
 }
 
-#define REALLOC_TO(data_var, size_var, new_size) do {               \
-        void* n = calloc(v->size_var * 2, sizeof(*v->data_var));    \
-        memcpy(n, v->data_var, v->size_var * sizeof(*v->data_var)); \
-        free(v->data_var);                                          \
-        v->data_var = n;                                            \
-    } while(0);
+//  Arrays are grown on the heap (rather than in an arena), so that the old
+//  array is freed as soon as it's copied, and zero-filled at the end
+#define REALLOC_TO(data_var, size_var, new_size)                        \
+    v->data_var = mem_realloc(v->data_var,                              \
+                              (new_size) * sizeof(*v->data_var));       \
+    memset(&v->data_var[v->size_var], 0,                                \
+           ((new_size) - v->size_var) * sizeof(*v->data_var));
 
 #define REALLOC_DOUBLE(data_var, size_var) \
     REALLOC_TO(data_var, size_var, (v->size_var * 2))
@@ -85,6 +86,7 @@ static void vset_rehash(vset_t* v, size_t new_buckets) {
        }
     }
     v->num_buckets = new_buckets;
+    v->rehash_count++;
 }
 
 static uint8_t cmp(const float a[3], const float b[3]) {
@@ -97,7 +99,12 @@ static uint8_t cmp(const float a[3], const float b[3]) {
 }
 
 uint32_t vset_insert(vset_t* restrict v, const float* restrict f) {
-    const uint32_t hash = XXH32(f, 12, 0);
+    return vset_insert_hashed(v, f, XXH32(f, 12, 0));
+}
+
+uint32_t vset_insert_hashed(vset_t* restrict v, const float* restrict f,
+                            uint32_t hash)
+{
     const uint32_t mask = v->num_buckets - 1;
 
     const uint32_t b = hash & mask;
@@ -126,7 +133,7 @@ uint32_t vset_insert(vset_t* restrict v, const float* restrict f) {
     return index;
 }
 
-void vset_print_stats(vset_t* v) {
+void vset_get_stats(vset_t* v, vset_stats_t* stats) {
     uint32_t max_chain = 0;
     uint32_t total_chain = 0;
     uint32_t chain_count = 0;
@@ -142,9 +149,10 @@ void vset_print_stats(vset_t* v) {
         chain_count += (chain_length > 0);
     }
 
-    log_trace("vset has %u nodes", v->count);
-    log_trace("   size %u", v->num_buckets);
-    log_trace("   longest chain %u", max_chain);
-    log_trace("   occupied buckets %u", chain_count);
-    log_trace("   average chain %f", (float)total_chain / v->num_buckets);
+    stats->count = v->count;
+    stats->num_buckets = v->num_buckets;
+    stats->occupied_buckets = chain_count;
+    stats->max_chain = max_chain;
+    stats->mean_chain = chain_count ? (float)total_chain / chain_count : 0.0f;
+    stats->rehash_count = v->rehash_count;
 }
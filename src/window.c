@@ -2,6 +2,7 @@
 #include "instance.h"
 #include "log.h"
 #include "platform.h"
+#include "quality.h"
 #include "window.h"
 
 static void cb_window_size(GLFWwindow* window, int width, int height) {
@@ -41,6 +42,20 @@ static void cb_focus(GLFWwindow* window, int focus)
     instance_cb_focus(instance, focus);
 }
 
+static void cb_key(GLFWwindow* window, int key, int scancode,
+                   int action, int mods)
+{
+    (void)scancode;
+    instance_t* instance = (instance_t*)glfwGetWindowUserPointer(window);
+    instance_cb_key(instance, key, action, mods);
+}
+
+static void cb_refresh(GLFWwindow* window)
+{
+    instance_t* instance = (instance_t*)glfwGetWindowUserPointer(window);
+    instance_cb_refresh(instance);
+}
+
 static void cb_close(GLFWwindow* window)
 {
     //  Kick the main loop, so that it exits if all windows are closed
@@ -61,28 +76,47 @@ void window_bind(GLFWwindow* window, instance_t* instance) {
     glfwSetMouseButtonCallback(window, cb_mouse_click);
     glfwSetDropCallback(window, cb_drop);
     glfwSetWindowFocusCallback(window, cb_focus);
+    glfwSetKeyCallback(window, cb_key);
     glfwSetWindowCloseCallback(window, cb_close);
+    glfwSetWindowRefreshCallback(window, cb_refresh);
 
     platform_window_bind(window);
 }
 
-GLFWwindow* window_new(const char* filename, float width, float height) {
-    static bool first = true;
+/*  Every window's context shares objects with this hidden window's, which
+ *  lives as long as the process, so that programs (see shader.c) and
+ *  buffers can be used from any window, whichever windows are closed */
+static GLFWwindow* window_shared = NULL;
 
-    if (first) {
+GLFWwindow* window_new(const char* filename, float width, float height) {
+    if (!window_shared) {
         if (!glfwInit()) {
             log_error_and_abort("Failed to initialize glfw");
         }
-        glfwWindowHint(GLFW_SAMPLES, 8);    /* multisampling! */
+        glfwWindowHint(GLFW_SAMPLES, quality_aa_samples(quality_aa_get()));
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
         glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        window_shared = glfwCreateWindow(1, 1, "erizo", NULL, NULL);
+        if (!window_shared) {
+            const char* err;
+            glfwGetError(&err);
+            log_error_and_abort("Failed to create shared context: %s", err);
+        }
+        glfwMakeContextCurrent(window_shared);
+        const GLenum glew_err = glewInit();
+        if (GLEW_OK != glew_err) {
+            log_error_and_abort("GLEW initialization failed: %s",
+                                glewGetErrorString(glew_err));
+        }
+        log_trace("Initialized GLEW");
     }
 
     GLFWwindow* const window = glfwCreateWindow(
-            width, height, filename, NULL, NULL);
+            width, height, filename, NULL, window_shared);
     if (!window) {
         const char* err;
         glfwGetError(&err);
@@ -92,18 +126,9 @@ GLFWwindow* window_new(const char* filename, float width, float height) {
     }
 
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    glClearDepth(1.0);
     log_trace("Made context current");
-
-    if (first) {
-        const GLenum glew_err = glewInit();
-        if (GLEW_OK != glew_err) {
-            log_error_and_abort("GLEW initialization failed: %s",
-                                glewGetErrorString(glew_err));
-        }
-        log_trace("Initialized GLEW");
-        glClearDepth(1.0);
-        first = false;
-    }
     return window;
 }
 
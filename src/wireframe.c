@@ -1,12 +1,69 @@
-#include "draw.h"
-#include "wireframe.h"
+#include "camera.h"
+#include "cull.h"
+#include "log.h"
+#include "model.h"
+#include "object.h"
 #include "shader.h"
+#include "theme.h"
+#include "wireframe.h"
 
+/*  Triangles are drawn without a vertex array or geometry shader:  each
+ *  vertex looks up its whole triangle (by gl_VertexID) from buffer
+ *  textures over the chunk's index and vertex buffers, so that it can
+ *  find its distance to the opposite edge. */
 static const GLchar* WIREFRAME_VS_SRC = GLSL(330,
+uniform samplerBuffer verts;
+uniform usamplerBuffer tris;
+uniform int base_vertex;
+
+layout(std140) uniform camera { mat4 proj; mat4 view; };
+uniform mat4 model;
+
+out vec3 ec_pos;
+out vec3 edge_dist;
+
+vec3 vertex(int corner) {
+    int i = int(texelFetch(tris, gl_VertexID - gl_VertexID % 3 + corner).r)
+          + base_vertex;
+    vec4 pos = vec4(texelFetch(verts, i * 3).r,
+                    texelFetch(verts, i * 3 + 1).r,
+                    texelFetch(verts, i * 3 + 2).r, 1.0f);
+    return (view * (model * pos)).xyz;
+}
+
+float distance(vec3 pt, vec3 a, vec3 b) {
+    vec3 dt = normalize(b - a);
+    float dist = dot(pt - a, dt);
+    vec3 proj = a + dist * dt;
+    return length(proj - pt);
+}
+
+void main() {
+    int k = gl_VertexID % 3;
+    vec3 a = vertex(k);
+    vec3 b = vertex((k + 1) % 3);
+    vec3 c = vertex((k + 2) % 3);
+
+    gl_Position = proj * vec4(a, 1.0f);
+    ec_pos = gl_Position.xyz;
+
+    /*  Each edge's distance is nonzero at its opposite vertex, so that it
+     *  interpolates to the distance from that edge */
+    edge_dist = vec3(0.0f);
+    edge_dist[(k + 1) % 3] = distance(a, b, c);
+}
+);
+
+/*  Chunks too large for buffer textures (see wireframe_fits) are instead
+ *  drawn from their vertex arrays, expanding each triangle in a geometry
+ *  shader to find the same edge distances */
+static const GLchar* WIREFRAME_GS_VS_SRC = GLSL(330,
 layout(location=0) in vec3 pos;
 
+uniform mat4 model;
+
 void main() {
-    gl_Position = vec4(pos, 1.0f);
+    gl_Position = model * vec4(pos, 1.0f);
 }
 );
 
@@ -14,9 +71,7 @@ static const GLchar* WIREFRAME_GS_SRC = GLSL(330,
 layout (triangles) in;
 layout (triangle_strip, max_vertices=3) out;
 
-uniform mat4 proj;
-uniform mat4 view;
-uniform mat4 model;
+layout(std140) uniform camera { mat4 proj; mat4 view; };
 
 out vec3 ec_pos;
 out vec3 edge_dist;
@@ -29,9 +84,9 @@ float distance(vec3 pt, vec3 a, vec3 b) {
 }
 
 void main() {
-    vec4 a = view * model * gl_in[0].gl_Position;
-    vec4 b = view * model * gl_in[1].gl_Position;
-    vec4 c = view * model * gl_in[2].gl_Position;
+    vec4 a = view * gl_in[0].gl_Position;
+    vec4 b = view * gl_in[1].gl_Position;
+    vec4 c = view * gl_in[2].gl_Position;
 
     gl_Position = proj * a;
     ec_pos = gl_Position.xyz;
@@ -54,13 +109,8 @@ static const GLchar* WIREFRAME_FS_SRC = GLSL(330,
 in vec3 ec_pos;
 in vec3 edge_dist;
 
-uniform mat4 proj;
-uniform mat4 view;
-uniform mat4 model;
-
-uniform vec3 key;
-uniform vec3 fill;
-uniform vec3 base;
+layout(std140) uniform camera { mat4 proj; mat4 view; };
+layout(std140) uniform theme { vec3 key; vec3 fill; vec3 base; };
 
 out vec4 out_color;
 
@@ -78,6 +128,131 @@ void main() {
 }
 );
 
-draw_t* wireframe_new() {
-    return draw_new(WIREFRAME_VS_SRC, WIREFRAME_GS_SRC, WIREFRAME_FS_SRC);
+struct wireframe_ {
+    shader_t shader;
+
+    /*  Attribute-less draws still need a vertex array to be bound */
+    GLuint vao;
+
+    camera_uniforms_t u_camera;
+    GLint u_verts;
+    GLint u_tris;
+    GLint u_base_vertex;
+
+    /*  Geometry shader fallback, and the largest buffer texture (in
+     *  texels) that the driver supports, which decides when it's used */
+    shader_t gs_shader;
+    camera_uniforms_t u_gs_camera;
+    GLint max_texels;
+
+    cull_t* cull;
+};
+
+wireframe_t* wireframe_new() {
+    OBJECT_ALLOC(wireframe);
+    wireframe->shader = shader_new(WIREFRAME_VS_SRC, NULL, WIREFRAME_FS_SRC);
+    wireframe->u_camera = camera_get_uniforms(wireframe->shader.prog);
+    theme_get_uniforms(wireframe->shader.prog);
+    {   // Make a temporary struct to unpack uniforms
+        GLint prog = wireframe->shader.prog;
+        struct { GLint verts; GLint tris; GLint base_vertex; } u;
+        SHADER_GET_UNIFORM(verts);
+        SHADER_GET_UNIFORM(tris);
+        SHADER_GET_UNIFORM(base_vertex);
+        wireframe->u_verts = u.verts;
+        wireframe->u_tris = u.tris;
+        wireframe->u_base_vertex = u.base_vertex;
+    }
+    glGenVertexArrays(1, &wireframe->vao);
+
+    wireframe->gs_shader = shader_new(WIREFRAME_GS_VS_SRC, WIREFRAME_GS_SRC,
+                                      WIREFRAME_FS_SRC);
+    wireframe->u_gs_camera = camera_get_uniforms(wireframe->gs_shader.prog);
+    theme_get_uniforms(wireframe->gs_shader.prog);
+
+    /*  GL 3.3 only guarantees 65536 texels, which is less than a full
+     *  chunk's indices, so the real limit is checked for each chunk */
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &wireframe->max_texels);
+
+    wireframe->cull = cull_new();
+    log_gl_error();
+    return wireframe;
+}
+
+void wireframe_delete(wireframe_t* wireframe) {
+    glDeleteVertexArrays(1, &wireframe->vao);
+    shader_deinit(wireframe->shader);
+    shader_deinit(wireframe->gs_shader);
+    cull_delete(wireframe->cull);
+    free(wireframe);
+}
+
+/*  Checks whether every index and vertex coordinate of a chunk can be
+ *  read through its buffer textures */
+static bool wireframe_fits(const wireframe_t* wireframe,
+                           const model_chunk_t* chunk)
+{
+    const size_t coord_size = chunk->quantized ? sizeof(uint16_t)
+                                               : sizeof(float);
+    const size_t max = (size_t)wireframe->max_texels;
+    return 3 * (size_t)chunk->tri_count <= max &&
+           chunk->vbo_bytes / coord_size <= max;
+}
+
+/*  Draws the visible clusters of a chunk which is too large for buffer
+ *  textures, using the geometry shader, then switches back to the main
+ *  program */
+static void wireframe_draw_gs(wireframe_t* wireframe, const cull_t* cull,
+                              unsigned n, const model_chunk_t* chunk,
+                              camera_t* camera)
+{
+    glUseProgram(wireframe->gs_shader.prog);
+    camera_bind(camera, wireframe->u_gs_camera);
+    camera_bind_model(camera, wireframe->u_gs_camera,
+                      chunk->offset, chunk->scale);
+    glBindVertexArray(chunk->vao);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, cull->counts,
+                                  chunk->index_type, cull->offsets,
+                                  n, cull->bases);
+    glBindVertexArray(wireframe->vao);
+    glUseProgram(wireframe->shader.prog);
+}
+
+void wireframe_draw(wireframe_t* wireframe, model_t* model,
+                    camera_t* camera, theme_t* theme)
+{
+    glEnable(GL_DEPTH_TEST);
+    glUseProgram(wireframe->shader.prog);
+    camera_bind(camera, wireframe->u_camera);
+    theme_bind(theme);
+    glUniform1i(wireframe->u_verts, 0);
+    glUniform1i(wireframe->u_tris, 1);
+
+    /*  Each draw needs its own base vertex uniform, so visible clusters
+     *  are drawn one run at a time rather than with a multi-draw */
+    cull_t* const cull = wireframe->cull;
+    cull_begin(cull, camera, model);
+    glBindVertexArray(wireframe->vao);
+    for (unsigned i=0; i < model->chunk_count; ++i) {
+        const model_chunk_t* chunk = &model->chunks[i];
+        const unsigned n = cull_chunk(cull, chunk);
+        if (!n) {
+            continue;
+        } else if (!wireframe_fits(wireframe, chunk)) {
+            wireframe_draw_gs(wireframe, cull, n, chunk, camera);
+            continue;
+        }
+        camera_bind_model(camera, wireframe->u_camera,
+                          chunk->offset, chunk->scale);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, chunk->vert_tex);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, chunk->tri_tex);
+        for (unsigned j=0; j < n; ++j) {
+            glUniform1i(wireframe->u_base_vertex, cull->bases[j]);
+            glDrawArrays(GL_TRIANGLES, cull->firsts[j], cull->counts[j]);
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
+    log_gl_error();
 }
@@ -1,104 +1,430 @@
+#include "arena.h"
 #include "loader.h"
-#include "log.h"
+#include "mem.h"
+#include "morton.h"
+#include "options.h"
 #include "platform.h"
+#include "quantize.h"
+#include "simd.h"
+#include "vcache.h"
 #include "worker.h"
 #include "vset.h"
 
-static void* worker_run(void* worker_);
+/*  Finds the unit normal of the triangle starting at tris[i], or zero if
+ *  it's degenerate */
+static void worker_normal(const uint32_t* tris, const float (*verts)[3],
+                          size_t i, float n[3])
+{
+    const float* a = verts[tris[i]];
+    const float* b = verts[tris[i + 1]];
+    const float* c = verts[tris[i + 2]];
+    float u[3], v[3];
+    for (unsigned j=0; j < 3; ++j) {
+        u[j] = b[j] - a[j];
+        v[j] = c[j] - a[j];
+    }
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+    const float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    for (unsigned j=0; j < 3; ++j) {
+        n[j] = (len > 0.0f && isfinite(len)) ? n[j] / len : 0.0f;
+    }
+}
+
+/*  Finds a cluster's bounding sphere and a cone which contains its
+ *  triangles' normals */
+static void worker_bound(model_cluster_t* c, const uint32_t* tris,
+                         const float (*verts)[3])
+{
+    const size_t first = c->first;
+    const size_t last = c->first + c->count;
+
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t i=first; i < last; ++i) {
+        for (unsigned j=0; j < 3; ++j) {
+            lo[j] = fminf(lo[j], verts[tris[i]][j]);
+            hi[j] = fmaxf(hi[j], verts[tris[i]][j]);
+        }
+    }
+    for (unsigned j=0; j < 3; ++j) {
+        c->center[j] = (lo[j] + hi[j]) / 2.0f;
+    }
+    float r2 = 0.0f;
+    for (size_t i=first; i < last; ++i) {
+        float d = 0.0f;
+        for (unsigned j=0; j < 3; ++j) {
+            const float e = verts[tris[i]][j] - c->center[j];
+            d += e * e;
+        }
+        r2 = fmaxf(r2, d);
+    }
+    c->radius = sqrtf(r2);
+
+    /*  Clusters without finite bounds are never culled */
+    if (!isfinite(c->radius) || !c->count) {
+        memset(c->center, 0, sizeof(c->center));
+        c->radius = INFINITY;
+    }
+
+    /*  The cone's axis is the mean of the triangles' unit normals, and
+     *  its half-angle reaches the furthest of them.  Degenerate triangles
+     *  are skipped, since they're never visible. */
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (size_t i=first; i < last; i += 3) {
+        float n[3];
+        worker_normal(tris, verts, i, n);
+        for (unsigned j=0; j < 3; ++j) {
+            axis[j] += n[j];
+        }
+    }
+    const float len = sqrtf(axis[0]*axis[0] + axis[1]*axis[1]
+                          + axis[2]*axis[2]);
+    float cos_min = (len > 0.0f && isfinite(len)) ? 1.0f : 0.0f;
+    for (unsigned j=0; j < 3; ++j) {
+        c->axis[j] = (cos_min > 0.0f) ? axis[j] / len : 0.0f;
+    }
+    for (size_t i=first; i < last && cos_min > 0.0f; i += 3) {
+        float n[3];
+        worker_normal(tris, verts, i, n);
+        if (n[0] != 0.0f || n[1] != 0.0f || n[2] != 0.0f) {
+            cos_min = fminf(cos_min, n[0]*c->axis[0] + n[1]*c->axis[1]
+                                   + n[2]*c->axis[2]);
+        }
+    }
+    c->cone_sin = (cos_min > 0.0f) ? sqrtf(1.0f - cos_min * cos_min) : 2.0f;
+}
 
-void worker_start(worker_t* worker) {
-    worker->thread = platform_thread_new(worker_run, worker);
+/*  Appends clusters covering indices [start, end) of a range, where tris
+ *  holds 1-based indices into verts.  A range with no triangles (in an
+ *  empty chunk) still gets a cluster, which isn't drawn. */
+static void worker_add_range(worker_t* worker, size_t* clusters_size,
+                             const uint32_t* tris, const float (*verts)[3],
+                             size_t start, size_t end, int32_t base)
+{
+    size_t first = start;
+    do {
+        /*  Clusters end on multiples of MODEL_CLUSTER_TRIS, matching the
+         *  runs that vcache_optimize reorders within (if it was given
+         *  cluster-sized runs by worker_dedup) */
+        const size_t run = 3 * MODEL_CLUSTER_TRIS;
+        const size_t next = (first / run + 1) * run;
+        const size_t last = (next < end) ? next : end;
+        if (worker->cluster_count == *clusters_size) {
+            *clusters_size *= 2;
+            worker->clusters = (model_cluster_t*)mem_realloc(
+                    worker->clusters,
+                    sizeof(model_cluster_t) * *clusters_size);
+        }
+        model_cluster_t* c = &worker->clusters[worker->cluster_count++];
+        *c = (model_cluster_t){
+            .first = first, .count = last - first, .base = base};
+        worker_bound(c, tris, verts);
+        first = last;
+    } while (first < end);
 }
 
-void worker_finish(worker_t* worker) {
-    if (platform_thread_join(worker->thread)) {
-        log_error_and_abort("Error joining worker thread");
+/*  Splits triangles into ranges which each span fewer than
+ *  MODEL_RANGE_VERTS vertices, so that they can be drawn with 16-bit
+ *  indices and a base vertex.  Vertices are numbered by first use, so
+ *  there's usually only one range (or a few, for large chunks).  If a
+ *  single triangle is too wide to fit, the chunk keeps 32-bit indices.
+ *
+ *  Ranges are then split into clusters of consecutive triangles, which
+ *  are spatially coherent because triangles were sorted along a Morton
+ *  curve by worker_dedup, and then (if clusters will be culled) only
+ *  reordered within each cluster.  Their bounds are found from quantized
+ *  positions (if the model will be quantized), since rounding can flip a
+ *  thin triangle's normal. */
+static void worker_split(worker_t* worker, const uint32_t* tris,
+                         const float (*verts)[3])
+{
+    if (worker->quantized) {
+        float (*rounded)[3] = (float(*)[3])arena_alloc(
+                worker->arena, MEM_WORKER,
+                sizeof(float) * 3 * (worker->vert_count + 1));
+        quantize_round(&verts[1], worker->vert_count,
+                       worker->lattice_min, worker->lattice_max, &rounded[1]);
+        verts = (const float(*)[3])rounded;
+    }
+
+    const size_t index_count = 3 * worker->tri_count;
+    size_t clusters_size = 1;
+    worker->clusters = (model_cluster_t*)mem_malloc(
+            MEM_LOADER, sizeof(model_cluster_t) * clusters_size);
+    worker->cluster_count = 0;
+    worker->range_count = 0;
+    worker->index_type = GL_UNSIGNED_SHORT;
+
+    uint32_t lo = UINT32_MAX;
+    uint32_t hi = 0;
+    size_t start = 0;
+    for (size_t i=0; i < index_count; i += 3) {
+        uint32_t t_lo = tris[i];
+        uint32_t t_hi = tris[i];
+        for (unsigned k=1; k < 3; ++k) {
+            t_lo = (tris[i + k] < t_lo) ? tris[i + k] : t_lo;
+            t_hi = (tris[i + k] > t_hi) ? tris[i + k] : t_hi;
+        }
+        if (t_hi - t_lo >= MODEL_RANGE_VERTS) {
+            worker->index_type = GL_UNSIGNED_INT;
+            break;
+        }
+        const uint32_t new_lo = (t_lo < lo) ? t_lo : lo;
+        const uint32_t new_hi = (t_hi > hi) ? t_hi : hi;
+        if (new_hi - new_lo >= MODEL_RANGE_VERTS) {
+            worker_add_range(worker, &clusters_size, tris, verts,
+                             start, i, lo - 1);
+            worker->range_count++;
+            start = i;
+            lo = t_lo;
+            hi = t_hi;
+        } else {
+            lo = new_lo;
+            hi = new_hi;
+        }
+    }
+
+    if (worker->index_type == GL_UNSIGNED_INT) {
+        worker->cluster_count = 0;
+        worker->range_count = 0;
+        start = 0;
+        lo = 1;
     }
-    platform_thread_delete(worker->thread);
+    /*  Add the last range, or the only range for 32-bit indices */
+    worker_add_range(worker, &clusters_size, tris, verts, start, index_count,
+                     (start < index_count) ? lo - 1 : 0);
+    worker->range_count++;
 }
 
-static void* worker_run(void* worker_) {
+void worker_measure(void* worker_) {
     worker_t* const worker = (worker_t*)worker_;
     loader_t* const loader = worker->loader;
 
-    /*  Prepare to build the deduplicated set of indexed verts + tris */
+    /*  Find the bounds and shortest edge from the raw triangles, since the
+     *  model's quantization lattice must be picked before any chunk is
+     *  deduplicated (and then copied) */
+    for (unsigned j=0; j < 3; ++j) {
+        worker->min[j] = INFINITY;
+        worker->max[j] = -INFINITY;
+    }
+    float edge2 = INFINITY;
+    for (size_t i=0; i < worker->tri_count; ++i) {
+        if (i % WORKER_COPY_SIZE == 0 && loader_cancelled(loader)) {
+            return;
+        }
+        float v[3][3];
+        memcpy(v, worker->stl[i], sizeof(v));
+        for (unsigned k=0; k < 3; ++k) {
+            float d2 = 0.0f;
+            for (unsigned j=0; j < 3; ++j) {
+                const float d = v[(k + 1) % 3][j] - v[k][j];
+                d2 += d * d;
+                worker->min[j] = fminf(worker->min[j], v[k][j]);
+                worker->max[j] = fmaxf(worker->max[j], v[k][j]);
+            }
+            if (!isfinite(d2)) {
+                worker->edge = 0.0f;
+                return;
+            } else if (d2 > 0.0f && d2 < edge2) {
+                edge2 = d2;
+            }
+        }
+    }
+    worker->edge = sqrtf(edge2);
+}
+
+void worker_dedup(void* worker_) {
+    worker_t* const worker = (worker_t*)worker_;
+    loader_t* const loader = worker->loader;
+
+    /*  Prepare to build the deduplicated set of indexed verts + tris,
+     *  using scratch memory that's retained between loads.  The arena is
+     *  kept until worker_copy is done with it (or the load is abandoned),
+     *  and the loader limits how many chunks hold an arena at once. */
+    arena_t* arena = arena_acquire();
     vset_t* vset = vset_new();
-    uint32_t* tris = (uint32_t*)malloc(sizeof(uint32_t) * 3 * worker->tri_count);
+    uint32_t* tris = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * worker->tri_count);
+    worker->arena = arena;
+    worker->vset = vset;
+    worker->tris = tris;
 
     /*  Each triangle in an STL is 36 float-bytes (representing 3 vertices
      *  of 3 floats each), and they are spaced at 50-byte intervals.
      *
-     *  This means that every other set of float-bytes is aligned, which
-     *  lets us save a memcpy.  We check alignment and handle the unaligned
-     *  case below, which then lets us loop faster. */
-    unsigned i = 0;
-#define INSERT_UNALIGNED() {                                    \
-        float vert3[9];                                         \
-        memcpy(vert3, &worker->stl[i], sizeof(vert3));          \
-        for (unsigned j=0; j < 3; ++j) {                        \
-            tris[i*3 + j] = vset_insert(vset, &vert3[j * 3]);   \
-        }                                                       \
-        i++;                                                    \
-    }
-
-    if ((uintptr_t)worker->stl & 3) {
-        INSERT_UNALIGNED();
-    }
-    while (i < worker->tri_count) {
-        for (unsigned j=0; j < 3; ++j) {
-            tris[i*3 + j] = vset_insert(vset, (float*)worker->stl[i] + 3*j);
+     *  We work through the triangles in blocks, copying each block into
+     *  a packed (and aligned) array, then hashing every vertex in the
+     *  block at once, before inserting them into the vset.  The first two
+     *  steps use the fastest kernels available on this CPU. */
+    const simd_kernels_t* simd = simd_get();
+    float (*block)[3] = (float(*)[3])arena_alloc(
+            arena, MEM_WORKER, sizeof(float) * 9 * WORKER_BLOCK_SIZE);
+    uint32_t* hashes = (uint32_t*)arena_alloc(
+            arena, MEM_WORKER, sizeof(uint32_t) * 3 * WORKER_BLOCK_SIZE);
+    for (size_t i=0; i < worker->tri_count; i += WORKER_BLOCK_SIZE) {
+        /*  Bail out if the load has been cancelled, leaving the scratch
+         *  data to be released by the loader */
+        if (loader_cancelled(loader)) {
+            return;
         }
-        if (++i < worker->tri_count) {
-            INSERT_UNALIGNED();
+        size_t n = worker->tri_count - i;
+        if (n > WORKER_BLOCK_SIZE) {
+            n = WORKER_BLOCK_SIZE;
         }
+        simd->destride(&worker->stl[i], n, &block[0][0]);
+        simd->hash((const float(*)[3])block, n * 3, hashes);
+        for (unsigned j=0; j < n * 3; ++j) {
+            tris[i*3 + j] = vset_insert_hashed(vset, block[j], hashes[j]);
+        }
+        loader_add_progress(loader, n);
     }
     worker->vert_count = vset->count;
 
-    /*  Increment the number of finished worker threads */
-    loader_increment_count(loader);
+    /*  Find our model's bounds by iterating over deduplicated vertices,
+     *  skipping NaN / inf values.  Bounds start out empty, so they remain
+     *  valid for a worker with no triangles. */
+    for (unsigned j=0; j < 3; ++j) {
+        worker->min[j] = INFINITY;
+        worker->max[j] = -INFINITY;
+    }
+    worker->nan_count = simd->bounds((const float(*)[3])&vset->vert[1],
+                                     vset->count, worker->min, worker->max);
+    vset_get_stats(vset, &worker->stats);
+
+    /*  Sort triangles along a Morton curve, then reorder them for the
+     *  GPU's vertex cache, renumbering vertices by first use after each
+     *  step.  If clusters will be culled, the second pass only reorders
+     *  within each cluster-sized run, so that clusters keep the tight
+     *  bounds that the sort gave them; otherwise, it reorders the whole
+     *  chunk, which gives a lower ACMR.  This leaves the vset's hash table
+     *  stale, but it isn't used again. */
+    if (loader_cancelled(loader)) {
+        return;
+    }
+    const size_t tri_count = worker->tri_count;
+    worker->acmr[0] = vcache_acmr(arena, tris, tri_count, vset->count);
+    const int64_t start_time = platform_get_time();
+    if (worker->options->morton) {
+        morton_sort(arena, tris, tri_count, (const float(*)[3])vset->vert,
+                    worker->min, worker->max);
+        vcache_reorder(arena, tris, tri_count, vset->vert, vset->count);
+    }
+    if (worker->options->vcache) {
+        const bool clustered = worker->options->morton &&
+                               worker->options->cull;
+        vcache_optimize(arena, tris, tri_count, vset->count,
+                        clustered ? MODEL_CLUSTER_TRIS : tri_count);
+        vcache_reorder(arena, tris, tri_count, vset->vert, vset->count);
+    }
+    worker->time_vcache = platform_get_time() - start_time;
+    worker->acmr[1] = vcache_acmr(arena, tris, tri_count, vset->count);
+    worker_split(worker, tris, (const float(*)[3])vset->vert);
 
-    /*  Find our model's bounds by iterating over deduplicated vertices */
-    memcpy(worker->min, vset->vert[1], sizeof(worker->min));
-    memcpy(worker->max, vset->vert[1], sizeof(worker->max));
-    bool has_nan = false;
-    for (size_t i=1; i <= vset->count; ++i) {
-        for (unsigned j=0; j < 3; ++j) {
-            const float v = vset->vert[i][j];
-            /* Skip NaN / inf when calculating bounds */
-            if (isnan(v) || isinf(v)) {
-                has_nan = true;
-            } else {
-                if (v < worker->min[j]) {
-                    worker->min[j] = v;
-                }
-                if (v > worker->max[j]) {
-                    worker->max[j] = v;
+    /*  Wake up the main thread, which maps buffers for this chunk */
+    __atomic_store_n(&worker->state, WORKER_READY, __ATOMIC_RELEASE);
+    glfwPostEmptyEvent();
+}
+
+void worker_copy(void* worker_) {
+    worker_t* const worker = (worker_t*)worker_;
+    loader_t* const loader = worker->loader;
+    vset_t* const vset = worker->vset;
+    uint32_t* const tris = worker->tris;
+
+    /*  Send the vertex data to the GPU buffer (quantizing it if needed),
+     *  in chunks so that we can stop promptly if the load is cancelled */
+    const float (*verts)[3] = (const float(*)[3])&vset->vert[1];
+    const size_t copy_verts = WORKER_COPY_SIZE / 3;
+    for (size_t i=0; i < vset->count; i += copy_verts) {
+        if (loader_cancelled(loader)) {
+            worker_release(worker);
+            return;
+        }
+        const size_t n = (vset->count - i < copy_verts)
+            ? (vset->count - i) : copy_verts;
+        if (worker->quantized) {
+            quantize_encode(&verts[i], n,
+                            worker->lattice_min, worker->lattice_max,
+                            &((uint16_t(*)[3])worker->vertex_buf)[i]);
+        } else {
+            memcpy(&((float(*)[3])worker->vertex_buf)[i], &verts[i],
+                   sizeof(float) * 3 * n);
+        }
+    }
+
+    /*  Convert from the vset's 1-based indices, then send the indexed
+     *  triangles to the GPU buffer, relative to their cluster's base if
+     *  they're 16-bit.  tris keeps the chunk's own 0-based indices. */
+    const size_t tri_indices = 3 * worker->tri_count;
+    const model_cluster_t* cluster = worker->clusters;
+    for (size_t i=0; i < tri_indices; i += WORKER_COPY_SIZE) {
+        if (loader_cancelled(loader)) {
+            worker_release(worker);
+            return;
+        }
+        const size_t n = (tri_indices - i < WORKER_COPY_SIZE)
+            ? (tri_indices - i) : WORKER_COPY_SIZE;
+        for (size_t j=i; j < i + n; ++j) {
+            tris[j] -= 1;
+        }
+        if (worker->index_type == GL_UNSIGNED_SHORT) {
+            uint16_t* const out = (uint16_t*)worker->index_buf;
+            for (size_t j=i; j < i + n; ++j) {
+                while (j >= cluster->first + cluster->count) {
+                    cluster++;
                 }
+                out[j] = tris[j] - cluster->base;
             }
+        } else {
+            memcpy(&((uint32_t*)worker->index_buf)[i], &tris[i],
+                   sizeof(uint32_t) * n);
         }
     }
-    if (has_nan) {
-        log_warn("Model contains NaN/inf values");
-    }
 
-    /*  Wait for the loader to set up our triangle offsets, so that
-     *  each worker is referring to the correct part of the buffer. */
-    loader_wait(loader, LOADER_MODEL_SIZE);
-    for (unsigned i=0; i < worker->tri_count * 3; ++i) {
-        tris[i] += worker->tri_offset - 1;
-    }
+    /*  Hand the buffers back to the main thread to be unmapped, so that
+     *  the chunk is drawn as soon as possible */
+    __atomic_store_n(&worker->state, WORKER_COPIED, __ATOMIC_RELEASE);
+    glfwPostEmptyEvent();
 
-    /*  Wait for GPU buffer pointers to be assigned */
-    loader_wait(loader, LOADER_WORKER_GPU);
+    /*  Then find feature edges from the (now 0-based) triangles, build
+     *  simplified levels of detail, and release all of the scratch memory */
+    if (!loader_cancelled(loader)) {
+        edges_find(&worker->edges, worker->arena, tris, worker->tri_count,
+                   verts, worker->origin);
+    }
+    if (!loader_cancelled(loader) && worker->options->lod) {
+        const int64_t start_time = platform_get_time();
+        lod_build(&worker->lod, worker->arena, tris, worker->tri_count,
+                  verts, vset->count);
+        worker->time_lod = platform_get_time() - start_time;
+    }
+    loader_release_chunk(loader, worker);
+}
 
-    /*  Send the vertex data to the GPU buffer */
-    memcpy(worker->vertex_buf, vset->vert[1], 3 * sizeof(float) * vset->count);
+size_t worker_vbo_bytes(const worker_t* worker) {
+    return worker->vert_count * 3 *
+        (worker->quantized ? sizeof(uint16_t) : sizeof(float));
+}
 
-    /*  Send the indexed triangles to the GPU buffer */
-    memcpy(worker->index_buf, tris, 3 * sizeof(uint32_t) * worker->tri_count);
+size_t worker_ibo_bytes(const worker_t* worker) {
+    return worker->tri_count * 3 * ((worker->index_type == GL_UNSIGNED_SHORT)
+        ? sizeof(uint16_t) : sizeof(uint32_t));
+}
 
-    free(tris);
-    vset_delete(vset);
+void worker_free_clusters(worker_t* worker) {
+    mem_free(worker->clusters);
+    worker->clusters = NULL;
+    worker->cluster_count = 0;
+}
 
-    return NULL;
+void worker_release(worker_t* worker) {
+    if (worker->arena) {
+        arena_release(worker->arena);
+        vset_delete(worker->vset);
+        worker->arena = NULL;
+        worker->vset = NULL;
+        worker->tris = NULL;
+    }
 }